@@ -0,0 +1,125 @@
+#include "assetLoader.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+AssetLoader::AssetLoader(unsigned int threadCount)
+    : start(Clock::now()), uploaded(0), foreground(0), foregroundUploaded(0), failed(false), pool(threadCount)
+{}
+
+double AssetLoader::now() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void AssetLoader::addJob(const std::string & name, const std::function<bool()> & decode, const std::function<bool()> & upload, bool background)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->name = name;
+    job->decode = decode;
+    job->upload = upload;
+    job->worker = -1;
+    job->decodeStart = job->decodeEnd = job->uploadTime = 0.0;
+    job->ok = false;
+    job->background = background;
+    job->done = false;
+    jobs.push_back(job);
+    if (!background)
+        foreground++;
+
+    pool.submit([this, job]() {
+        job->worker = ThreadPool::workerIndex();
+        job->decodeStart = now();
+        job->ok = job->decode();
+        job->decodeEnd = now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(job);
+        }
+        jobDecoded.notify_one();
+    });
+}
+
+bool AssetLoader::runUploads(bool block)
+{
+    // blocking only waits for the foreground jobs, background ones are uploaded if they happen to be ready
+    while (block ? foregroundUploaded < foreground : uploaded < jobs.size())
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (decoded.empty())
+            {
+                if (!block)
+                    break;
+                jobDecoded.wait(lock, [this]() { return !decoded.empty(); });
+            }
+            job = decoded.front();
+            decoded.pop_front();
+        }
+
+        if (job->ok)
+        {
+            double uploadStart = now();
+            job->ok = job->upload();
+            job->uploadTime = now() - uploadStart;
+        }
+        if (!job->ok)
+        {
+            std::cerr << "Failed to load " << job->name << std::endl;
+            failed = failed || !job->background;
+        }
+        job->done = true;
+        uploaded++;
+        if (!job->background)
+            foregroundUploaded++;
+    }
+    return !failed;
+}
+
+bool AssetLoader::poll()
+{
+    return runUploads(false);
+}
+
+bool AssetLoader::finish()
+{
+    return runUploads(true);
+}
+
+void AssetLoader::printTimings(std::ostream & out) const
+{
+    std::vector<std::shared_ptr<Job> > sorted(jobs);
+    // jobs still running in the background go last, their timings are still being written
+    std::sort(sorted.begin(), sorted.end(), [](const std::shared_ptr<Job> & a, const std::shared_ptr<Job> & b) {
+        if (a->done != b->done)
+            return a->done;
+        return a->done && a->decodeEnd < b->decodeEnd;
+    });
+
+    out << "Asset loading on " << pool.size() << " threads (ms)" << std::endl;
+    out << std::left << std::setw(28) << "asset" << std::right
+        << std::setw(8) << "thread" << std::setw(10) << "start" << std::setw(10) << "decode" << std::setw(10) << "upload" << std::endl;
+    out << std::fixed << std::setprecision(1);
+    double decodeSum = 0.0;
+    const Job * critical = 0;
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const Job & job = *sorted[i];
+        out << std::left << std::setw(28) << (job.background ? job.name + " (bg)" : job.name) << std::right;
+        if (!job.done)
+        {
+            out << std::setw(8) << "-" << std::setw(30) << "still running" << std::endl;
+            continue;
+        }
+        decodeSum += job.decodeEnd - job.decodeStart;
+        if (!job.background)
+            critical = &job;
+        out << std::setw(8) << job.worker << std::setw(10) << job.decodeStart
+            << std::setw(10) << job.decodeEnd - job.decodeStart << std::setw(10) << job.uploadTime << std::endl;
+    }
+    if (critical)
+        out << "critical path: " << critical->name << " (decodes done at " << critical->decodeEnd
+            << ", serial decode sum " << decodeSum << ")" << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
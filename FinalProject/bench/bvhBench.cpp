@@ -0,0 +1,294 @@
+// Hit test benchmark: builds the MeshBvh of the boss and Aatrox morph poses and times
+// ray, segment, sphere and pyramid queries in random blends of the poses, against testing
+// every triangle, whose answers they must match. A pyramid must also hit whenever a ray
+// through a point of its polygon does. Then places icicles around the boss as the game
+// does and compares the game's hit test (Shape::outline seen from the camera by Boss::hitBy)
+// with the old center distance test (safeDistance 2) and with rays through the corners only.
+//
+// Build and run from the FinalProject directory (-fpermissive for camera.h, as for the game):
+//   g++ -O2 -std=c++11 -fpermissive -pthread -I libraries -I libraries/glm -I libraries/glew-2.0.0/include
+//       -I libraries/glfw-3.2.1.bin.WIN32/include bench/bvhBench.cpp meshBvh.cpp collisionProxy.cpp objParser.cpp
+//       mappedFile.cpp threadPool.cpp -o bvhBench
+//   ./bvhBench
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/normal.hpp>
+#include "../camera.h"
+#include "Model.h"
+#include "meshBvh.h"
+#include "objParser.h"
+
+#include <math.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Poses {
+    std::vector<std::vector<float> > positions;
+    std::vector<unsigned int> indices;
+};
+
+// the pose OBJs share their vertex numbering, the triangles come from the first one
+bool loadPoses(const std::vector<std::string> & files, Poses & poses)
+{
+    for (size_t i = 0; i < files.size(); i++) {
+        ObjData obj;
+        std::string err;
+        if (!loadObj(files[i].c_str(), obj, err)) {
+            std::cerr << files[i] << ": " << err << std::endl;
+            return false;
+        }
+        if (i > 0 && obj.positions.size() != poses.positions[0].size()) {
+            std::cerr << files[i] << ": the poses do not share their vertices" << std::endl;
+            return false;
+        }
+        poses.positions.push_back(obj.positions);
+        if (i == 0)
+            for (size_t c = 0; c < obj.indices.size(); c++)
+                poses.indices.push_back(obj.indices[c].vertex);
+    }
+    return true;
+}
+
+// every triangle, the reference the tree has to agree with
+struct BruteForce {
+    const Poses & poses;
+    std::vector<float> blended;
+
+    BruteForce(const Poses & poses) : poses(poses) {}
+
+    void blend(const float * weights)
+    {
+        blended.assign(poses.positions[0].size(), 0.0f);
+        for (size_t p = 0; p < poses.positions.size(); p++)
+            for (size_t i = 0; i < blended.size(); i++)
+                blended[i] += weights[p] * poses.positions[p][i];
+    }
+
+    // a one-triangle tree per test keeps the exact same arithmetic as the real one
+    template <class Test>
+    bool any(Test test) const
+    {
+        MeshBvh single;
+        float corners[9], weight = 1.0f;
+        std::vector<const float *> one(1, corners);
+        const unsigned int triangle[3] = { 0, 1, 2 };
+        for (size_t t = 0; t + 2 < poses.indices.size(); t += 3) {
+            for (int j = 0; j < 3; j++)
+                for (int k = 0; k < 3; k++)
+                    corners[3 * j + k] = blended[3 * poses.indices[t + j] + k];
+            single.build(one, 3, 3 * sizeof(float), triangle, 3);
+            if (test(single, &weight))
+                return true;
+        }
+        return false;
+    }
+};
+
+// a regular pentagon of the given radius around center, in the plane facing apex
+void pentagon(const float * apex, const float * center, float radius, float * corners)
+{
+    glm::vec3 c = glm::make_vec3(center);
+    glm::vec3 normal = glm::normalize(c - glm::make_vec3(apex));
+    glm::vec3 u = glm::normalize(glm::cross(normal, fabsf(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+    glm::vec3 v = glm::cross(normal, u);
+    for (int i = 0; i < 5; i++) {
+        float angle = 2.0f * glm::pi<float>() * i / 5.0f;
+        glm::vec3 corner = c + radius * (cosf(angle) * u + sinf(angle) * v);
+        for (int k = 0; k < 3; k++)
+            corners[3 * i + k] = corner[k];
+    }
+}
+
+// rays from apex through points spread over the pentagon, corners and edges included
+template <class Test>
+bool anyRayThrough(const float * apex, const float * corners, Test test)
+{
+    const int STEPS = 6;
+    glm::vec3 a = glm::make_vec3(corners);
+    for (int i = 1; i + 1 < 5; i++) {
+        glm::vec3 b = glm::make_vec3(corners + 3 * i), c = glm::make_vec3(corners + 3 * (i + 1));
+        for (int u = 0; u <= STEPS; u++)
+            for (int v = 0; u + v <= STEPS; v++) {
+                glm::vec3 p = a + (b - a) * (u / float(STEPS)) + (c - a) * (v / float(STEPS));
+                float direction[3] = { p.x - apex[0], p.y - apex[1], p.z - apex[2] };
+                if (test(direction))
+                    return true;
+            }
+    }
+    return false;
+}
+
+// the icicle of initIcicles in main.cpp, grown to the full size of Shape::update
+Shape icicle()
+{
+    Shape shape;
+    shape.rotateAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+    shape.offset = glm::vec3(0.0f, 0.0f, 1.5f);
+    shape.scaleFactor = 0.5f;
+    const float corners[5][3] = { { 0.0f, 0.0f, 1.0f }, { -0.2f, 0.0f, 0.0f }, { -0.1f, 0.0f, -0.2f }, { 0.1f, 0.0f, -0.2f },
+                                  { 0.2f, 0.0f, 0.0f } };
+    for (int i = 0; i < 5; i++) {
+        VertexBasic vertex;
+        vertex.pos = glm::make_vec3(corners[i]) + shape.offset;
+        shape.points.push_back(vertex);
+    }
+    return shape;
+}
+
+double microseconds(std::chrono::steady_clock::time_point start, size_t count)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+void report(const char * name, const std::vector<std::string> & files)
+{
+    Poses poses;
+    if (!loadPoses(files, poses))
+        return;
+    std::vector<const float *> pointers;
+    for (size_t p = 0; p < poses.positions.size(); p++)
+        pointers.push_back(poses.positions[p].data());
+    size_t vertexCount = poses.positions[0].size() / 3;
+
+    MeshBvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(pointers, vertexCount, 3 * sizeof(float), poses.indices.data(), poses.indices.size());
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // queries around the mesh's box
+    float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+    for (size_t p = 0; p < poses.positions.size(); p++)
+        for (size_t i = 0; i < poses.positions[p].size(); i++) {
+            low[i % 3] = std::min(low[i % 3], poses.positions[p][i]);
+            high[i % 3] = std::max(high[i % 3], poses.positions[p][i]);
+        }
+    float size = std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto point = [&](float * p) {
+        for (int k = 0; k < 3; k++)
+            p[k] = low[k] - 0.25f * size + unit(random) * (high[k] - low[k] + 0.5f * size);
+    };
+
+    const size_t QUERIES = 20000, CHECKED = 300;
+    std::vector<float> weights(poses.positions.size());
+    size_t rayHits = 0, segmentHits = 0, sphereHits = 0, pyramidHits = 0, mismatches = 0, uncovered = 0;
+    double rayTime = 0.0, segmentTime = 0.0, sphereTime = 0.0, pyramidTime = 0.0;
+    BruteForce reference(poses);
+    for (size_t q = 0; q < QUERIES; q++) {
+        std::vector<float> factors(weights.size() - 1);
+        for (size_t f = 0; f < factors.size(); f++)
+            factors[f] = unit(random);
+        MeshBvh::mixWeights(factors.data(), factors.size(), weights.data());
+        float a[3], b[3], c[3], direction[3];
+        point(a);
+        point(b);
+        point(c);
+        for (int k = 0; k < 3; k++)
+            direction[k] = b[k] - a[k];
+        float radius = 0.05f * size * unit(random);
+        float polygon[15];
+        pentagon(a, c, 0.1f * size * unit(random), polygon);
+
+        auto t = std::chrono::steady_clock::now();
+        bool ray = bvh.raycast(a, direction, 1e30f, weights.data());
+        rayTime += microseconds(t, 1);
+        t = std::chrono::steady_clock::now();
+        bool segment = bvh.segmentHits(a, b, weights.data());
+        segmentTime += microseconds(t, 1);
+        t = std::chrono::steady_clock::now();
+        bool sphere = bvh.sphereHits(c, radius, weights.data());
+        sphereTime += microseconds(t, 1);
+        t = std::chrono::steady_clock::now();
+        bool pyramid = bvh.pyramidHits(a, polygon, 5, weights.data());
+        pyramidTime += microseconds(t, 1);
+        rayHits += ray;
+        segmentHits += segment;
+        sphereHits += sphere;
+        pyramidHits += pyramid;
+
+        if (q < CHECKED) {
+            reference.blend(weights.data());
+            bool refRay = reference.any([&](const MeshBvh & one, const float * w) { return one.raycast(a, direction, 1e30f, w); });
+            bool refSegment = reference.any([&](const MeshBvh & one, const float * w) { return one.segmentHits(a, b, w); });
+            bool refSphere = reference.any([&](const MeshBvh & one, const float * w) { return one.sphereHits(c, radius, w); });
+            bool refPyramid = reference.any([&](const MeshBvh & one, const float * w) { return one.pyramidHits(a, polygon, 5, w); });
+            mismatches += (ray != refRay) + (segment != refSegment) + (sphere != refSphere) + (pyramid != refPyramid);
+            uncovered += !pyramid && anyRayThrough(a, polygon, [&](const float * d) { return bvh.raycast(a, d, 1e30f, weights.data()); });
+        }
+    }
+    std::cout << name << ": " << bvh.triangleCount() << " triangles, " << bvh.poseCount() << " poses, "
+              << bvh.nodeCount() << " nodes, built in " << std::fixed << std::setprecision(2) << buildMs << " ms" << std::endl;
+    std::cout << "  per query: ray " << std::setprecision(2) << rayTime / QUERIES << " us, segment "
+              << segmentTime / QUERIES << " us, sphere " << sphereTime / QUERIES << " us, pyramid "
+              << pyramidTime / QUERIES << " us (" << 100.0 * rayHits / QUERIES << "% / " << 100.0 * segmentHits / QUERIES
+              << "% / " << 100.0 * sphereHits / QUERIES << "% / " << 100.0 * pyramidHits / QUERIES << "% hit), "
+              << mismatches << " disagreements with every triangle in " << 4 * CHECKED << " checks, "
+              << uncovered << " pyramids missed where a ray through their polygon hits" << std::endl;
+
+    // icicles fly in the y = 0 plane of Anivia, under the boss, so a hit is an icicle drawn
+    // over the boss as the top-down camera (0 12 0) sees it: the boss placed and posed as in
+    // main.cpp, the icicle as initIcicles makes it, at full size, turned to 8 headings.
+    // The old test hits within safeDistance of boss.position.
+    if (std::string(name) != "boss")
+        return;
+    Boss boss;
+    boss.position = glm::vec3(0.0f, 1.0f, 2.2f);
+    boss.rotateAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+    boss.rotateAngle = 3.14159f;
+    boss.safeDistance = 2.0f;
+    boss.mixFactor.idle = 0.5f;
+    boss.hitMesh = std::make_shared<MeshBvh>(bvh);
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 12.0f, 0.0f);
+    Shape shape = icicle();
+
+    const int HEADINGS = 8;
+    size_t placements = 0, oldHits = 0, hits = 0, both = 0, cornerHits = 0, cornersOnly = 0;
+    double hitTime = 0.0;
+    for (float x = -3.0f; x <= 3.0f; x += 0.05f)
+        for (float z = -1.0f; z <= 5.5f; z += 0.05f)
+            for (int h = 0; h < HEADINGS; h++) {
+                shape.position = glm::vec3(x, 0.0f, z);
+                shape.rotateAngle = 2.0f * glm::pi<float>() * h / HEADINGS;
+                std::vector<glm::vec3> outline = shape.outline();
+                bool old = glm::distance(shape.position, boss.position) <= boss.safeDistance;
+                auto t = std::chrono::steady_clock::now();
+                bool hit = boss.hitBy(camera.position, outline);
+                hitTime += microseconds(t, 1);
+                // a single corner is the ray through it, what the test used to look through
+                bool corner = false;
+                for (size_t i = 0; i < outline.size() && !corner; i++)
+                    corner = boss.hitBy(camera.position, std::vector<glm::vec3>(1, outline[i]));
+                placements++;
+                oldHits += old;
+                hits += hit;
+                both += old && hit;
+                cornerHits += corner;
+                cornersOnly += corner && !hit;
+            }
+    std::cout << "  icicles on a 0.05 grid around the boss, " << HEADINGS << " headings, " << std::setprecision(2)
+              << hitTime / placements << " us per hit test: the outline hits " << hits << " of " << placements
+              << ", the old center test " << oldHits << "; " << oldHits - both << " old hits are over empty space, "
+              << hits - both << " placements over the boss were missed. Rays through the corners alone hit "
+              << cornerHits << " (" << hits - (cornerHits - cornersOnly) << " outline hits missed, "
+              << cornersOnly << " outside it)" << std::endl;
+}
+
+}
+
+int main()
+{
+    report("boss", { "boss_low.obj", "boss_high.obj", "boss_attack.obj" });
+    report("aatrox", { "aatrox_low.obj", "aatrox_high.obj", "aatrox_dead.obj" });
+    return 0;
+}
@@ -0,0 +1,429 @@
+// Vertex clustering benchmark: Grid::simplifyMesh on the sort-based clustering
+// (vertexClustering.h) against the std::map CellContent grid it replaced, on
+// boss.obj and on a synthetic height field of one million vertices, then on
+// grids far finer than the map grid could visit (r = 128 .. 2048). Then the
+// five boss LOD resolutions as separate simplifyMesh calls against
+// Grid::simplifyLevels, which takes the one-pass clustering from
+// Grid::LEVELS_PASS_VERTICES vertices on. Last, the
+// surface error of average and quadric (QEM) representatives against the
+// triangle count they keep, per r, on the models small enough to measure,
+// and the open edges of the seam-aware levels on textured models.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries bench/clusterBench.cpp grid.cpp vertexClustering.cpp mesh.cpp meshKernels.cpp objParser.cpp mappedFile.cpp threadPool.cpp weld.cpp -o clusterBench
+//   ./clusterBench [file.obj ...]   (default boss.obj anivia_start.obj iceberg.obj)
+
+#include "grid.h"
+#include "mesh.h"
+#include "objParser.h"
+#include "weld.h"
+
+#include <math.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace {
+
+// Grid::simplifyMesh before the sort-based clustering: each vertex is appended to a copy of
+// its cell's list, then every one of the r^3 cells is visited through the map
+Mesh legacySimplify(const Mesh & mesh, unsigned int r)
+{
+    double offset = 0.01;
+    Vec3Df origin = mesh.bbOrigin - Vec3Df(offset, offset, offset);
+    float size = mesh.bbEdgeSize + 2 * offset;
+    float cubeLength = size / r;
+    std::map<unsigned, std::vector<Vec3Df> > verticesInCell;
+    std::map<unsigned, Vec3Df> representatives;
+
+    auto cellOf = [&](const Vec3Df & pos) {
+        Vec3Df v = pos - origin;
+        int x = v[0] / cubeLength;
+        int y = v[1] / cubeLength;
+        int z = v[2] / cubeLength;
+        return (unsigned)(x + r * y + r * r * z);
+    };
+
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        unsigned nr = cellOf(mesh.positions[i]);
+        std::vector<Vec3Df> list = verticesInCell[nr];
+        list.push_back(mesh.positions[i]);
+        verticesInCell[nr] = list;
+    }
+    for (unsigned i = 0; i < r * r * r; i++) {
+        std::vector<Vec3Df> list = verticesInCell[i];
+        if (list.size() > 0) {
+            Vec3Df p = Vec3Df(0, 0, 0);
+            for (size_t k = 0; k < list.size(); k++)
+                p = p + list[k];
+            p = p / list.size();
+            representatives[i] = p;
+        }
+    }
+
+    std::map<unsigned int, unsigned int> remap;
+    std::vector<Vec3Df> vertices;
+    for (std::map<unsigned, Vec3Df>::iterator it = representatives.begin(); it != representatives.end(); ++it) {
+        remap[it->first] = (unsigned int)vertices.size();
+        vertices.push_back(it->second);
+    }
+    std::vector<Triangle> triangles;
+    for (size_t i = 0; i < mesh.triangles.size(); i++) {
+        const Triangle & tr = mesh.triangles[i];
+        unsigned a = cellOf(mesh.positions[tr.v[0]]), b = cellOf(mesh.positions[tr.v[1]]), c = cellOf(mesh.positions[tr.v[2]]);
+        if (a == b && a == c)
+            continue;
+        triangles.push_back(Triangle(remap[a], remap[b], remap[c]));
+    }
+
+    Mesh simplified(vertices, triangles);
+    simplified.centerAndScaleToUnit();
+    simplified.computeVertexNormals();
+    simplified.computeBoundingCube();
+    return simplified;
+}
+
+// n x n height field in the unit square, two triangles per quad
+Mesh heightField(int n)
+{
+    Mesh mesh;
+    mesh.positions.reserve((size_t)n * n);
+    for (int y = 0; y < n; y++)
+        for (int x = 0; x < n; x++) {
+            float u = x / float(n - 1), v = y / float(n - 1);
+            mesh.positions.push_back(Vec3Df(u, 0.1f * sinf(12.0f * u) * cosf(9.0f * v), v));
+        }
+    mesh.triangles.reserve((size_t)2 * (n - 1) * (n - 1));
+    for (int y = 0; y + 1 < n; y++)
+        for (int x = 0; x + 1 < n; x++) {
+            unsigned int i = y * n + x;
+            mesh.triangles.push_back(Triangle(i, i + 1, i + n));
+            mesh.triangles.push_back(Triangle(i + 1, i + n + 1, i + n));
+        }
+    mesh.centerAndScaleToUnit();
+    mesh.computeVertexNormals();
+    mesh.computeBoundingCube();
+    return mesh;
+}
+
+// best of runs, in milliseconds
+double bestTime(int runs, const std::function<void()> & run)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+Vec3Df closestOnTriangle(const Vec3Df & p, const Vec3Df & a, const Vec3Df & b, const Vec3Df & c)
+{
+    Vec3Df ab = b - a, ac = c - a, ap = p - a;
+    float d1 = Vec3Df::dotProduct(ab, ap), d2 = Vec3Df::dotProduct(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return a;
+    Vec3Df bp = p - b;
+    float d3 = Vec3Df::dotProduct(ab, bp), d4 = Vec3Df::dotProduct(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return b;
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+    Vec3Df cp = p - c;
+    float d5 = Vec3Df::dotProduct(ab, cp), d6 = Vec3Df::dotProduct(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return c;
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// squared distances from the vertices and triangle centroids of from to the surface of to
+void surfaceDistances(const Mesh & from, const Mesh & to, std::vector<double> & squared)
+{
+    std::vector<Vec3Df> samples;
+    for (size_t i = 0; i < from.positions.size(); i++)
+        samples.push_back(from.positions[i]);
+    for (size_t i = 0; i < from.triangles.size(); i++) {
+        const Triangle & t = from.triangles[i];
+        samples.push_back((from.positions[t.v[0]] + from.positions[t.v[1]] + from.positions[t.v[2]]) / 3.0f);
+    }
+    for (size_t s = 0; s < samples.size(); s++) {
+        float best = 1e30f;
+        for (size_t i = 0; i < to.triangles.size(); i++) {
+            const Triangle & t = to.triangles[i];
+            Vec3Df q = closestOnTriangle(samples[s], to.positions[t.v[0]], to.positions[t.v[1]], to.positions[t.v[2]]);
+            best = std::min(best, (samples[s] - q).getSquaredLength());
+        }
+        squared.push_back(best);
+    }
+}
+
+// symmetric surface distance between the two meshes, in percent of the bounding cube edge
+void surfaceError(const Mesh & original, const Mesh & simplified, double & rms, double & max)
+{
+    std::vector<double> squared;
+    surfaceDistances(original, simplified, squared);
+    surfaceDistances(simplified, original, squared);
+    double sum = 0.0, worst = 0.0;
+    for (size_t i = 0; i < squared.size(); i++) {
+        sum += squared[i];
+        worst = std::max(worst, squared[i]);
+    }
+    rms = 100.0 * sqrt(sum / squared.size()) / original.bbEdgeSize;
+    max = 100.0 * sqrt(worst) / original.bbEdgeSize;
+}
+
+// textured vertex of the seam check, split at UV and normal seams by the weld
+struct SeamVertex
+{
+    float pos[3];
+    float normal[3];
+    float texCoor[2];
+};
+
+// OBJ corners welded into vertices and indices
+bool loadSeamMesh(const char * fileName, std::vector<SeamVertex> & vertices, std::vector<unsigned int> & indices)
+{
+    ObjData obj;
+    std::string err;
+    if (!loadObj(fileName, obj, err))
+        return false;
+    vertices.assign(obj.indices.size(), SeamVertex());
+    for (size_t i = 0; i < obj.indices.size(); i++) {
+        const ObjIndex & corner = obj.indices[i];
+        for (int k = 0; k < 3; k++)
+            vertices[i].pos[k] = obj.positions[3 * corner.vertex + k];
+        if (corner.normal >= 0)
+            for (int k = 0; k < 3; k++)
+                vertices[i].normal[k] = obj.normals[3 * corner.normal + k];
+        if (corner.texcoord >= 0)
+            for (int k = 0; k < 2; k++)
+                vertices[i].texCoor[k] = obj.texcoords[2 * corner.texcoord + k];
+    }
+    weldVertices(vertices, indices);
+    return true;
+}
+
+// edges of a single triangle once the vertices are merged by position: cracks, where the input had none
+size_t openEdges(const std::vector<SeamVertex> & vertices, const std::vector<unsigned int> & indices)
+{
+    std::map<std::array<float, 3>, unsigned int> positionIds;
+    std::vector<unsigned int> id(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        std::array<float, 3> p = { { vertices[i].pos[0], vertices[i].pos[1], vertices[i].pos[2] } };
+        id[i] = positionIds.insert(std::make_pair(p, (unsigned int)positionIds.size())).first->second;
+    }
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> edges;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = id[indices[t + k]], b = id[indices[t + (k + 1) % 3]];
+            edges[std::make_pair(std::min(a, b), std::max(a, b))]++;
+        }
+    size_t open = 0;
+    for (std::map<std::pair<unsigned int, unsigned int>, unsigned int>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+        if (it->second == 1)
+            open++;
+    return open;
+}
+
+bool sameMesh(const Mesh & a, const Mesh & b)
+{
+    if (a.positions.size() != b.positions.size() || a.triangles.size() != b.triangles.size())
+        return false;
+    for (size_t i = 0; i < a.positions.size(); i++)
+        if (a.positions[i] != b.positions[i])
+            return false;
+    for (size_t i = 0; i < a.triangles.size(); i++)
+        for (int k = 0; k < 3; k++)
+            if (a.triangles[i].v[k] != b.triangles[i].v[k])
+                return false;
+    return true;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::pair<std::string, Mesh> > meshes;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty()) {
+        files.push_back("boss.obj");
+        files.push_back("anivia_start.obj");
+        files.push_back("iceberg.obj");
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        Mesh mesh;
+        if (!mesh.loadMesh(files[i].c_str())) {
+            std::cerr << "cannot load " << files[i] << std::endl;
+            continue;
+        }
+        meshes.push_back(std::make_pair(files[i], mesh));
+    }
+    meshes.push_back(std::make_pair(std::string("height field 1M"), heightField(1000)));
+
+    std::cout << "ms, legacy best of 1 run (3 for small meshes), sorted best of 5" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(10) << "vertices" << std::setw(6) << "r"
+              << std::setw(10) << "clusters" << std::setw(12) << "legacy" << std::setw(12) << "sorted" << std::setw(10) << "speedup"
+              << std::setw(8) << "same" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    const unsigned int resolutions[] = { 30, 50, 70 };
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const Mesh & mesh = meshes[m].second;
+        int legacyRuns = mesh.positions.size() > 100000 ? 1 : 3;
+        for (unsigned int r : resolutions) {
+            Mesh before, after;
+            double legacy = bestTime(legacyRuns, [&]() { before = legacySimplify(mesh, r); });
+            double sorted = bestTime(5, [&]() { Grid grid; after = grid.simplifyMesh(mesh, r); });
+            std::cout << std::left << std::setw(18) << meshes[m].first << std::right << std::setw(10) << mesh.positions.size()
+                      << std::setw(6) << r << std::setw(10) << after.positions.size() << std::setw(12) << legacy
+                      << std::setw(12) << sorted << std::setw(9) << legacy / sorted << "x"
+                      << std::setw(8) << (sameMesh(before, after) ? "yes" : "NO") << std::endl;
+        }
+    }
+
+    // the map grid visits all r^3 cells, it is only run on the smallest of these
+    std::cout << std::endl << "fine grids, ms (legacy only at r = 128 on small meshes)" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(10) << "vertices" << std::setw(6) << "r"
+              << std::setw(10) << "clusters" << std::setw(12) << "legacy" << std::setw(12) << "sorted" << std::endl;
+    const unsigned int fine[] = { 128, 256, 512, 1024, 2048 };
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const Mesh & mesh = meshes[m].second;
+        for (unsigned int r : fine) {
+            Mesh after;
+            double legacy = -1.0;
+            if (r == 128 && mesh.positions.size() < 100000)
+                legacy = bestTime(1, [&]() { legacySimplify(mesh, r); });
+            double sorted = bestTime(3, [&]() { Grid grid; after = grid.simplifyMesh(mesh, r); });
+            std::cout << std::left << std::setw(18) << meshes[m].first << std::right << std::setw(10) << mesh.positions.size()
+                      << std::setw(6) << r << std::setw(10) << after.positions.size() << std::setw(12);
+            if (legacy < 0.0)
+                std::cout << "-";
+            else
+                std::cout << legacy;
+            std::cout << std::setw(12) << sorted << std::endl;
+        }
+    }
+
+    // the boss LOD chain: five separate runs against simplifyLevels
+    std::cout << std::endl << "LOD chain r = 70 60 50 40 30, ms best of 5" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(10) << "vertices" << std::setw(12) << "separate"
+              << std::setw(12) << "levels" << std::setw(10) << "speedup" << std::setw(10) << "clusters" << std::setw(12) << "max diff"
+              << std::endl;
+    const std::vector<unsigned int> chain = { 70, 60, 50, 40, 30 };
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const Mesh & mesh = meshes[m].second;
+        std::vector<Mesh> separate(chain.size()), together;
+        double separateTime = bestTime(5, [&]() {
+            for (size_t l = 0; l < chain.size(); l++) {
+                Grid grid;
+                separate[l] = grid.simplifyMesh(mesh, chain[l]);
+            }
+        });
+        double togetherTime = bestTime(5, [&]() { Grid grid; together = grid.simplifyLevels(mesh, chain); });
+        // cells agree except for vertices lying exactly on a cell border, where the float division of
+        // simplifyMesh and the exact one of the base grid may round apart; positions differ by rounding
+        bool sameClusters = true;
+        float diff = 0.0f;
+        for (size_t l = 0; l < chain.size(); l++) {
+            if (separate[l].positions.size() != together[l].positions.size() || separate[l].triangles.size() != together[l].triangles.size()) {
+                sameClusters = false;
+                continue;
+            }
+            for (size_t i = 0; i < separate[l].positions.size(); i++)
+                for (int k = 0; k < 3; k++)
+                    diff = std::max(diff, fabsf(separate[l].positions[i][k] - together[l].positions[i][k]));
+        }
+        std::cout << std::left << std::setw(18) << meshes[m].first << std::right << std::setw(10) << mesh.positions.size()
+                  << std::setw(12) << separateTime << std::setw(12) << togetherTime << std::setw(9) << separateTime / togetherTime << "x"
+                  << std::setw(10) << (sameClusters ? "same" : "DIFFER") << std::setw(12) << std::scientific << std::setprecision(1) << diff
+                  << std::fixed << std::setprecision(2) << std::endl;
+    }
+
+    // error in the coordinates of the input (clusterMesh), measured both ways between the surfaces
+    std::cout << std::endl << "surface error, % of the bounding cube edge (rms / max), average vs quadric representatives" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(6) << "r" << std::setw(11) << "triangles"
+              << std::setw(10) << "avg rms" << std::setw(10) << "avg max" << std::setw(10) << "qem rms" << std::setw(10) << "qem max"
+              << std::setw(10) << "qem ms" << std::endl;
+    std::cout << std::setprecision(3);
+    const unsigned int coarse[] = { 10, 15, 20, 25, 30, 40, 50, 60, 70 };
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const Mesh & mesh = meshes[m].second;
+        if (mesh.positions.size() > 100000)
+            continue;
+        std::vector<size_t> triangles;
+        std::vector<double> averageRms, quadricRms;
+        for (unsigned int r : coarse) {
+            Grid grid;
+            Mesh average = grid.clusterMesh(mesh, r, Grid::REPRESENTATIVE_AVERAGE);
+            Mesh quadric;
+            double ms = bestTime(3, [&]() { Grid g; quadric = g.clusterMesh(mesh, r, Grid::REPRESENTATIVE_QUADRIC); });
+            double aRms, aMax, qRms, qMax;
+            surfaceError(mesh, average, aRms, aMax);
+            surfaceError(mesh, quadric, qRms, qMax);
+            triangles.push_back(average.triangles.size());
+            averageRms.push_back(aRms);
+            quadricRms.push_back(qRms);
+            std::cout << std::left << std::setw(18) << meshes[m].first << std::right << std::setw(6) << r
+                      << std::setw(11) << average.triangles.size() << std::setw(10) << aRms << std::setw(10) << aMax
+                      << std::setw(10) << qRms << std::setw(10) << qMax << std::setw(10) << ms << std::endl;
+        }
+        // coarsest quadric grid that is at least as accurate as each average grid
+        for (size_t i = 0; i < triangles.size(); i++) {
+            size_t j = 0;
+            while (j < i && quadricRms[j] > averageRms[i])
+                j++;
+            std::cout << "  average r = " << coarse[i] << " (" << triangles[i] << " triangles) ~ quadric r = " << coarse[j]
+                      << " (" << triangles[j] << " triangles)" << std::endl;
+        }
+    }
+
+    // the charts of a cell share its position, so a level has no more open edges than its input
+    std::cout << std::endl << "seam-aware levels (simplifyAttributeLevels), open edges after merging by position" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(6) << "r" << std::setw(10) << "vertices"
+              << std::setw(11) << "triangles" << std::setw(12) << "open edges" << std::endl;
+    const char * textured[] = { "anivia_start.obj", "aatrox_low.obj", "boss_low.obj", "boss.obj" };
+    const std::vector<unsigned int> seamChain = { 70, 50, 30, 20 };
+    bool closed = true;
+    for (const char * file : textured) {
+        std::vector<SeamVertex> vertices;
+        std::vector<unsigned int> indices;
+        if (!loadSeamMesh(file, vertices, indices)) {
+            std::cerr << "cannot load " << file << std::endl;
+            continue;
+        }
+        size_t inputOpen = openEdges(vertices, indices);
+        std::cout << std::left << std::setw(18) << file << std::right << std::setw(6) << "-" << std::setw(10) << vertices.size()
+                  << std::setw(11) << indices.size() / 3 << std::setw(12) << inputOpen << std::endl;
+        std::vector<std::vector<SeamVertex> > levelVertices;
+        std::vector<std::vector<unsigned int> > levelIndices;
+        simplifyAttributeLevels(vertices, indices, { offsetof(SeamVertex, pos) }, { offsetof(SeamVertex, normal) }, seamChain,
+                                levelVertices, levelIndices);
+        for (size_t l = 0; l < seamChain.size(); l++) {
+            size_t open = openEdges(levelVertices[l], levelIndices[l]);
+            closed = closed && open <= inputOpen;
+            std::cout << std::left << std::setw(18) << file << std::right << std::setw(6) << seamChain[l]
+                      << std::setw(10) << levelVertices[l].size() << std::setw(11) << levelIndices[l].size() / 3
+                      << std::setw(12) << open << std::endl;
+        }
+    }
+    if (!closed)
+        std::cout << "CRACKS: a level has more open edges than its input" << std::endl;
+    return 0;
+}
@@ -0,0 +1,285 @@
+// Draw parameter benchmark: CPU time per frame to submit 5 and 5000 small draws, each
+// with the twelve per-draw parameters of the game's shaders, set
+//   - with glUniform calls looked up by name every draw (the passUniform code before
+//     ProgramReflection),
+//   - with glUniform calls on locations resolved once (ProgramReflection),
+//   - as one DrawParameters block per draw in a UniformRing written with glBufferSubData,
+//   - as one block per draw in the persistently mapped UniformRing (when the driver has
+//     ARB_buffer_storage),
+//   - as one block per instance of a single glDrawArraysInstanced, pushed in one range of
+//     the ring (mapped when it can be).
+// The blocks are read from a shader storage array indexed by gl_InstanceID, like the game's
+// shaders do. The time is the submission loop only, the swap and GPU work are not counted. Needs a
+// GL 4.3 context, it opens a small hidden window.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -I libraries -I libraries/glm bench/drawParameterBench.cpp uniformRing.cpp programReflection.cpp -lGL -lGLEW -lglfw -o drawParameterBench
+//   ./drawParameterBench
+
+#include "programReflection.h"
+#include "uniformRing.h"
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const char * UNIFORM_VERTEX = R"(#version 430
+layout(location = 0) in vec3 pos;
+layout(location = 6) uniform float mixFactor_idle;
+layout(location = 7) uniform float mixFactor_attack;
+layout(location = 8) uniform float mixFactor_dead;
+layout(location = 10) uniform vec3 pos_offset;
+layout(location = 11) uniform vec3 rotateAxis;
+layout(location = 12) uniform float rotateAngle;
+layout(location = 13) uniform float scaleFactor;
+layout(location = 14) uniform bool useShadow;
+layout(location = 15) uniform bool uniColor;
+layout(location = 16) uniform bool onlyWings;
+layout(location = 17) uniform bool onlyBody;
+layout(location = 18) uniform float opacity;
+out vec4 color;
+void main() {
+    float mixed = mixFactor_idle + mixFactor_attack + mixFactor_dead + rotateAngle + dot(rotateAxis, vec3(1.0));
+    gl_Position = vec4(pos * scaleFactor * 0.001 + pos_offset, 1.0);
+    color = vec4(useShadow ? 1.0 : 0.0, uniColor ? mixed : 0.0, onlyWings || onlyBody ? 1.0 : 0.0, opacity);
+}
+)";
+
+const char * BLOCK_VERTEX = R"(#version 430
+layout(location = 0) in vec3 pos;
+struct DrawParameter
+{
+    vec3 pos_offset;
+    float rotateAngle;
+    vec3 rotateAxis;
+    float scaleFactor;
+    float mixFactor_idle;
+    float mixFactor_attack;
+    float mixFactor_dead;
+    float opacity;
+    vec2 texOffset;
+    int useShadow;
+    int uniColor;
+    int onlyWings;
+    int onlyBody;
+};
+layout(std430, binding = 0) readonly buffer DrawParameters
+{
+    DrawParameter draws[];
+};
+out vec4 color;
+void main() {
+    DrawParameter draw = draws[gl_InstanceID];
+    vec3 pos_offset = draw.pos_offset, rotateAxis = draw.rotateAxis;
+    float rotateAngle = draw.rotateAngle, scaleFactor = draw.scaleFactor, opacity = draw.opacity;
+    float mixFactor_idle = draw.mixFactor_idle, mixFactor_attack = draw.mixFactor_attack, mixFactor_dead = draw.mixFactor_dead;
+    bool useShadow = draw.useShadow != 0, uniColor = draw.uniColor != 0, onlyWings = draw.onlyWings != 0, onlyBody = draw.onlyBody != 0;
+    float mixed = mixFactor_idle + mixFactor_attack + mixFactor_dead + rotateAngle + dot(rotateAxis, vec3(1.0));
+    gl_Position = vec4(pos * scaleFactor * 0.001 + pos_offset, 1.0);
+    color = vec4(useShadow ? 1.0 : 0.0, uniColor ? mixed : 0.0, onlyWings || onlyBody ? 1.0 : 0.0, opacity);
+}
+)";
+
+const char * FRAGMENT = R"(#version 430
+in vec4 color;
+layout(location = 0) out vec4 outColor;
+void main() { outColor = color; }
+)";
+
+// the layout of an entry of the DrawParameters array, as in Model.h
+struct Parameters {
+    float posOffset[3];
+    float rotateAngle;
+    float rotateAxis[3];
+    float scaleFactor;
+    float mixFactorIdle, mixFactorAttack, mixFactorDead, opacity;
+    float texOffset[2];
+    GLint useShadow, uniColor, onlyWings, onlyBody;
+    float padding[2];
+};
+
+GLuint link(const char * vertexCode)
+{
+    GLuint program = glCreateProgram();
+    const char * sources[2] = { vertexCode, FRAGMENT };
+    GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    for (int i = 0; i < 2; i++) {
+        GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &sources[i], 0);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[2048];
+        glGetProgramInfoLog(program, sizeof(log), 0, log);
+        std::cerr << log << std::endl;
+        return 0;
+    }
+    return program;
+}
+
+// average CPU time of the submission of one frame, in microseconds, over the last frames
+double timeFrames(GLFWwindow * window, const std::function<void()> & submit)
+{
+    const int WARMUP = 50, FRAMES = 200;
+    double total = 0.0;
+    for (int frame = 0; frame < WARMUP + FRAMES; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        auto start = std::chrono::steady_clock::now();
+        submit();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (frame >= WARMUP)
+            total += us;
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    return total / FRAMES;
+}
+
+}
+
+int main()
+{
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow * window = glfwCreateWindow(256, 256, "drawParameterBench", 0, 0);
+    if (!window) {
+        std::cerr << "Could not open a GL 4.3 window" << std::endl;
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    glewExperimental = GL_TRUE;
+    glewInit();
+
+    GLuint uniformProgram = link(UNIFORM_VERTEX), blockProgram = link(BLOCK_VERTEX);
+    if (!uniformProgram || !blockProgram)
+        return 1;
+    GLuint vao, vbo;
+    const float triangle[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    ProgramReflection reflection(uniformProgram);
+    FloatUniform idle, attack, dead, angle, scale, opacity;
+    Vec3Uniform offset, axis;
+    BoolUniform useShadow, uniColor, onlyWings, onlyBody;
+    idle.resolve(reflection, "mixFactor_idle");
+    attack.resolve(reflection, "mixFactor_attack");
+    dead.resolve(reflection, "mixFactor_dead");
+    offset.resolve(reflection, "pos_offset");
+    axis.resolve(reflection, "rotateAxis");
+    angle.resolve(reflection, "rotateAngle");
+    scale.resolve(reflection, "scaleFactor");
+    useShadow.resolve(reflection, "useShadow");
+    uniColor.resolve(reflection, "uniColor");
+    onlyWings.resolve(reflection, "onlyWings");
+    onlyBody.resolve(reflection, "onlyBody");
+    opacity.resolve(reflection, "opacity");
+
+    std::cout << "CPU time per frame to submit the draws, in microseconds" << std::endl;
+    std::cout << std::setw(8) << "objects" << std::setw(14) << "by name" << std::setw(14) << "resolved"
+              << std::setw(14) << "ring subdata" << std::setw(14) << "ring mapped" << std::setw(14) << "instanced" << std::endl;
+    for (size_t count : { size_t(5), size_t(5000) }) {
+        std::vector<Parameters> objects(count);
+        for (size_t i = 0; i < count; i++) {
+            Parameters p = { { -0.9f + 1.8f * (i % 71) / 71.0f, -0.9f + 1.8f * (i / 71 % 71) / 71.0f, 0.0f }, 3.14159f,
+                             { 0.0f, 1.0f, 0.0f }, 1.0f, 0.5f, 0.0f, 0.0f, 1.0f, { 0.0f, 0.0f }, 0, 1, 0, 0, { 0.0f, 0.0f } };
+            objects[i] = p;
+        }
+
+        glUseProgram(uniformProgram);
+        double byName = timeFrames(window, [&]() {
+            for (const Parameters & p : objects) {
+                glUniform3fv(glGetUniformLocation(uniformProgram, "pos_offset"), 1, p.posOffset);
+                glUniform3fv(glGetUniformLocation(uniformProgram, "rotateAxis"), 1, p.rotateAxis);
+                glUniform1f(glGetUniformLocation(uniformProgram, "rotateAngle"), p.rotateAngle);
+                glUniform1f(glGetUniformLocation(uniformProgram, "scaleFactor"), p.scaleFactor);
+                glUniform1f(glGetUniformLocation(uniformProgram, "mixFactor_idle"), p.mixFactorIdle);
+                glUniform1f(glGetUniformLocation(uniformProgram, "mixFactor_attack"), p.mixFactorAttack);
+                glUniform1f(glGetUniformLocation(uniformProgram, "mixFactor_dead"), p.mixFactorDead);
+                glUniform1i(glGetUniformLocation(uniformProgram, "useShadow"), p.useShadow);
+                glUniform1i(glGetUniformLocation(uniformProgram, "uniColor"), p.uniColor);
+                glUniform1i(glGetUniformLocation(uniformProgram, "onlyWings"), p.onlyWings);
+                glUniform1i(glGetUniformLocation(uniformProgram, "onlyBody"), p.onlyBody);
+                glUniform1f(glGetUniformLocation(uniformProgram, "opacity"), p.opacity);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        });
+        double resolved = timeFrames(window, [&]() {
+            for (const Parameters & p : objects) {
+                offset.set(p.posOffset);
+                axis.set(p.rotateAxis);
+                angle.set(p.rotateAngle);
+                scale.set(p.scaleFactor);
+                idle.set(p.mixFactorIdle);
+                attack.set(p.mixFactorAttack);
+                dead.set(p.mixFactorDead);
+                useShadow.set(p.useShadow != 0);
+                uniColor.set(p.uniColor != 0);
+                onlyWings.set(p.onlyWings != 0);
+                onlyBody.set(p.onlyBody != 0);
+                opacity.set(p.opacity);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        });
+
+        glUseProgram(blockProgram);
+        double rings[2] = { 0.0, 0.0 };
+        bool mapped = false;
+        for (int persistent = 0; persistent < 2; persistent++) {
+            UniformRing ring(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Parameters), count, persistent != 0);
+            if (persistent && !ring.persistent())
+                break;
+            mapped = ring.persistent();
+            rings[persistent] = timeFrames(window, [&]() {
+                ring.beginFrame();
+                for (const Parameters & p : objects) {
+                    ring.push(&p);
+                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                }
+                ring.endFrame();
+            });
+        }
+        UniformRing instanceRing(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Parameters), count);
+        double instanced = timeFrames(window, [&]() {
+            instanceRing.beginFrame();
+            instanceRing.push(objects.data(), objects.size());
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 3, GLsizei(objects.size()));
+            instanceRing.endFrame();
+        });
+        std::cout << std::setw(8) << count << std::fixed << std::setprecision(1) << std::setw(14) << byName
+                  << std::setw(14) << resolved << std::setw(14) << rings[0];
+        if (mapped)
+            std::cout << std::setw(14) << rings[1];
+        else
+            std::cout << std::setw(14) << "no storage";
+        std::cout << std::setw(14) << instanced << std::endl;
+    }
+
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(uniformProgram);
+    glDeleteProgram(blockProgram);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,148 @@
+// Mesh kernel benchmark: times each loop of meshKernels.h in its scalar and SSE
+// version, and the Mesh passes built on them (bounds and recentering)
+// serial and split across a ThreadPool, on the game's OBJ files and on a synthetic
+// height field of one million vertices. Every SSE result is checked against the
+// scalar one, and the threaded Mesh results against the serial ones.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries bench/kernelBench.cpp mesh.cpp meshKernels.cpp objParser.cpp mappedFile.cpp threadPool.cpp -o kernelBench
+//   ./kernelBench [file.obj ...]   (default boss.obj aatrox_low.obj)
+
+#include "mesh.h"
+#include "meshKernels.h"
+#include "objParser.h"
+#include "threadPool.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const int RUNS = 5;
+
+// best of RUNS, in milliseconds; prepare runs untimed before each run
+double bestTime(const std::function<void()> & run, const std::function<void()> & prepare = std::function<void()>())
+{
+    double best = 1e30;
+    for (int i = 0; i < RUNS; i++) {
+        if (prepare)
+            prepare();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+bool sameFloats(const std::vector<Vec3Df> & a, const std::vector<Vec3Df> & b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(&a[0][0], &b[0][0], a.size() * sizeof(Vec3Df)) == 0);
+}
+
+void line(const char * kernel, double scalar, double simd, const char * check)
+{
+    std::cout << "  " << std::left << std::setw(20) << kernel << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << scalar << std::setw(10) << simd << std::setprecision(2)
+              << std::setw(8) << scalar / simd << "x  " << check << std::endl;
+}
+
+void report(const std::string & name, const Mesh & source, ThreadPool & pool)
+{
+    std::cout << name << ": " << source.vertexCount() << " vertices, " << source.triangles.size() << " triangles" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "kernel" << std::right << std::setw(10) << "scalar"
+              << std::setw(10) << (meshKernelsUseSimd() ? "sse" : "(no sse)") << std::setw(9) << "speedup" << "  (ms)" << std::endl;
+    size_t n = source.vertexCount(), t = source.triangles.size();
+    const float * p = source.positionData();
+
+    float low[3], high[3], lowS[3], highS[3];
+    double a = bestTime([&]() { positionBoundsScalar(p, n, lowS, highS); });
+    double b = bestTime([&]() { positionBounds(p, n, low, high); });
+    line("positionBounds", a, b, memcmp(low, lowS, sizeof(low)) == 0 && memcmp(high, highS, sizeof(high)) == 0 ? "same" : "DIFFERENT");
+
+    double sum[3], sumS[3];
+    a = bestTime([&]() { positionSumScalar(p, n, sumS); });
+    b = bestTime([&]() { positionSum(p, n, sum); });
+    double error = 0.0;
+    for (int k = 0; k < 3; k++)
+        error = std::max(error, fabs(sum[k] - sumS[k]) / std::max(1.0, fabs(sumS[k])));
+    line("positionSum", a, b, error < 1e-12 ? "same to 1e-12" : "DIFFERENT");
+
+    float center[3] = { float(sumS[0] / n), float(sumS[1] / n), float(sumS[2] / n) };
+    float d = 0.0f, dS = 0.0f;
+    a = bestTime([&]() { dS = maxSquaredDistanceScalar(p, n, center); });
+    b = bestTime([&]() { d = maxSquaredDistance(p, n, center); });
+    line("maxSquaredDistance", a, b, d == dS ? "same" : "DIFFERENT");
+
+    std::vector<Vec3Df> moved, movedS;
+    a = bestTime([&]() { translateScaleScalar(&movedS[0][0], n, center, 0.5f); }, [&]() { movedS = source.positions; });
+    b = bestTime([&]() { translateScale(&moved[0][0], n, center, 0.5f); }, [&]() { moved = source.positions; });
+    line("translateScale", a, b, sameFloats(moved, movedS) ? "same" : "DIFFERENT");
+
+    std::vector<Vec3Df> faces(t), facesS(t);
+    a = bestTime([&]() { faceNormalsScalar(p, source.indexData(), t, &facesS[0][0]); });
+    b = bestTime([&]() { faceNormals(p, source.indexData(), t, &faces[0][0]); });
+    line("faceNormals", a, b, sameFloats(faces, facesS) ? "same" : "DIFFERENT");
+
+    std::vector<Vec3Df> unit, unitS;
+    a = bestTime([&]() { normalizeVectorsScalar(&unitS[0][0], n); }, [&]() { unitS = source.positions; });
+    b = bestTime([&]() { normalizeVectors(&unit[0][0], n); }, [&]() { unit = source.positions; });
+    line("normalizeVectors", a, b, sameFloats(unit, unitS) ? "same" : "DIFFERENT");
+
+    // the Mesh passes, serial against the pool (only used above Mesh::PARALLEL_VERTICES)
+    std::cout << "  " << std::left << std::setw(20) << "Mesh pass" << std::right << std::setw(10) << "serial"
+              << std::setw(10) << "threads" << std::endl;
+    Mesh serial, threaded;
+    a = bestTime([&]() { serial.computeBoundingCube(); }, [&]() { serial = source; });
+    b = bestTime([&]() { threaded.computeBoundingCube(&pool); }, [&]() { threaded = source; });
+    line("computeBoundingCube", a, b, serial.bbEdgeSize == threaded.bbEdgeSize ? "same" : "DIFFERENT");
+    a = bestTime([&]() { serial.centerAndScaleToUnit(); }, [&]() { serial = source; });
+    b = bestTime([&]() { threaded.centerAndScaleToUnit(&pool); }, [&]() { threaded = source; });
+    line("centerAndScaleToUnit", a, b, sameFloats(serial.positions, threaded.positions) ? "same" : "DIFFERENT");
+}
+
+// n x n height field in the unit square
+Mesh heightField(int n)
+{
+    Mesh mesh;
+    for (int y = 0; y < n; y++)
+        for (int x = 0; x < n; x++) {
+            float u = x / float(n - 1), v = y / float(n - 1);
+            mesh.positions.push_back(Vec3Df(u, 0.1f * sinf(12.0f * u) * cosf(9.0f * v), v));
+        }
+    for (int y = 0; y + 1 < n; y++)
+        for (int x = 0; x + 1 < n; x++) {
+            unsigned int i = y * n + x;
+            mesh.triangles.push_back(Triangle(i, i + 1, i + n));
+            mesh.triangles.push_back(Triangle(i + 1, i + n + 1, i + n));
+        }
+    return mesh;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    ThreadPool pool;
+    std::cout << pool.size() << " worker threads" << std::endl;
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty())
+        files = { "boss.obj", "aatrox_low.obj" };
+    for (size_t i = 0; i < files.size(); i++) {
+        Mesh mesh;
+        if (mesh.loadMesh(files[i].c_str()))
+            report(files[i], mesh, pool);
+    }
+    report("height field", heightField(1000), pool);
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Mesh layout benchmark: the structure-of-arrays Mesh (positions, normals and
+// triangles as separate arrays of trivially copyable types) against the array of
+// Vertex/Triangle classes with virtual destructors it replaced. Reports the size
+// of a vertex and a triangle, the memory of each mesh, and the time to fill the
+// mesh from parsed OBJ data and to compute its vertex normals, on the game's OBJ
+// files and on a synthetic height field of one million vertices. Grid::simplifyMesh
+// is timed on the new layout for reference.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries bench/meshBench.cpp grid.cpp vertexClustering.cpp mesh.cpp meshKernels.cpp objParser.cpp mappedFile.cpp threadPool.cpp -o meshBench
+//   ./meshBench [file.obj ...]   (default boss.obj aatrox_low.obj anivia_start.obj)
+
+#include "grid.h"
+#include "mesh.h"
+#include "objParser.h"
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const int RUNS = 5;
+
+// Vertex and Triangle as they were: a vtable pointer each and hand-written copies
+class LegacyVertex {
+public:
+    inline LegacyVertex () {}
+    inline LegacyVertex (const Vec3Df & p) : p (p) {}
+    inline LegacyVertex (const LegacyVertex & v) : p (v.p), n (v.n) {}
+    inline virtual ~LegacyVertex () {}
+    inline LegacyVertex & operator= (const LegacyVertex & v) {
+        p = v.p;
+        n = v.n;
+        return (*this);
+    }
+    Vec3Df p;
+    Vec3Df n;
+};
+
+class LegacyTriangle {
+public:
+    inline LegacyTriangle (unsigned int v0, unsigned int v1, unsigned int v2) {
+        v[0] = v0;
+        v[1] = v1;
+        v[2] = v2;
+    }
+    inline LegacyTriangle (const LegacyTriangle & t) {
+        v[0] = t.v[0];
+        v[1] = t.v[1];
+        v[2] = t.v[2];
+    }
+    inline virtual ~LegacyTriangle () {}
+    unsigned int v[3];
+};
+
+struct LegacyMesh {
+    std::vector<LegacyVertex> vertices;
+    std::vector<LegacyTriangle> triangles;
+};
+
+// the Mesh::loadMesh fill loop before the change
+void legacyFill(const ObjData & obj, LegacyMesh & mesh)
+{
+    mesh.vertices.clear();
+    mesh.triangles.clear();
+    mesh.vertices.reserve(obj.positions.size() / 3);
+    for (size_t i = 0; i + 2 < obj.positions.size(); i += 3)
+        mesh.vertices.push_back(LegacyVertex(Vec3Df(obj.positions[i], obj.positions[i + 1], obj.positions[i + 2])));
+    mesh.triangles.reserve(obj.indices.size() / 3);
+    for (size_t i = 0; i + 2 < obj.indices.size(); i += 3)
+        mesh.triangles.push_back(LegacyTriangle(obj.indices[i].vertex, obj.indices[i + 1].vertex, obj.indices[i + 2].vertex));
+}
+
+// the Mesh::loadMesh fill after the change
+void fill(const ObjData & obj, Mesh & mesh)
+{
+    mesh.positions.resize(obj.positions.size() / 3);
+    if (!mesh.positions.empty())
+        memcpy(&mesh.positions[0][0], obj.positions.data(), mesh.positions.size() * sizeof(Vec3Df));
+    mesh.triangles.resize(obj.indices.size() / 3);
+    for (size_t i = 0; i < mesh.triangles.size(); i++) {
+        const ObjIndex * corner = &obj.indices[3 * i];
+        mesh.triangles[i] = Triangle(corner[0].vertex, corner[1].vertex, corner[2].vertex);
+    }
+}
+
+// Mesh::computeVertexNormals before the change
+void legacyNormals(LegacyMesh & mesh)
+{
+    for (unsigned int i = 0; i < mesh.vertices.size (); i++)
+        mesh.vertices[i].n = Vec3Df (0.0, 0.0, 0.0);
+    for (unsigned int i = 0; i < mesh.triangles.size (); i++) {
+        Vec3Df edge01 = mesh.vertices[mesh.triangles[i].v[1]].p -  mesh.vertices[mesh.triangles[i].v[0]].p;
+        Vec3Df edge02 = mesh.vertices[mesh.triangles[i].v[2]].p -  mesh.vertices[mesh.triangles[i].v[0]].p;
+        Vec3Df n = Vec3Df::crossProduct (edge01, edge02);
+        n.normalize ();
+        for (unsigned int j = 0; j < 3; j++)
+            mesh.vertices[mesh.triangles[i].v[j]].n += n;
+    }
+    for (unsigned int i = 0; i < mesh.vertices.size (); i++)
+        mesh.vertices[i].n.normalize ();
+}
+
+// best of RUNS, in milliseconds
+double bestTime(const std::function<void()> & run)
+{
+    double best = 1e30;
+    for (int i = 0; i < RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+// n x n height field in the unit square as parsed OBJ data
+ObjData heightField(int n)
+{
+    ObjData obj;
+    for (int y = 0; y < n; y++)
+        for (int x = 0; x < n; x++) {
+            float u = x / float(n - 1), v = y / float(n - 1);
+            float p[3] = { u, 0.1f * sinf(12.0f * u) * cosf(9.0f * v), v };
+            obj.positions.insert(obj.positions.end(), p, p + 3);
+        }
+    for (int y = 0; y + 1 < n; y++)
+        for (int x = 0; x + 1 < n; x++) {
+            int i = y * n + x;
+            ObjIndex corners[6] = { { i, -1, -1 }, { i + 1, -1, -1 }, { i + n, -1, -1 },
+                                    { i + 1, -1, -1 }, { i + n + 1, -1, -1 }, { i + n, -1, -1 } };
+            obj.indices.insert(obj.indices.end(), corners, corners + 6);
+        }
+    return obj;
+}
+
+void report(const std::string & name, const ObjData & obj)
+{
+    LegacyMesh legacy;
+    Mesh mesh;
+    double legacyFillTime = bestTime([&]() { legacyFill(obj, legacy); });
+    double fillTime = bestTime([&]() { fill(obj, mesh); });
+    double legacyNormalTime = bestTime([&]() { legacyNormals(legacy); });
+    double normalTime = bestTime([&]() { mesh.computeVertexNormals(); });
+    mesh.computeBoundingCube();
+    Grid grid;
+    double simplifyTime = bestTime([&]() { grid.simplifyMesh(mesh, 64); });
+
+    size_t legacyBytes = legacy.vertices.size() * sizeof(LegacyVertex) + legacy.triangles.size() * sizeof(LegacyTriangle);
+    size_t bytes = mesh.positions.size() * 2 * sizeof(Vec3Df) + mesh.triangles.size() * sizeof(Triangle);
+    std::cout << std::left << std::setw(16) << name << std::right << std::setw(9) << mesh.positions.size()
+              << std::setw(9) << mesh.triangles.size() << std::fixed << std::setprecision(0)
+              << std::setw(9) << legacyBytes / 1024.0 << std::setw(9) << bytes / 1024.0 << std::setprecision(3)
+              << std::setw(10) << legacyFillTime << std::setw(10) << fillTime
+              << std::setw(10) << legacyNormalTime << std::setw(10) << normalTime
+              << std::setw(10) << simplifyTime << std::endl;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    std::cout << "vertex " << sizeof(LegacyVertex) << " -> " << 2 * sizeof(Vec3Df) << " bytes, triangle "
+              << sizeof(LegacyTriangle) << " -> " << sizeof(Triangle) << " bytes" << std::endl;
+    std::cout << std::left << std::setw(16) << "mesh" << std::right << std::setw(9) << "vertices" << std::setw(9) << "tris"
+              << std::setw(9) << "KB old" << std::setw(9) << "KB new" << std::setw(10) << "fill old" << std::setw(10) << "fill new"
+              << std::setw(10) << "nrm old" << std::setw(10) << "nrm new" << std::setw(10) << "r=64" << "  (ms)" << std::endl;
+
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty())
+        files = { "boss.obj", "aatrox_low.obj", "anivia_start.obj" };
+    for (size_t i = 0; i < files.size(); i++) {
+        ObjData obj;
+        std::string err;
+        if (!loadObj(files[i].c_str(), obj, err)) {
+            std::cerr << files[i] << ": " << err << std::endl;
+            continue;
+        }
+        report(files[i], obj);
+    }
+    report("height field", heightField(1000));
+    return 0;
+}
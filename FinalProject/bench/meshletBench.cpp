@@ -0,0 +1,151 @@
+// Meshlet benchmark: splits the base poses of Aatrox and the boss (and any OBJ given)
+// into meshlets (meshlets.h) after the vertex cache ordering they are baked with, and
+// reports the cluster fill and build time. Then counts the triangles whose cluster
+// would be culled by the frustum and by the normal cone, for the default top-down
+// camera of the game and each model at its in-game place and scale, over twelve
+// headings; the triangles that actually face away are listed as the upper bound.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries/glm -I libraries bench/meshletBench.cpp meshlets.cpp meshOptimizer.cpp mesh.cpp meshKernels.cpp objParser.cpp mappedFile.cpp threadPool.cpp -o meshletBench
+//   ./meshletBench [file.obj ...]   (default aatrox_low.obj boss_low.obj)
+
+#include "meshlets.h"
+#include "meshOptimizer.h"
+#include "mesh.h"
+#include "objParser.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <math.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// where the game draws a model: shader.vert scales, turns by -angle about y, then offsets
+struct Placement {
+    glm::vec3 position;
+    float scale;
+};
+
+Placement placementOf(const std::string & name)
+{
+    // the enemy spawn point and the temporary placement the textured boss is drawn with
+    if (name.compare(0, 4, "boss") == 0)
+        return { glm::vec3(0.0f, 0.5f, 2.1f), 0.22f };
+    return { glm::vec3(0.0f, 0.0f, 4.0f), 0.2f };
+}
+
+// OBJ positions as the game uploads them, Mesh::loadMesh would center and scale them
+bool loadRaw(const char * fileName, Mesh & mesh)
+{
+    ObjData obj;
+    std::string err;
+    if (!loadObj(fileName, obj, err)) {
+        std::cerr << fileName << ": " << err << std::endl;
+        return false;
+    }
+    mesh.positions.clear();
+    mesh.triangles.clear();
+    for (size_t i = 0; i + 2 < obj.positions.size(); i += 3)
+        mesh.positions.push_back(Vec3Df(obj.positions[i], obj.positions[i + 1], obj.positions[i + 2]));
+    for (size_t i = 0; i + 2 < obj.indices.size(); i += 3)
+        mesh.triangles.push_back(Triangle(obj.indices[i].vertex, obj.indices[i + 1].vertex, obj.indices[i + 2].vertex));
+    return true;
+}
+
+void cacheOrder(Mesh & mesh)
+{
+    std::vector<unsigned int> indices;
+    for (size_t t = 0; t < mesh.triangles.size(); t++)
+        indices.insert(indices.end(), mesh.triangles[t].v, mesh.triangles[t].v + 3);
+    optimizeVertexCache(indices.data(), indices.size(), mesh.positions.size());
+    for (size_t t = 0; t < mesh.triangles.size(); t++)
+        mesh.triangles[t] = Triangle(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]);
+}
+
+bool facesAway(const Mesh & mesh, const Triangle & triangle, const glm::vec3 & eye)
+{
+    glm::vec3 a(mesh.positions[triangle.v[0]][0], mesh.positions[triangle.v[0]][1], mesh.positions[triangle.v[0]][2]);
+    glm::vec3 b(mesh.positions[triangle.v[1]][0], mesh.positions[triangle.v[1]][1], mesh.positions[triangle.v[1]][2]);
+    glm::vec3 c(mesh.positions[triangle.v[2]][0], mesh.positions[triangle.v[2]][1], mesh.positions[triangle.v[2]][2]);
+    return glm::dot(glm::cross(b - a, c - a), a - eye) >= 0.0f;
+}
+
+// the limits the game builds with, the defaults of buildMeshlets
+const size_t MAX_VERTICES = 64;
+const size_t MAX_TRIANGLES = 124;
+
+void report(const char * fileName)
+{
+    Mesh mesh;
+    if (!loadRaw(fileName, mesh))
+        return;
+    cacheOrder(mesh);
+
+    MeshletData data;
+    auto start = std::chrono::steady_clock::now();
+    buildMeshlets(mesh, data, MAX_VERTICES, MAX_TRIANGLES);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t narrow = 0;
+    for (size_t m = 0; m < data.bounds.size(); m++)
+        narrow += data.bounds[m].coneCutoff < 1.0f;
+    std::cout << fileName << ": " << mesh.triangles.size() << " triangles, " << data.meshlets.size() << " meshlets in "
+              << std::fixed << std::setprecision(2) << ms << " ms, on average "
+              << std::setprecision(1) << data.vertices.size() / double(data.meshlets.size()) << " vertices and "
+              << mesh.triangles.size() / double(data.meshlets.size()) << " triangles, "
+              << narrow << " with a cone narrow enough to cull" << std::endl;
+
+    // the game's main camera
+    glm::mat4 projection = glm::perspective(glm::pi<float>() / 4.0f, 600.0f / 800.0f, 0.1f, 30.0f);
+    glm::vec3 eye(0.0f, 12.0f, 0.0f);
+    glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    Placement placement = placementOf(fileName);
+
+    size_t headings = 12, total = 0, frustum = 0, cone = 0, away = 0;
+    for (size_t h = 0; h < headings; h++) {
+        float angle = 2.0f * glm::pi<float>() * h / headings;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), placement.position) *
+                          glm::rotate(glm::mat4(1.0f), -angle, glm::vec3(0.0f, 1.0f, 0.0f)) *
+                          glm::scale(glm::mat4(1.0f), glm::vec3(placement.scale));
+        // test in model space: planes of the whole transform, eye brought back through the model
+        float planes[6][4];
+        frustumPlanes(glm::value_ptr(projection * view * model), planes);
+        glm::vec3 localEye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+        for (size_t m = 0; m < data.meshlets.size(); m++) {
+            size_t count = data.meshlets[m].triangleCount;
+            total += count;
+            if (frustumCulled(data.bounds[m], planes))
+                frustum += count;
+            else if (backfaceCulled(data.bounds[m], glm::value_ptr(localEye)))
+                cone += count;
+        }
+        for (size_t t = 0; t < mesh.triangles.size(); t++)
+            away += facesAway(mesh, mesh.triangles[t], localEye);
+    }
+    std::cout << "  top-down camera, " << headings << " headings: " << std::setprecision(1)
+              << 100.0 * frustum / total << "% of the triangles culled by the frustum, "
+              << 100.0 * cone / total << "% by the normal cones ("
+              << 100.0 * away / total << "% face away), clusters filled to "
+              << 100.0 * data.vertices.size() / (MAX_VERTICES * data.meshlets.size()) << "% of their vertices and "
+              << 100.0 * mesh.triangles.size() / (MAX_TRIANGLES * data.meshlets.size()) << "% of their triangles" << std::endl;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++)
+            report(argv[i]);
+    } else {
+        report("aatrox_low.obj");
+        report("boss_low.obj");
+    }
+    return 0;
+}
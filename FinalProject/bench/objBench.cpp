@@ -0,0 +1,225 @@
+// OBJ loading benchmark: the old fgets/sscanf Mesh loader, tinyobj::LoadObj
+// and the streaming parser (objParser.h), serial and chunked over a thread pool,
+// on the OBJ assets of the game and on a large file made of repeated assets.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries/glm -I libraries/tinyobjloader -I libraries bench/objBench.cpp objParser.cpp mappedFile.cpp mesh.cpp meshKernels.cpp threadPool.cpp -o objBench
+//   ./objBench [file.obj ...]
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "mesh.h"
+#include "objParser.h"
+#include "mappedFile.h"
+#include "threadPool.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const int RUNS = 10;
+
+// The Mesh::loadMesh parsing loop before the streaming parser replaced it (positions and faces only)
+bool legacyLoad(const char * filename, std::vector<Vertex> & vertices, std::vector<Triangle> & triangles)
+{
+    std::vector<int> vhandles;
+    const unsigned int LINE_LEN = 256;
+    char s[LINE_LEN];
+    FILE * in = fopen(filename, "r");
+    if (!in)
+        return false;
+
+    float x, y, z;
+    while (in && !feof(in) && fgets(s, LINE_LEN, in)) {
+        if (strncmp(s, "v ", 2) == 0) {
+            if (sscanf(s, "v %f %f %f", &x, &y, &z))
+                vertices.push_back(Vertex(Vec3Df(x, y, z)));
+        }
+        else if (strncmp(s, "f ", 2) == 0) {
+            int component(0);
+            bool endOfVertex(false);
+            char *p0, *p1(s + 2);
+            vhandles.clear();
+            while (*p1 == ' ') ++p1;
+            while (p1) {
+                p0 = p1;
+                while (*p1 != '/' && *p1 != '\r' && *p1 != '\n' && *p1 != ' ' && *p1 != '\0')
+                    ++p1;
+                if (*p1 != '/') endOfVertex = true;
+                if (*p1 != '\0') {
+                    *p1 = '\0';
+                    p1++;
+                }
+                if (*p1 == '\0' || *p1 == '\n')
+                    p1 = 0;
+                if (*p0 != '\0' && component == 0)
+                    vhandles.push_back(atoi(p0) - 1);
+                ++component;
+                if (endOfVertex) {
+                    component = 0;
+                    endOfVertex = false;
+                }
+            }
+            for (unsigned int i = 0; i + 2 < vhandles.size(); ++i)
+                triangles.push_back(Triangle(vhandles[0], vhandles[i + 1], vhandles[i + 2]));
+        }
+        memset(&s, 0, LINE_LEN);
+    }
+    fclose(in);
+    return true;
+}
+
+// best of RUNS, in milliseconds
+double bestTime(const std::function<bool()> & run)
+{
+    double best = 1e30;
+    for (int i = 0; i < RUNS; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!run())
+            return -1.0;
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+bool sameObj(const ObjData & a, const ObjData & b)
+{
+    return a.positions == b.positions && a.texcoords == b.texcoords && a.normals == b.normals &&
+           a.indices.size() == b.indices.size() &&
+           (a.indices.empty() || memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(ObjIndex)) == 0);
+}
+
+std::string cell(double ms, double mb)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << ms << " (" << std::setprecision(0) << mb / (ms / 1000.0) << ")";
+    return out.str();
+}
+
+// largest difference between the streaming parser and tinyobj, -1 when the topology differs
+double compareWithTinyobj(const ObjData & obj, const tinyobj::attrib_t & attrib, const std::vector<tinyobj::shape_t> & shapes)
+{
+    if (obj.positions.size() != attrib.vertices.size() || obj.normals.size() != attrib.normals.size() ||
+        obj.texcoords.size() != attrib.texcoords.size())
+        return -1.0;
+    double diff = 0.0;
+    for (size_t i = 0; i < obj.positions.size(); i++)
+        diff = std::max(diff, (double)fabs(obj.positions[i] - attrib.vertices[i]));
+    for (size_t i = 0; i < obj.normals.size(); i++)
+        diff = std::max(diff, (double)fabs(obj.normals[i] - attrib.normals[i]));
+    for (size_t i = 0; i < obj.texcoords.size(); i++)
+        diff = std::max(diff, (double)fabs(obj.texcoords[i] - attrib.texcoords[i]));
+
+    size_t corner = 0;
+    for (size_t s = 0; s < shapes.size(); s++) {
+        const std::vector<tinyobj::index_t> & indices = shapes[s].mesh.indices;
+        for (size_t i = 0; i < indices.size(); i++, corner++) {
+            if (corner >= obj.indices.size() || obj.indices[corner].vertex != indices[i].vertex_index ||
+                obj.indices[corner].texcoord != indices[i].texcoord_index || obj.indices[corner].normal != indices[i].normal_index)
+                return -1.0;
+        }
+    }
+    return corner == obj.indices.size() ? diff : -1.0;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+        files.push_back(argv[i]);
+    if (files.empty()) {
+        const char * defaults[] = { "aatrox_low.obj", "aatrox_high.obj", "anivia_start.obj", "boss.obj", "iceberg.obj" };
+        files.assign(defaults, defaults + sizeof(defaults) / sizeof(defaults[0]));
+    }
+
+    ThreadPool pool;
+    std::cout << "best of " << RUNS << " runs, ms (MB/s), parallel on " << pool.size() << " workers + caller" << std::endl;
+    std::cout << std::left << std::setw(20) << "file" << std::right << std::setw(8) << "MB"
+              << std::setw(18) << "old loadMesh" << std::setw(18) << "tinyobj" << std::setw(18) << "objParser"
+              << std::setw(18) << "objParser par" << std::setw(18) << "Mesh::loadMesh" << std::setw(12) << "max diff" << std::endl;
+    std::cout << std::fixed;
+
+    std::string large;
+    for (size_t f = 0; f <= files.size(); f++) {
+        // the last row parses every file repeated into one large buffer
+        bool synthetic = f == files.size();
+        std::string contents;
+        std::string name;
+        if (synthetic) {
+            if (large.empty())
+                break;
+            contents.swap(large);
+            name = "all x16";
+        }
+        else {
+            name = files[f];
+            std::ifstream in(name.c_str(), std::ios::binary);
+            if (!in) {
+                std::cerr << "cannot open " << name << std::endl;
+                continue;
+            }
+            contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            // repeated copies keep their absolute indices, which stay in range
+            for (int i = 0; i < 16; i++)
+                large += contents + "\n";
+        }
+        const char * file = name.c_str();
+        double mb = contents.size() / (1024.0 * 1024.0);
+
+        double legacy = synthetic ? -1.0 : bestTime([file]() {
+            std::vector<Vertex> vertices;
+            std::vector<Triangle> triangles;
+            return legacyLoad(file, vertices, triangles);
+        });
+
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        double tiny = bestTime([&contents, &attrib, &shapes]() {
+            std::istringstream stream(contents);
+            std::vector<tinyobj::material_t> materials;
+            std::string err;
+            attrib = tinyobj::attrib_t();
+            shapes.clear();
+            return tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &stream);
+        });
+
+        ObjData serial, parallel;
+        double stream = bestTime([&contents, &serial]() {
+            std::string err;
+            return parseObj(contents.data(), contents.size(), serial, err);
+        });
+        double chunked = bestTime([&contents, &parallel, &pool]() {
+            std::string err;
+            return parseObj(contents.data(), contents.size(), parallel, err, &pool);
+        });
+
+        // includes recentering, normals and bounds like the game does
+        double mesh = synthetic ? -1.0 : bestTime([file]() {
+            Mesh m;
+            return m.loadMesh(file);
+        });
+
+        std::cout << std::left << std::setw(20) << name << std::right << std::setprecision(2) << std::setw(8) << mb;
+        double times[] = { legacy, tiny, stream, chunked, mesh };
+        for (int i = 0; i < 5; i++)
+            std::cout << std::setw(18) << (times[i] < 0.0 ? std::string("-") : cell(times[i], mb));
+        if (!sameObj(serial, parallel))
+            std::cout << std::setw(12) << "PAR DIFFERS" << std::endl;
+        else
+            std::cout << std::setw(12) << std::setprecision(7) << compareWithTinyobj(serial, attrib, shapes) << std::endl;
+    }
+    return 0;
+}
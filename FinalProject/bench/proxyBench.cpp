@@ -0,0 +1,185 @@
+// Collision proxy benchmark: builds the ConvexProxy of the Anivia, Aatrox and boss morph
+// poses, checks that every vertex of random pose blends lies inside it, then times the
+// enemy / Anivia contact test of the game against the convex hulls of the full blended
+// meshes and counts how often the proxies and the old center distance test
+// (anivia.safeDistance 2) disagree with those hulls.
+//
+// Build and run from the FinalProject directory:
+//   g++ -O2 -std=c++11 -pthread -I libraries bench/proxyBench.cpp collisionProxy.cpp meshBvh.cpp objParser.cpp mappedFile.cpp threadPool.cpp -o proxyBench
+//   ./proxyBench
+
+#include "collisionProxy.h"
+#include "meshBvh.h"
+#include "objParser.h"
+
+#include <math.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Character {
+    std::string name;
+    std::vector<std::vector<float> > poses;
+    ConvexProxy proxy;
+    float size;
+
+    // the blended vertices as a proxy of one pose without margin: their exact convex hull
+    ConvexProxy hull(const float * weights) const
+    {
+        std::vector<float> data(1 + poses[0].size(), 0.0f);
+        for (size_t p = 0; p < poses.size(); p++)
+            for (size_t i = 0; i < poses[p].size(); i++)
+                data[1 + i] += weights[p] * poses[p][i];
+        ConvexProxy exact;
+        exact.addPose(data.data(), data.size());
+        return exact;
+    }
+};
+
+// the pose OBJs share their vertex numbering
+bool load(const std::string & name, const std::vector<std::string> & files, Character & character)
+{
+    character.name = name;
+    for (size_t i = 0; i < files.size(); i++) {
+        ObjData obj;
+        std::string err;
+        if (!loadObj(files[i].c_str(), obj, err)) {
+            std::cerr << files[i] << ": " << err << std::endl;
+            return false;
+        }
+        if (i > 0 && obj.positions.size() != character.poses[0].size()) {
+            std::cerr << files[i] << ": the poses do not share their vertices" << std::endl;
+            return false;
+        }
+        character.poses.push_back(obj.positions);
+    }
+    std::vector<const float *> pointers;
+    for (size_t p = 0; p < character.poses.size(); p++)
+        pointers.push_back(character.poses[p].data());
+    auto start = std::chrono::steady_clock::now();
+    character.proxy.build(pointers, character.poses[0].size() / 3, 3 * sizeof(float));
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+    for (size_t i = 0; i < character.poses[0].size(); i++) {
+        low[i % 3] = std::min(low[i % 3], character.poses[0][i]);
+        high[i % 3] = std::max(high[i % 3], character.poses[0][i]);
+    }
+    character.size = std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]);
+
+    std::cout << name << ": " << character.poses[0].size() / 3 << " vertices, " << character.poses.size()
+              << " poses, proxy built in " << std::fixed << std::setprecision(1) << ms << " ms" << std::endl;
+    for (size_t p = 0; p < character.proxy.poseCount(); p++)
+        std::cout << "  " << files[p] << ": " << character.proxy.pointCount(p) << " points, margin "
+                  << std::setprecision(4) << character.proxy.margin(p) << " ("
+                  << std::setprecision(2) << 100.0f * character.proxy.margin(p) / character.size << "% of the size)" << std::endl;
+    return true;
+}
+
+ProxyPlacement placement(float x, float y, float z, float angle, float scale)
+{
+    // turned by -angle about y, like Model::toWorldSpace
+    float c = cosf(angle), s = sinf(-angle);
+    ProxyPlacement place = { { x, y, z }, { c, 0.0f, s, 0.0f, 1.0f, 0.0f, -s, 0.0f, c }, scale };
+    return place;
+}
+
+const ProxyPlacement identity = placement(0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+// every vertex of random blends lies inside the proxy in that blend
+void checkContained(const Character & character, std::mt19937 & random)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> weights(character.poses.size()), factors(weights.size() - 1);
+    size_t tested = 0, outside = 0;
+    for (int blend = 0; blend < 20; blend++) {
+        for (size_t f = 0; f < factors.size(); f++)
+            factors[f] = blend == 0 ? 0.0f : unit(random);
+        MeshBvh::mixWeights(factors.data(), factors.size(), weights.data());
+        for (size_t v = 0; v < character.poses[0].size(); v += 3 * 7) {
+            float data[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (size_t p = 0; p < weights.size(); p++)
+                for (int k = 0; k < 3; k++)
+                    data[1 + k] += weights[p] * character.poses[p][v + k];
+            ConvexProxy vertex;
+            vertex.addPose(data, 4);
+            float one = 1.0f;
+            tested++;
+            outside += ConvexProxy::distance(character.proxy, weights.data(), identity, vertex, &one, identity) > 0.0f;
+        }
+    }
+    std::cout << "  " << outside << " of " << tested << " blended vertices outside the proxy" << std::endl;
+}
+
+double microseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Anivia at (0 0 -3) at scale 1 and an enemy at scale 0.2 turned half a circle, as the game
+// places them, with the enemy in a 6 x 6 square around Anivia and both in random poses
+void contact(const Character & anivia, const Character & aatrox, std::mt19937 & random)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const size_t PAIRS = 2000;
+    size_t hullHits = 0, proxyHits = 0, oldHits = 0, proxyWrong = 0, proxyMissed = 0, oldWrong = 0, oldMissed = 0;
+    double proxyTime = 0.0, hullTime = 0.0, oldTime = 0.0;
+    const ProxyPlacement aniviaPlace = placement(0.0f, 0.0f, -3.0f, 0.0f, 1.0f);
+    for (size_t i = 0; i < PAIRS; i++) {
+        float aniviaFactors[3] = { unit(random), unit(random), 0.0f }, aniviaWeights[4];
+        float enemyFactors[2] = { unit(random), 0.0f }, enemyWeights[3];
+        MeshBvh::mixWeights(aniviaFactors, 3, aniviaWeights);
+        MeshBvh::mixWeights(enemyFactors, 2, enemyWeights);
+        float x = -3.0f + 6.0f * unit(random), z = -6.0f + 6.0f * unit(random);
+        ProxyPlacement enemyPlace = placement(x, 0.0f, z, 3.14159f, 0.2f);
+
+        ConvexProxy aniviaHull = anivia.hull(aniviaWeights), enemyHull = aatrox.hull(enemyWeights);
+        float one = 1.0f;
+        auto t = std::chrono::steady_clock::now();
+        bool reference = ConvexProxy::overlap(enemyHull, &one, enemyPlace, aniviaHull, &one, aniviaPlace);
+        hullTime += microseconds(t);
+        t = std::chrono::steady_clock::now();
+        bool proxy = ConvexProxy::overlap(aatrox.proxy, enemyWeights, enemyPlace, anivia.proxy, aniviaWeights, aniviaPlace);
+        proxyTime += microseconds(t);
+        t = std::chrono::steady_clock::now();
+        volatile bool old = x * x + (z + 3.0f) * (z + 3.0f) <= 4.0f;
+        oldTime += microseconds(t);
+
+        hullHits += reference;
+        proxyHits += proxy;
+        oldHits += old;
+        proxyWrong += proxy && !reference;
+        proxyMissed += !proxy && reference;
+        oldWrong += old && !reference;
+        oldMissed += !old && reference;
+    }
+    std::cout << "enemy / Anivia contact, " << PAIRS << " random pairs: the hulls of the full meshes touch in "
+              << hullHits << std::endl;
+    std::cout << "  proxies: " << std::setprecision(2) << proxyTime / PAIRS << " us per pair, " << proxyHits << " hits, "
+              << proxyWrong << " where the hulls are apart, " << proxyMissed << " missed" << std::endl;
+    std::cout << "  full hulls: " << hullTime / PAIRS << " us per pair" << std::endl;
+    std::cout << "  old distance test: " << oldTime / PAIRS << " us per pair, " << oldHits << " hits, "
+              << oldWrong << " where the hulls are apart, " << oldMissed << " missed" << std::endl;
+}
+
+}
+
+int main()
+{
+    std::mt19937 random(11);
+    Character anivia, aatrox, boss;
+    if (!load("anivia", { "anivia_start.obj", "anivia_open_wing.obj", "anivia_attack.obj", "anivia_dead.obj" }, anivia) ||
+        !load("aatrox", { "aatrox_low.obj", "aatrox_high.obj", "aatrox_dead.obj" }, aatrox) ||
+        !load("boss", { "boss_low.obj", "boss_high.obj", "boss_attack.obj" }, boss))
+        return 1;
+    checkContained(anivia, random);
+    checkContained(aatrox, random);
+    checkContained(boss, random);
+    contact(anivia, aatrox, random);
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "collisionProxy.h"
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+namespace {
+
+//GJK gives up after this many support points, it converges in far fewer on hulls of a few dozen points
+const int MAX_ITERATIONS = 64;
+//relative gap between the upper and lower bound on the distance at which GJK stops
+const double TOLERANCE = 1e-6;
+
+struct Vec {
+    double x, y, z;
+
+    inline Vec() : x(0.0), y(0.0), z(0.0) {}
+    inline Vec(double x, double y, double z) : x(x), y(y), z(z) {}
+    inline Vec operator+(const Vec & o) const { return Vec(x + o.x, y + o.y, z + o.z); }
+    inline Vec operator-(const Vec & o) const { return Vec(x - o.x, y - o.y, z - o.z); }
+    inline Vec operator-() const { return Vec(-x, -y, -z); }
+    inline Vec operator*(double s) const { return Vec(x * s, y * s, z * s); }
+};
+
+inline double dot(const Vec & a, const Vec & b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec cross(const Vec & a, const Vec & b) { return Vec(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+//index of the point of points[0 .. count) furthest along d
+inline size_t furthest(const float * points, size_t count, const float * d)
+{
+    size_t best = 0;
+    float bestDot = -FLT_MAX;
+    for (size_t i = 0; i < count; i++) {
+        const float * p = points + 3 * i;
+        float t = p[0] * d[0] + p[1] * d[1] + p[2] * d[2];
+        if (t > bestDot) {
+            bestDot = t;
+            best = i;
+        }
+    }
+    return best;
+}
+
+struct PointShape {
+    Vec p;
+    inline Vec support(const Vec &) const { return p; }
+};
+
+//the hull of one pose of a proxy, in mesh space
+struct HullShape {
+    const float * points;
+    size_t count;
+    inline Vec support(const Vec & d) const {
+        float f[3] = { float(d.x), float(d.y), float(d.z) };
+        const float * p = points + 3 * furthest(points, count, f);
+        return Vec(p[0], p[1], p[2]);
+    }
+};
+
+//a blended proxy where a placement puts it in the world
+struct PlacedShape {
+    const ConvexProxy * proxy;
+    const float * weights;
+    const ProxyPlacement * place;
+    inline Vec support(const Vec & d) const {
+        //the mesh space direction is the world one turned back, the scale does not change the furthest point
+        const float * r = place->rotation;
+        float local[3] = { float(r[0] * d.x + r[3] * d.y + r[6] * d.z),
+                           float(r[1] * d.x + r[4] * d.y + r[7] * d.z),
+                           float(r[2] * d.x + r[5] * d.y + r[8] * d.z) };
+        float p[3];
+        proxy->support(local, weights, p);
+        double s = place->scale;
+        return Vec(place->offset[0] + s * (r[0] * p[0] + r[1] * p[1] + r[2] * p[2]),
+                   place->offset[1] + s * (r[3] * p[0] + r[4] * p[1] + r[5] * p[2]),
+                   place->offset[2] + s * (r[6] * p[0] + r[7] * p[1] + r[8] * p[2]));
+    }
+};
+
+//corners of A - B kept by GJK, the closest point to the origin is a blend of them
+struct Simplex {
+    Vec w[4];
+    int count;
+
+    inline void keep(const Vec & a) { w[0] = a; count = 1; }
+    inline void keep(const Vec & a, const Vec & b) { w[0] = a; w[1] = b; count = 2; }
+    inline void keep(const Vec & a, const Vec & b, const Vec & c) { w[0] = a; w[1] = b; w[2] = c; count = 3; }
+};
+
+//closest point of segment ab to the origin, the simplex keeps the corners it lies between
+//(the corners are copies, they may be the simplex's own)
+Vec closestOnSegment(Simplex & s, Vec a, Vec b)
+{
+    Vec ab = b - a;
+    double t = -dot(a, ab);
+    if (t <= 0.0) {
+        s.keep(a);
+        return a;
+    }
+    double length2 = dot(ab, ab);
+    if (t >= length2) {
+        s.keep(b);
+        return b;
+    }
+    s.keep(a, b);
+    return a + ab * (t / length2);
+}
+
+//closest point of triangle abc to the origin by its Voronoi regions (Ericson, Real-Time Collision Detection 5.1.5)
+Vec closestOnTriangle(Simplex & s, Vec a, Vec b, Vec c)
+{
+    Vec ab = b - a, ac = c - a, ap = -a;
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0) {
+        s.keep(a);
+        return a;
+    }
+    Vec bp = -b;
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3) {
+        s.keep(b);
+        return b;
+    }
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+        s.keep(a, b);
+        return a + ab * (d1 / (d1 - d3));
+    }
+    Vec cp = -c;
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6) {
+        s.keep(c);
+        return c;
+    }
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+        s.keep(a, c);
+        return a + ac * (d2 / (d2 - d6));
+    }
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) {
+        s.keep(b, c);
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    double denominator = va + vb + vc;
+    if (denominator <= 0.0) {
+        //a sliver, its edges hold the closest point
+        Simplex edge;
+        Vec best = closestOnSegment(s, a, b);
+        Vec p = closestOnSegment(edge, b, c);
+        if (dot(p, p) < dot(best, best)) {
+            best = p;
+            s = edge;
+        }
+        p = closestOnSegment(edge, a, c);
+        if (dot(p, p) < dot(best, best)) {
+            best = p;
+            s = edge;
+        }
+        return best;
+    }
+    s.keep(a, b, c);
+    return a + ab * (vb / denominator) + ac * (vc / denominator);
+}
+
+//closest point of the simplex to the origin, dropping the corners it does not need;
+//a tetrahedron holding the origin stays whole
+Vec closestOnSimplex(Simplex & s)
+{
+    if (s.count == 1)
+        return s.w[0];
+    if (s.count == 2)
+        return closestOnSegment(s, s.w[0], s.w[1]);
+    if (s.count == 3)
+        return closestOnTriangle(s, s.w[0], s.w[1], s.w[2]);
+
+    //the faces the origin is outside of (or level with, which also covers a flat tetrahedron)
+    static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+    Simplex tetrahedron = s;
+    bool inside = true;
+    Vec best;
+    double bestDistance = DBL_MAX;
+    for (int f = 0; f < 4; f++) {
+        const Vec & a = tetrahedron.w[faces[f][0]];
+        const Vec & b = tetrahedron.w[faces[f][1]];
+        const Vec & c = tetrahedron.w[faces[f][2]];
+        const Vec & d = tetrahedron.w[faces[f][3]];
+        Vec normal = cross(b - a, c - a);
+        if (dot(-a, normal) * dot(d - a, normal) > 0.0)
+            continue;
+        inside = false;
+        Simplex face;
+        Vec p = closestOnTriangle(face, a, b, c);
+        if (dot(p, p) < bestDistance) {
+            bestDistance = dot(p, p);
+            best = p;
+            s = face;
+        }
+    }
+    return inside ? Vec() : best;
+}
+
+//distance between the convex shapes a and b; with early set it stops as soon as it knows
+//whether the distance is within limit, returning a value on the right side of limit
+template <class A, class B>
+double gjk(const A & a, const B & b, bool early, double limit)
+{
+    Simplex simplex;
+    simplex.count = 0;
+    Vec v = a.support(Vec(1.0, 0.0, 0.0)) - b.support(Vec(-1.0, 0.0, 0.0));
+    for (int i = 0; i < MAX_ITERATIONS; i++) {
+        double vv = dot(v, v);
+        if (vv <= DBL_MIN || (early && vv <= limit * limit))
+            return sqrt(vv);
+        Vec w = a.support(-v) - b.support(v);
+        //w . v / |v| is a lower bound on the distance, |v| an upper one
+        double vw = dot(v, w);
+        if (early && vw > 0.0 && vw * vw > limit * limit * vv)
+            return vw / sqrt(vv);
+        if (vv - vw <= TOLERANCE * vv)
+            return sqrt(vv);
+        for (int k = 0; k < simplex.count; k++) {
+            Vec e = simplex.w[k] - w;
+            if (dot(e, e) <= TOLERANCE * TOLERANCE * vv)
+                return sqrt(vv);
+        }
+        simplex.w[simplex.count++] = w;
+        v = closestOnSimplex(simplex);
+        if (simplex.count == 4)
+            return 0.0;
+    }
+    return sqrt(dot(v, v));
+}
+
+}
+
+ConvexProxy::ConvexProxy() : first(1, 0) {}
+
+void ConvexProxy::clear()
+{
+    points.clear();
+    first.assign(1, 0);
+    margins.clear();
+}
+
+void ConvexProxy::build(const std::vector<const float *> & poses, size_t vertexCount, size_t stride, size_t directionCount)
+{
+    clear();
+    if (vertexCount == 0)
+        return;
+
+    //directions spread evenly over the sphere along a Fibonacci spiral
+    std::vector<float> directions(3 * directionCount);
+    const double golden = 3.14159265358979323846 * (3.0 - sqrt(5.0));
+    for (size_t i = 0; i < directionCount; i++) {
+        double y = 1.0 - (2.0 * i + 1.0) / directionCount;
+        double r = sqrt(std::max(0.0, 1.0 - y * y));
+        directions[3 * i] = float(r * cos(golden * i));
+        directions[3 * i + 1] = float(y);
+        directions[3 * i + 2] = float(r * sin(golden * i));
+    }
+
+    std::vector<float> vertices(3 * vertexCount);
+    std::vector<char> picked(vertexCount);
+    for (size_t p = 0; p < poses.size(); p++) {
+        const char * base = reinterpret_cast<const char *>(poses[p]);
+        for (size_t v = 0; v < vertexCount; v++) {
+            const float * position = reinterpret_cast<const float *>(base + v * stride);
+            vertices[3 * v] = position[0];
+            vertices[3 * v + 1] = position[1];
+            vertices[3 * v + 2] = position[2];
+        }
+
+        //the vertex touching each face of the k-DOP, once
+        std::fill(picked.begin(), picked.end(), 0);
+        size_t begin = points.size();
+        for (size_t d = 0; d < directionCount; d++) {
+            size_t v = furthest(vertices.data(), vertexCount, &directions[3 * d]);
+            if (picked[v])
+                continue;
+            picked[v] = 1;
+            points.insert(points.end(), &vertices[3 * v], &vertices[3 * v] + 3);
+        }
+        first.push_back(points.size());
+
+        //the margin reaches the vertex furthest outside their hull; the early test skips
+        //every vertex closer than the margin found so far
+        HullShape hull = { &points[begin], (points.size() - begin) / 3 };
+        double margin = 0.0;
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (picked[v])
+                continue;
+            PointShape vertex = { Vec(vertices[3 * v], vertices[3 * v + 1], vertices[3 * v + 2]) };
+            if (gjk(vertex, hull, true, margin) > margin)
+                margin = std::max(margin, gjk(vertex, hull, false, 0.0));
+        }
+        //rounded up so the float margin still covers the vertex
+        margins.push_back(float(margin) * (1.0f + FLT_EPSILON) + FLT_MIN);
+    }
+}
+
+void ConvexProxy::savePose(size_t pose, std::vector<float> & data) const
+{
+    data.assign(1, margins[pose]);
+    data.insert(data.end(), points.begin() + first[pose], points.begin() + first[pose + 1]);
+}
+
+bool ConvexProxy::addPose(const float * data, size_t size)
+{
+    if (size < 4 || (size - 1) % 3 != 0 || !(data[0] >= 0.0f))
+        return false;
+    margins.push_back(data[0]);
+    points.insert(points.end(), data + 1, data + size);
+    first.push_back(points.size());
+    return true;
+}
+
+void ConvexProxy::support(const float * direction, const float * weights, float * point) const
+{
+    point[0] = point[1] = point[2] = 0.0f;
+    for (size_t p = 0; p < margins.size(); p++) {
+        if (weights[p] == 0.0f)
+            continue;
+        const float * pose = &points[first[p]];
+        const float * s = pose + 3 * furthest(pose, pointCount(p), direction);
+        for (int k = 0; k < 3; k++)
+            point[k] += weights[p] * s[k];
+    }
+}
+
+float ConvexProxy::blendedMargin(const float * weights) const
+{
+    float m = 0.0f;
+    for (size_t p = 0; p < margins.size(); p++)
+        m += weights[p] * margins[p];
+    return m;
+}
+
+float ConvexProxy::distance(const ConvexProxy & a, const float * weightsA, const ProxyPlacement & placeA,
+                            const ConvexProxy & b, const float * weightsB, const ProxyPlacement & placeB)
+{
+    PlacedShape shapeA = { &a, weightsA, &placeA };
+    PlacedShape shapeB = { &b, weightsB, &placeB };
+    double margins = placeA.scale * a.blendedMargin(weightsA) + placeB.scale * b.blendedMargin(weightsB);
+    return float(std::max(0.0, gjk(shapeA, shapeB, false, 0.0) - margins));
+}
+
+bool ConvexProxy::overlap(const ConvexProxy & a, const float * weightsA, const ProxyPlacement & placeA,
+                          const ConvexProxy & b, const float * weightsB, const ProxyPlacement & placeB)
+{
+    PlacedShape shapeA = { &a, weightsA, &placeA };
+    PlacedShape shapeB = { &b, weightsB, &placeB };
+    double margins = placeA.scale * a.blendedMargin(weightsA) + placeB.scale * b.blendedMargin(weightsB);
+    return gjk(shapeA, shapeB, true, margins) <= margins;
+}
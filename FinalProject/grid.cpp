@@ -1,11 +1,12 @@
 #include "grid.h"
 #include "mesh.h"
+#include <string.h>
 #include <vector>
 #ifdef WIN32
 #include <windows.h>
 #endif
 
-int Grid::isContainedAt(const Vec3Df & pos){
+long long Grid::isContainedAt(const Vec3Df & pos){
     //returns index that contains the position
 	float cubeLength = size / r;
 
@@ -13,38 +14,57 @@ int Grid::isContainedAt(const Vec3Df & pos){
 	int x = v[0] / cubeLength;
 	int y = v[1] / cubeLength;
 	int z = v[2] / cubeLength;
+	if (x < 0 || y < 0 || z < 0 || x >= (int)r || y >= (int)r || z >= (int)r)
+		return -1;
 
-	int indice = x + r * y + r * r*z;
-	return indice;
+	return (long long)cellKey(x, y, z, r);
 }
 
 void Grid::addToCell(const Vec3Df & vertexPos) {
-	int nr = isContainedAt(vertexPos);
-	std::vector<Vec3Df> list = verticesInCell[nr];
-	list.push_back(vertexPos);
-	verticesInCell[nr] = list;
+	points.push_back(vertexPos);
 }
 
-void Grid::putVertices(const std::vector<Vertex> & vertices){
+void Grid::putVertices(const std::vector<Vec3Df> & positions){
     //put vertices in the corresponding voxels.
-	for (int i = 0; i < vertices.size(); i++) {
-		addToCell(vertices[i].p);
-	}
+	points.insert(points.end(), positions.begin(), positions.end());
 }
 
 void Grid::computeRepresentatives() {
-	for (int i = 0; i < r*r*r; i++) {
-		std::vector<Vec3Df> list = verticesInCell[i];
-		if (list.size() > 0) {
-			Vec3Df p = Vec3Df(0, 0, 0);
-			Vec3Df n = Vec3Df(0, 0, 0);
-			for (std::vector<Vec3Df>::iterator it = list.begin(); it != list.end(); ++it) {
-				p = p + *it;
-			}
-			p = p / list.size();
-			representatives[i] = Vertex(p, n);
-		}
-	}
+	//only the occupied cells are visited, each is one run of the sorted points
+	representatives.clear();
+	if (points.empty())
+		return;
+	cells.build(&points[0][0], points.size(), sizeof(Vec3Df), &origin[0], size, r);
+
+	std::vector<float> average;
+	cells.averagePositions(&points[0][0], sizeof(Vec3Df), average);
+	storeRepresentatives(average);
+}
+
+void Grid::computeRepresentatives(const std::vector<Triangle> & triangles) {
+	representatives.clear();
+	if (points.empty())
+		return;
+	cells.build(&points[0][0], points.size(), sizeof(Vec3Df), &origin[0], size, r);
+
+	//triangles are index triplets, read in place
+	std::vector<float> optimal;
+	cells.quadricPositions(&points[0][0], sizeof(Vec3Df), triangles.empty() ? 0 : triangles[0].v, 3 * triangles.size(), optimal);
+	storeRepresentatives(optimal);
+}
+
+void Grid::storeRepresentatives(const std::vector<float> & positions) {
+	representatives.resize(cells.clusterCount());
+	if (!representatives.empty())
+		memcpy(&representatives[0][0], positions.data(), representatives.size() * sizeof(Vec3Df));
+}
+
+Vec3Df Grid::getRepresentative(const Vec3Df & pos) {
+	long long cell = isContainedAt(pos);
+	long long cluster = cell < 0 ? -1 : cells.findCell((uint64_t)cell);
+	if (cluster < 0)
+		return pos;
+	return representatives[cluster];
 }
 //
 //void Grid::drawCell(const Vec3Df & Min,const Vec3Df& Max) {
@@ -98,7 +118,7 @@ void Grid::computeRepresentatives() {
 //		for (int y = 0; y < r; y++) {
 //			for (int x = 0; x < r; x++) {
 //				int nr = x + r * y + r * r*z;
-//				if (verticesInCell[nr].size() > 0) {
+//				if (cells.findCell(nr) >= 0) {
 //					float xmin = origin[0] + x * cubeLength;
 //					float ymin = origin[1] + y * cubeLength;
 //					float zmin = origin[2] + z * cubeLength;
@@ -126,59 +146,48 @@ void Grid::computeRepresentatives() {
 //    glPopAttrib();
 //}
 
-Mesh Grid::simplifyMesh(Mesh mesh, unsigned int r) {
+Mesh Grid::clusterMesh(const Mesh & mesh, unsigned int r, Representative mode) {
 	//Create a grid that covers the bounding box of the mesh. 
-	//Be thorough and check all functions, as some of the calls below might NOT directly work and need to be written by you.
-	//It should be considered a guideline, NOT the solution.
-	//Also, use your graphics knowledge to draw for debugging! (e.g., draw the bounding box, the grid etc.)  
 	double offset = 0.01;
 	Vec3Df vecOffset = Vec3Df(offset, offset, offset);
 	Grid grid = Grid(mesh.bbOrigin - vecOffset, mesh.bbEdgeSize + 2 * offset, r);
 
-	//work with a local reference on the vertices and triangles
-	const std::vector<Vertex> & vertices = mesh.vertices;
+	//work with a local reference on the triangles
 	const std::vector<Triangle> & triangles = mesh.triangles;
-
-	//   //Put all the vertices in the grid
-	grid.putVertices(mesh.vertices);
-
-	//	  //calculate a representative vertex for each grid cell
-	grid.computeRepresentatives();
-
-	// //Create a new list of vertices for the simplified model
-	// //What is the effect of the code below?
-	std::map<unsigned int, unsigned int > newIndexRemapping;
-	std::vector<Vertex> simplifiedVertices;
-
-	int count = 0;
-	for (RepresentativeList::iterator it = grid.representatives.begin(); it != grid.representatives.end(); it++, count++) {
-		newIndexRemapping[(*it).first] = count;
-		simplifiedVertices.push_back((*it).second);
-	}
-
-
-	// //Create a new list of triangles
-	// //This is NOT COMPLETE and you need to add code here
-	// //Think about what simplifiedVertices and newIndexRemapping contain
+	if (mesh.positions.empty())
+		return Mesh();
+
+	//sort the vertices into their cells and compute one representative per occupied cell
+	grid.putVertices(mesh.positions);
+	if (mode == REPRESENTATIVE_QUADRIC)
+		grid.computeRepresentatives(triangles);
+	else
+		grid.computeRepresentatives();
+
+	//triangles move to the representatives of their corners, the ones collapsing into one cell disappear
+	const std::vector<unsigned int> & cluster = grid.cells.vertexClusters();
 	std::vector<Triangle> simplifiedTriangles;
+	simplifiedTriangles.reserve(triangles.size());
 	for (int i = 0; i < triangles.size(); i++) {
-		Triangle tr = triangles[i];
-		int indice1 = grid.isContainedAt(vertices[tr.v[0]].p);
-		int indice2 = grid.isContainedAt(vertices[tr.v[1]].p);
-		int indice3 = grid.isContainedAt(vertices[tr.v[2]].p);
+		const Triangle & tr = triangles[i];
+		unsigned int c1 = cluster[tr.v[0]];
+		unsigned int c2 = cluster[tr.v[1]];
+		unsigned int c3 = cluster[tr.v[2]];
 
-		if (indice1 == indice2 && indice1 == indice3) {
+		if (c1 == c2 && c1 == c3) {
 			continue;
 		}
-
-		Triangle trSimple = Triangle(newIndexRemapping[indice1],
-			newIndexRemapping[indice2],
-			newIndexRemapping[indice3]);
-		simplifiedTriangles.push_back(trSimple);
+		simplifiedTriangles.push_back(Triangle(c1, c2, c3));
 	}
 
 	// //Build the simplified mesh from the CORRECT lists
-	Mesh simplified = Mesh(simplifiedVertices, simplifiedTriangles);
+	return Mesh(grid.representatives, simplifiedTriangles);
+}
+
+Mesh Grid::simplifyMesh(const Mesh & mesh, unsigned int r, Representative mode) {
+	Mesh simplified = clusterMesh(mesh, r, mode);
+	if (simplified.positions.empty())
+		return simplified;
 
 	// //recalculate the normals.
 	simplified.centerAndScaleToUnit();
@@ -187,5 +196,53 @@ Mesh Grid::simplifyMesh(Mesh mesh, unsigned int r) {
 	return simplified;
 }
 
+std::vector<Mesh> Grid::simplifyLevels(const Mesh & mesh, const std::vector<unsigned int> & resolutions, Representative mode) {
+	//the grid of clusterMesh, read in place from the mesh vertices
+	double offset = 0.01;
+	Vec3Df vecOffset = Vec3Df(offset, offset, offset);
+	Vec3Df gridOrigin = mesh.bbOrigin - vecOffset;
+	float gridSize = mesh.bbEdgeSize + 2 * offset;
+	const std::vector<Triangle> & triangles = mesh.triangles;
+	std::vector<Mesh> simplified(resolutions.size());
+	if (mesh.positions.empty())
+		return simplified;
+	if (mesh.vertexCount() < LEVELS_PASS_VERTICES) {
+		for (size_t l = 0; l < resolutions.size(); l++)
+			simplified[l] = simplifyMesh(mesh, resolutions[l], mode);
+		return simplified;
+	}
 
+	ClusterLevels levels;
+	levels.build(mesh.positionData(), mesh.vertexCount(), sizeof(Vec3Df), &gridOrigin[0], gridSize, resolutions);
+
+	for (size_t l = 0; l < resolutions.size(); l++) {
+		std::vector<float> positions;
+		if (mode == REPRESENTATIVE_QUADRIC)
+			levels.quadricPositions(l, mesh.positionData(), sizeof(Vec3Df), mesh.indexData(), 3 * triangles.size(), positions);
+		else
+			levels.averagePositions(l, positions);
+
+		Mesh & level = simplified[l];
+		level.positions.resize(levels.clusterCount(l));
+		if (!level.positions.empty())
+			memcpy(&level.positions[0][0], positions.data(), level.positions.size() * sizeof(Vec3Df));
+
+		//same triangle rule as clusterMesh
+		const std::vector<unsigned int> & cluster = levels.vertexClusters(l);
+		level.triangles.reserve(triangles.size());
+		for (size_t i = 0; i < triangles.size(); i++) {
+			const Triangle & tr = triangles[i];
+			unsigned int c1 = cluster[tr.v[0]];
+			unsigned int c2 = cluster[tr.v[1]];
+			unsigned int c3 = cluster[tr.v[2]];
+			if (c1 == c2 && c1 == c3)
+				continue;
+			level.triangles.push_back(Triangle(c1, c2, c3));
+		}
 
+		level.centerAndScaleToUnit();
+		level.computeVertexNormals();
+		level.computeBoundingCube();
+	}
+	return simplified;
+}
@@ -1,6 +1,14 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <vector>
 #include <glm/gtx/intersect.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include "resources.h"
+#include "collisionProxy.h"
+#include "meshBvh.h"
+#include "programReflection.h"
+#include "uniformRing.h"
 
 enum StateType
 {
@@ -58,10 +66,67 @@ struct BossVertex :VertexBasic {
 	glm::vec3 normal_attack;
 };
 
+// one entry of the DrawParameters array of the shaders, std430: a vec3 and a float share 16 bytes, a vec2
+// takes 8, bools are ints, and the entries are 16 byte aligned. Single draws read entry 0, an instanced
+// draw one entry per instance
+struct DrawParameters
+{
+	static const GLuint BINDING = 0;
+
+	glm::vec3 posOffset = { 0, 0, 0 };
+	float rotateAngle = 0.0f;
+	glm::vec3 rotateAxis = { 0, 1, 0 };
+	float scaleFactor = 1.0f;
+	float mixFactorIdle = 0.0f;
+	float mixFactorAttack = 0.0f;
+	float mixFactorDead = 0.0f;
+	float opacity = 1.0f;
+	// added to the texture coordinates, for scrolling textures
+	glm::vec2 texOffset = { 0, 0 };
+	GLint useShadow = GL_FALSE;
+	GLint uniColor = GL_FALSE;
+	GLint onlyWings = GL_FALSE;
+	GLint onlyBody = GL_FALSE;
+	float padding[2] = { 0, 0 };
+};
+static_assert(sizeof(DrawParameters) == 80, "DrawParameters must match the std430 layout of the shader storage block");
+
+// every uniform the draws set, resolved once per program; the shadow program leaves most of them at -1.
+// The per draw parameters go through the ring shared by the programs.
+struct DrawUniforms
+{
+	// per frame
+	Mat4Uniform mvp;
+	Vec3Uniform viewPos;
+	FloatUniform time;
+	Mat4Uniform lightMVP;
+	Vec3Uniform lightPos;
+	SamplerUniform texShadow;
+	// per draw
+	SamplerUniform tex;
+	UniformRing *ring;
+
+	DrawUniforms(const ProgramReflection &program, UniformRing &ring) : ring(&ring)
+	{
+		mvp.resolve(program, "mvp");
+		viewPos.resolve(program, "viewPos");
+		time.resolve(program, "time");
+		lightMVP.resolve(program, "lightMVP");
+		lightPos.resolve(program, "lightPos");
+		texShadow.resolve(program, "texShadow");
+		tex.resolve(program, "tex");
+	}
+	// binds a range holding the parameters of each instance of the next draw
+	void push(const DrawParameters *instances, size_t count) const
+	{
+		ring->push(instances, count);
+	}
+};
+
 class Model
 {	
 public:
-	static int textureCount;
+	static TextureRegistry textures;
 	glm::vec3 position = { 0,0,0 };
 	glm::vec3 rotateAxis = { 0,1,0 };
 	glm::vec2 screenCoor = { 0,0 };
@@ -70,55 +135,131 @@ public:
 	GLuint texture;
 	int textureNumber;
 	GLuint vao, vbo;
-	void loadTexture(char* fileName)
+	GLuint ebo = 0;
+	GLsizei indexCount = 0;
+	// levels of detail in the model buffers and the one picked for this frame
+	LodChain lods;
+	int lodLevel = 0;
+	// triangles of every pose for hit tests, shared by the models drawn with the mesh; null until it is loaded
+	std::shared_ptr<const MeshBvh> hitMesh;
+	// convex stand-in of every pose for contacts between characters, shared like hitMesh
+	std::shared_ptr<const ConvexProxy> proxy;
+	void loadTexture(const char* fileName)
 	{
-		int width, height, channels;
-		stbi_uc* pixels = stbi_load(fileName, &width, &height, &channels, 3);
-
-		// Create Texture
-
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-
-		// Upload pixels into texture
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-
-		//// Set behaviour for when texture coordinates are outside the [0, 1] range
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		//// Set interpolation for texture sampling (GL_NEAREST for no interpolation)
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Set behaviour for when texture coordinates are outside the [0, 1] range
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-		// Set interpolation for texture sampling (GL_NEAREST for no interpolation)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		textureNumber = textureCount++;
+		useTexture(*textures.load(fileName));
+	}
+	// texture decoded ahead of time, shared with every model using the same file
+	void loadTexture(const char* fileName, const TextureImage &image)
+	{
+		useTexture(*textures.add(fileName, image));
 	}
-	void passUniform(GLuint program)
+	void useTexture(const TextureResource &resource)
+	{
+		texture = resource.texture;
+		textureNumber = resource.textureNumber;
+	}
+	// draw with the buffers and texture of a mesh shared through the MeshRegistry
+	void useMesh(const MeshResource &mesh)
+	{
+		vao = mesh.vao;
+		vbo = mesh.vbo;
+		ebo = mesh.ebo;
+		indexCount = mesh.indexCount;
+		lods = mesh.lods;
+		hitMesh = mesh.hitMesh;
+		proxy = mesh.proxy;
+		texture = mesh.texture;
+		textureNumber = mesh.textureNumber;
+	}
+	// placement of this model, the subclasses add their poses and flags
+	DrawParameters drawParameters() const
+	{
+		DrawParameters parameters;
+		parameters.posOffset = position;
+		parameters.rotateAxis = rotateAxis;
+		parameters.rotateAngle = rotateAngle;
+		parameters.scaleFactor = scaleFactor;
+		return parameters;
+	}
+	// with the program of uniforms in use, before the draw call
+	void submit(const DrawUniforms &uniforms, const DrawParameters &parameters) const
+	{
+		submit(uniforms, &parameters, 1);
+	}
+	// before an instanced draw of count models sharing this model's mesh and texture
+	void submit(const DrawUniforms &uniforms, const DrawParameters *instances, size_t count) const
 	{
-		glUniform3fv(glGetUniformLocation(program, "pos_offset"), 1, glm::value_ptr(position));
-		glUniform3fv(glGetUniformLocation(program, "rotateAxis"), 1, glm::value_ptr(rotateAxis));
-		glUniform1f(glGetUniformLocation(program, "rotateAngle"), rotateAngle);
-		glUniform1f(glGetUniformLocation(program, "scaleFactor"), scaleFactor);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_idle"), 0.0);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_attack"), 0.0);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_dead"), 0.0);
 		glActiveTexture(GL_TEXTURE0 + textureNumber);
 		glBindTexture(GL_TEXTURE_2D, texture);
-		glUniform1i(glGetUniformLocation(program, "tex"), textureNumber);
-		glUniform1f(glGetUniformLocation(program, "useShadow"), false);
-		glUniform1f(glGetUniformLocation(program, "uniColor"), false);
-		glUniform1f(glGetUniformLocation(program, "onlyWings"), false);
-		glUniform1f(glGetUniformLocation(program, "opacity"), 1.0);
-		glUniform1f(glGetUniformLocation(program, "onlyBody"), false);
+		uniforms.tex.set(textureNumber);
+		uniforms.push(instances, count);
+	}
+	void passUniform(const DrawUniforms &uniforms)
+	{
+		submit(uniforms, drawParameters());
 	}
 
+	// diameter in pixels of the bounding sphere of chain, placed like the shader places this model
+	float projectedSize(const LodChain &chain, const Camera &camera, float viewportHeight) const
+	{
+		// the shader's rotation matrix is written transposed, it turns by -rotateAngle
+		glm::vec4 center = glm::rotate(glm::mat4(1.0f), -rotateAngle, rotateAxis) * glm::vec4(chain.center[0], chain.center[1], chain.center[2], 1.0f);
+		glm::vec3 worldCenter = position + scaleFactor * glm::vec3(center);
+		float radius = scaleFactor * chain.radius;
+		float depth = glm::dot(worldCenter - camera.position, glm::normalize(camera.forward)) - radius;
+		if (depth <= camera.near)
+			return viewportHeight;
+		return radius * viewportHeight / (depth * std::tan(camera.fov / 2.0f));
+	}
+	void selectLod(const Camera &camera, float viewportHeight)
+	{
+		lodLevel = lods.select(projectedSize(lods, camera, viewportHeight), lodLevel);
+	}
+	// with the model vertex array bound
+	void drawLod(int level, GLsizei instances = 1) const
+	{
+		if (lods.levels.empty())
+			glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instances);
+		else
+			lods.draw(level, instances);
+	}
+	// a mesh point where the shader draws it: scaled, turned by -rotateAngle, then offset
+	glm::vec3 toWorldSpace(const glm::vec3 &p) const
+	{
+		return position + glm::vec3(glm::rotate(glm::mat4(1.0f), -rotateAngle, rotateAxis) * glm::vec4(scaleFactor * p, 1.0f));
+	}
+	// the other way, for a mesh drawn at offset with scale (w = 0 for directions)
+	glm::vec3 toModelSpace(const glm::vec4 &p, const glm::vec3 &offset, float scale) const
+	{
+		glm::vec4 moved = p - glm::vec4(offset, 0.0f) * p.w;
+		return glm::vec3(glm::rotate(glm::mat4(1.0f), rotateAngle, rotateAxis) * moved) / scale;
+	}
+	// the placement toWorldSpace applies, for the collision proxy
+	ProxyPlacement proxyPlacement() const
+	{
+		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), -rotateAngle, rotateAxis);
+		ProxyPlacement place;
+		for (int row = 0; row < 3; row++)
+		{
+			place.offset[row] = position[row];
+			for (int column = 0; column < 3; column++)
+				place.rotation[3 * row + column] = rotation[column][row];
+		}
+		place.scale = scaleFactor;
+		return place;
+	}
+	// true when the polygon with corners points, seen from eye, is drawn over any part of hitMesh in
+	// the pose blended with weights, between its corners too; without hitMesh nothing is hit
+	bool covers(const glm::vec3 &eye, const std::vector<glm::vec3> &points, const float *weights, const glm::vec3 &offset, float scale) const
+	{
+		if (!hitMesh || hitMesh->empty() || points.empty())
+			return false;
+		glm::vec3 apex = toModelSpace(glm::vec4(eye, 1.0f), offset, scale);
+		std::vector<glm::vec3> corners;
+		for (const glm::vec3 &point : points)
+			corners.push_back(toModelSpace(glm::vec4(point, 1.0f), offset, scale));
+		return hitMesh->pyramidHits(glm::value_ptr(apex), glm::value_ptr(corners[0]), corners.size(), weights);
+	}
 	glm::vec2 getScreenCoor(Camera camera)
 	{
 		glm::vec4 homoScreenCoor = camera.vpMatrix()*glm::vec4(position, 1.0);
@@ -178,12 +319,17 @@ public:
 		}
 	}
 
-	void passUniform(GLuint program)
+	DrawParameters drawParameters() const
 	{
-		Model::passUniform(program);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_idle"), mixFactor.idle);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_attack"), mixFactor.attack);
-		glUniform1f(glGetUniformLocation(program, "mixFactor_dead"), mixFactor.dead);
+		DrawParameters parameters = Model::drawParameters();
+		parameters.mixFactorIdle = mixFactor.idle;
+		parameters.mixFactorAttack = mixFactor.attack;
+		parameters.mixFactorDead = mixFactor.dead;
+		return parameters;
+	}
+	void passUniform(const DrawUniforms &uniforms)
+	{
+		submit(uniforms, drawParameters());
 	}
 };
 
@@ -191,19 +337,53 @@ class Anivia : public Character
 {
 public:
 	std::vector<AniviaVertex> vertices;
+	std::vector<unsigned int> indices;
+	// start, open wing, attack and dead poses as the shader mixes them
+	void poseWeights(float weights[4]) const
+	{
+		float factors[3] = { mixFactor.idle, mixFactor.attack, mixFactor.dead };
+		MeshBvh::mixWeights(factors, 3, weights);
+	}
+	// seen from eye, the shape with corners points is drawn over Anivia in her current pose
+	bool hitBy(const glm::vec3 &eye, const std::vector<glm::vec3> &points) const
+	{
+		float weights[4];
+		poseWeights(weights);
+		return covers(eye, points, weights, position, scaleFactor);
+	}
 };
 
 class Enemy : public Character
 {
 public:
-	std::vector<EnemyVertex> vertices;
+	// low, high and dead poses, the enemy buffers have no attack pose
+	void poseWeights(float weights[3]) const
+	{
+		float factors[2] = { mixFactor.idle, mixFactor.dead };
+		MeshBvh::mixWeights(factors, 2, weights);
+	}
+	// seen from eye, the shape with corners points is drawn over the enemy in its current pose
+	bool hitBy(const glm::vec3 &eye, const std::vector<glm::vec3> &points) const
+	{
+		float weights[3];
+		poseWeights(weights);
+		return covers(eye, points, weights, position, scaleFactor);
+	}
+	// the collision proxies of both in their current poses overlap
+	bool touches(const Anivia &anivia) const
+	{
+		float weights[3], aniviaWeights[4];
+		poseWeights(weights);
+		anivia.poseWeights(aniviaWeights);
+		return ConvexProxy::overlap(*proxy, weights, proxyPlacement(), *anivia.proxy, aniviaWeights, anivia.proxyPlacement());
+	}
+	// contact through the collision proxies, or within anivia.safeDistance until they are loaded
 	bool detectCollision(Anivia &anivia)
 	{
 		if (state == DEAD)
 			return false;
-		float distance;
-		distance = glm::distance(position, anivia.position);
-		if (distance <= anivia.safeDistance && anivia.state != DEAD)
+		bool contact = proxy && anivia.proxy ? touches(anivia) : glm::distance(position, anivia.position) <= anivia.safeDistance;
+		if (contact && anivia.state != DEAD)
 		{
 			state = DEAD;
 			return true;
@@ -217,42 +397,72 @@ class Boss : public Character
 {
 public:
 	std::vector<BossVertex> vertices;
-	GLuint vao_tex, vbo_tex;
+	std::vector<unsigned int> indices;
+	GLuint vao_tex = 0, vbo_tex = 0, ebo_tex = 0;
 	std::vector<BossVertex> texturedVertices;
+	std::vector<unsigned int> texturedIndices;
+	// the textured boss is drawn moved by texturedOffset and at texturedScale instead of scaleFactor
+	glm::vec3 texturedOffset = { 0.0f, -0.5f, -0.1f };
+	float texturedScale = 0.22f;
+	// textured levels in vbo_tex and ebo_tex, the full mesh first, and the one picked for this frame
+	LodChain texturedLods;
+	int texturedLevel = 0;
+	// level 0 is the full mesh, the simplified levels are appended once they are built
 	std::vector<std::vector<BossVertex>> simplifiedVertices;
-	void passUniform(GLuint program, bool uniColor = true, bool onlyWings = false, bool onlyBody = false, bool passMixFactor = false)
+	std::vector<std::vector<unsigned int>> simplifiedIndices;
+	int currentLevel = -1;
+	bool levelChanged = false;
+	void passUniform(const DrawUniforms &uniforms, bool uniColor = true, bool onlyWings = false, bool onlyBody = false, bool passMixFactor = false)
 	{
-		Model::passUniform(program);
-
-		if (passMixFactor)
-		{
-
-			glUniform1f(glGetUniformLocation(program, "mixFactor_idle"), mixFactor.idle);
-			glUniform1f(glGetUniformLocation(program, "mixFactor_attack"), mixFactor.attack);
-			glUniform1f(glGetUniformLocation(program, "mixFactor_dead"), mixFactor.dead);
-		}
-		glUniform1f(glGetUniformLocation(program, "uniColor"), uniColor);
-		glUniform1f(glGetUniformLocation(program, "onlyWings"), onlyWings);
-		glUniform1f(glGetUniformLocation(program, "onlyBody"), onlyBody);
+		DrawParameters parameters = passMixFactor ? Character::drawParameters() : Model::drawParameters();
+		parameters.uniColor = uniColor;
+		parameters.onlyWings = onlyWings;
+		parameters.onlyBody = onlyBody;
+		submit(uniforms, parameters);
+	}
+	// low, high and attack poses, the boss buffers have no dead pose
+	void poseWeights(float weights[3]) const
+	{
+		float factors[2] = { mixFactor.idle, mixFactor.attack };
+		MeshBvh::mixWeights(factors, 2, weights);
+	}
+	// seen from eye, the shape with corners points is drawn over the textured boss in its current pose
+	bool hitBy(const glm::vec3 &eye, const std::vector<glm::vec3> &points) const
+	{
+		float weights[3];
+		poseWeights(weights);
+		return covers(eye, points, weights, position + texturedOffset, texturedScale);
 	}
 	void update()
 	{
 		switch (state)
 		{
 		case IDLE:
-			vertices = simplifiedVertices[0];
+			useLevel(0);
 			break;
 		case DAMAGE1:
-			vertices = simplifiedVertices[1];
+			useLevel(1);
 			break;
 		case DAMAGE2:
-			vertices = simplifiedVertices[4];
+			useLevel(4);
 			break;
 		case DAMAGE3:
-			vertices = simplifiedVertices[5];
+			useLevel(5);
 			break;
 		}
 	}
+	void useLevel(int level)
+	{
+		// full mesh while the simplified levels are still being built
+		if (level < 0 || static_cast<size_t>(level) >= simplifiedVertices.size())
+			level = 0;
+		if (level == currentLevel)
+			return;
+		vertices = simplifiedVertices[level];
+		indices = simplifiedIndices[level];
+		currentLevel = level;
+		levelChanged = true;
+	}
 };
 
 class Terrain: public Model
@@ -301,11 +511,11 @@ public:
 		computeShadow(lightDir);
 		generateTriangles();
 	}
-	void passUniform(GLuint program)
+	void passUniform(const DrawUniforms &uniforms)
 	{
-		Model::passUniform(program);
-
-		glUniform1f(glGetUniformLocation(program, "useShadow"), true);
+		DrawParameters parameters = drawParameters();
+		parameters.useShadow = GL_TRUE;
+		submit(uniforms, parameters);
 	}
 
 	void calculateNormals()
@@ -460,13 +670,12 @@ class Shape : public Model
 {
 public:
 	std::vector<VertexBasic> points;
-	std::vector<int> indices;
+	std::vector<unsigned int> indices;
 	float radius = 1;
 	glm::vec3 offset = { 0,0,0 };
 	StateType state = WAITING;
 	float moveSpeed = 1;
 	glm::vec3 moveNormal = { 0,0,0 };
-	std::vector<VertexBasic> vertices;
 
 
 	void fire(Camera camera, glm::vec2 targetScreenCoor)
@@ -489,6 +698,14 @@ public:
 	{
 		position += moveNormal * moveSpeed * float(timeInterval);
 	}
+	// corners of the shape where they are drawn, the hit tests look through the polygon they span
+	std::vector<glm::vec3> outline() const
+	{
+		std::vector<glm::vec3> corners;
+		for (const VertexBasic &point : points)
+			corners.push_back(toWorldSpace(point.pos));
+		return corners;
+	}
 
 	void update(Camera camera, glm::vec3 followPosition, glm::vec2 mouseScreenCoor, double timeInterval, double maxScaleFactor = 0.5)
 	{
@@ -532,21 +749,12 @@ public:
 		}
 	}
 
-	std::vector<VertexBasic> generateVertices()
-	{
-		std::vector<VertexBasic> vertices;
-		for (int i = 0; i < indices.size(); i++)
-		{
-			vertices.push_back(points[indices[i]]);
-		}
-		return vertices;
-	}
-
-	bool detectCollision(Anivia &anivia)
+	// hits are the shape drawn over the target as seen from the camera, or within safeDistance
+	// of its center until the target mesh is loaded
+	bool detectCollision(Anivia &anivia, const Camera &camera)
 	{
-		float distance;
-		distance = glm::distance(position, anivia.position);
-		if (distance <= anivia.safeDistance)
+		bool hit = anivia.hitMesh ? anivia.hitBy(camera.position, outline()) : glm::distance(position, anivia.position) <= anivia.safeDistance;
+		if (hit)
 		{
 			//std::cerr << "aaaaaa" << std::endl;
 			//anivia.state = DEAD;
@@ -556,22 +764,20 @@ public:
 		return false;
 	}
 
-	void detectCollision(Enemy &enemy)
+	void detectCollision(Enemy &enemy, const Camera &camera)
 	{
-		float distance = 0.0;
-		distance = glm::distance(position, enemy.position);
-		if (distance <= enemy.safeDistance)
+		bool hit = enemy.hitMesh ? enemy.hitBy(camera.position, outline()) : glm::distance(position, enemy.position) <= enemy.safeDistance;
+		if (hit)
 		{
 			enemy.state = DEAD;
 			enemy.movement = { 0, 0, 0.05 };
 		}
 	}
 
-	void detectCollision(Boss &enemy)
+	void detectCollision(Boss &enemy, const Camera &camera)
 	{
-		float distance = 0.0;
-		distance = glm::distance(position, enemy.position);
-		if (distance <= enemy.safeDistance)
+		bool hit = enemy.hitMesh ? enemy.hitBy(camera.position, outline()) : glm::distance(position, enemy.position) <= enemy.safeDistance;
+		if (hit)
 		{
 			state = WAITING;
 			switch (enemy.state)
@@ -597,9 +803,11 @@ class IceBerg : public Model
 {
 public:
 	std::vector<VertexBasic> vertices;
-	void passUniform(GLuint program, float opacity = 0.5)
+	std::vector<unsigned int> indices;
+	void passUniform(const DrawUniforms &uniforms, float opacity = 0.5)
 	{
-		Model::passUniform(program);
-		glUniform1f(glGetUniformLocation(program, "opacity"), opacity);
+		DrawParameters parameters = drawParameters();
+		parameters.opacity = opacity;
+		submit(uniforms, parameters);
 	}
 };
\ No newline at end of file
@@ -68,6 +68,8 @@ template <class T> bool operator>= (const Vec3D<T> & a, const Vec3D<T> & b) {
 
 /**
  * Vector in 3 dimensions, with basics operators overloaded.
+ * Copies are the implicit ones, so Vec3D is trivially copyable and
+ * an array of them is a plain array of x y z triples.
  */
 template <typename T>
 class Vec3D {
@@ -80,9 +82,6 @@ public:
         p[1] = p1;
         p[2] = p2;
     };
-    inline Vec3D (const Vec3D & v) {
-        init (v[0], v[1], v[2]);
-    }
     inline Vec3D (T* pp) {
         p[0] = pp[0];
         p[1] = pp[1];
@@ -97,12 +96,6 @@ public:
     inline const T& operator[] (int Index) const {
         return (p[Index]);
     };
-    inline Vec3D& operator= (const Vec3D & P) {
-        p[0] = P[0];
-        p[1] = P[1];
-        p[2] = P[2];
-        return (*this);
-    };
     inline Vec3D& operator+= (const Vec3D & P) {
         p[0] += P[0];
         p[1] += P[1];
@@ -0,0 +1,88 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "threadPool.h"
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+/************************************************************
+ * Startup asset loading
+ *
+ * Every asset is split into a decode step (file reading, OBJ
+ * parsing, image decoding, building CPU vertex arrays) that runs
+ * on the worker pool, and an upload step that runs on the thread
+ * owning the GL context once its decode step has finished.
+ *
+ * Background assets are not waited for by finish(); the frame
+ * loop picks up their uploads through poll() whenever they are
+ * done, and a failing one is reported without stopping the game.
+ ************************************************************/
+class AssetLoader {
+public:
+    explicit AssetLoader(unsigned int threadCount = 0);
+
+    //State is created per asset and shared by both steps
+    template <class State>
+    void add(const std::string & name, const std::function<bool(State &)> & decode, const std::function<bool(State &)> & upload)
+    {
+        std::shared_ptr<State> state = std::make_shared<State>();
+        addJob(name, [decode, state]() { return decode(*state); }, [upload, state]() { return upload(*state); }, false);
+    }
+    void add(const std::string & name, const std::function<bool()> & decode, const std::function<bool()> & upload)
+    {
+        addJob(name, decode, upload, false);
+    }
+    template <class State>
+    void addBackground(const std::string & name, const std::function<bool(State &)> & decode, const std::function<bool(State &)> & upload)
+    {
+        std::shared_ptr<State> state = std::make_shared<State>();
+        addJob(name, [decode, state]() { return decode(*state); }, [upload, state]() { return upload(*state); }, true);
+    }
+
+    //run the uploads of every finished decode, returns immediately
+    bool poll();
+    //wait for all decodes that are not in the background and run their uploads, false if any step failed
+    bool finish();
+    inline bool done() const { return uploaded == jobs.size(); }
+    //the decode workers, decode steps may split their own work across them
+    inline ThreadPool & threads() { return pool; }
+
+    //per asset decode/upload timings, the asset finishing decode last is the critical path
+    void printTimings(std::ostream & out) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        std::string name;
+        std::function<bool()> decode;
+        std::function<bool()> upload;
+        int worker;
+        double decodeStart;
+        double decodeEnd;
+        double uploadTime;
+        bool ok;
+        bool background;
+        bool done;
+    };
+
+    void addJob(const std::string & name, const std::function<bool()> & decode, const std::function<bool()> & upload, bool background);
+    bool runUploads(bool block);
+    double now() const;
+
+    Clock::time_point start;
+    std::vector<std::shared_ptr<Job> > jobs;
+    std::deque<std::shared_ptr<Job> > decoded;
+    std::mutex mutex;
+    std::condition_variable jobDecoded;
+    size_t uploaded;
+    size_t foreground;
+    size_t foregroundUploaded;
+    bool failed;
+    //declared last so the workers are joined before the job lists go away
+    ThreadPool pool;
+};
+
+#endif // ASSETLOADER_H
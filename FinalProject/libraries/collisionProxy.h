@@ -0,0 +1,70 @@
+#ifndef COLLISIONPROXY_H
+#define COLLISIONPROXY_H
+
+#include <cstddef>
+#include <vector>
+
+/************************************************************
+ * Convex collision proxies of morphing meshes
+ *
+ * Each pose of a mesh is reduced to the vertices touching the
+ * faces of a k-DOP (the extreme vertex along each of k directions
+ * spread over the sphere) and a margin: the hull of those points,
+ * swept by a ball of that radius, holds every vertex of the pose.
+ * A few dozen points stand in for thousands of vertices, so a
+ * test costs about the same whatever the mesh.
+ *
+ * A blend of the poses is tested as the same blend of their
+ * swept hulls (support points and margins mixed with the pose
+ * weights), which holds the blended mesh for weights that are
+ * positive and add up to one, as MeshBvh::mixWeights gives.
+ *
+ * Two proxies are tested against each other with GJK on their
+ * support points, placed in the world like the shader places
+ * the models.
+ ************************************************************/
+
+//world = offset + scale * rotation * p, rotation written row by row
+struct ProxyPlacement {
+    float offset[3];
+    float rotation[9];
+    float scale;
+};
+
+class ConvexProxy {
+public:
+    ConvexProxy();
+
+    //poses[p] + v * stride bytes is the x y z of vertex v in pose p
+    void build(const std::vector<const float *> & poses, size_t vertexCount, size_t stride, size_t directionCount = 128);
+    void clear();
+    inline bool empty() const { return margins.empty(); }
+    inline size_t poseCount() const { return margins.size(); }
+    inline size_t pointCount(size_t pose) const { return (first[pose + 1] - first[pose]) / 3; }
+    inline float margin(size_t pose) const { return margins[pose]; }
+
+    //one pose as it is baked: the margin, then x y z of every point
+    void savePose(size_t pose, std::vector<float> & data) const;
+    //append a pose saved by savePose, false when data is not one
+    bool addPose(const float * data, size_t size);
+
+    //point of the pose blended with weights (poseCount() entries) furthest along direction, in mesh space
+    void support(const float * direction, const float * weights, float * point) const;
+    float blendedMargin(const float * weights) const;
+
+    //distance between a and b in their blended poses and placements, 0 when they overlap
+    static float distance(const ConvexProxy & a, const float * weightsA, const ProxyPlacement & placeA,
+                          const ConvexProxy & b, const float * weightsB, const ProxyPlacement & placeB);
+    //same as distance(...) == 0, stopping as soon as the answer is known
+    static bool overlap(const ConvexProxy & a, const float * weightsA, const ProxyPlacement & placeA,
+                        const ConvexProxy & b, const float * weightsB, const ProxyPlacement & placeB);
+
+private:
+    //x y z of the points of every pose, one pose after the other
+    std::vector<float> points;
+    //start of each pose in points, and the end
+    std::vector<size_t> first;
+    std::vector<float> margins;
+};
+
+#endif // COLLISIONPROXY_H
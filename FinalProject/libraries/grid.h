@@ -5,31 +5,28 @@
 #include <vector>
 #include "Vertex.h"
 #include "mesh.h"
-#include <map>
-
-typedef std::map<unsigned, std::vector<Vec3Df> > CellContent;
-typedef std::map<unsigned, Vertex> RepresentativeList;
-
-//The above structures can be used almost like a vector!
-//The difference is that they are sparse. This means: each entry will only exist ONCE in memory and only after it has been used. 
-//One big difference occurs when iterating over the elements:
-//Try out something like this:
-//std::map<unsigned int, unsigned int> t;
-//t[2]=3;
-//t[3]=5;
-//for (std::map<unsigned int, unsigned int>::iterator iter=t.begin; iter!=t.end();++iter)
-//{
-// std::cout<< "t["<<iter->first<<"]<<"="<<iter->second<<endl;
-//}
-//empty indices will be skipped
-//btw. in C++ 11 you can replace: 
-//for (std::map<unsigned int, unsigned int>::iterator iter=t.begin; iter!=t.end();++iter) 
-//by for (auto iter=t.begin; iter!=t.end();++iter)
-
+#include "vertexClustering.h"
 
+/************************************************************
+ * Uniform grid of r x r x r cubic cells used to cluster vertices
+ *
+ * Only occupied cells are stored: the points are sorted into
+ * cells by VertexClustering and every occupied cell gets one
+ * representative, so the cost follows the number of points and
+ * not r^3, and fine grids (r = 256 and up) stay cheap.
+ ************************************************************/
 class Grid
 {
 public:
+	//how the representative of a cell is placed
+	enum Representative {
+		//mean of the vertices in the cell
+		REPRESENTATIVE_AVERAGE,
+		//point closest to the planes of the triangles touching the cell (quadric error metric),
+		//keeps sharp edges and corners that averaging rounds off
+		REPRESENTATIVE_QUADRIC
+	};
+
     Grid(){}
     inline Grid (const Vec3Df & origin, float size, unsigned int r) : origin (origin), size(size) , r(r) {}
 
@@ -38,7 +35,16 @@ public:
 	//draw all the cells
     void drawGrid();
 
-	Mesh simplifyMesh(Mesh mesh, unsigned int r);
+	//clustered mesh in the coordinates of the input, without normals
+	Mesh clusterMesh(const Mesh & mesh, unsigned int r, Representative mode = REPRESENTATIVE_AVERAGE);
+	//clusterMesh, centered and scaled to unit size with normals and bounding cube
+	Mesh simplifyMesh(const Mesh & mesh, unsigned int r, Representative mode = REPRESENTATIVE_AVERAGE);
+	//simplifyMesh at every resolution, meshes of LEVELS_PASS_VERTICES vertices and more are clustered together
+	//in one pass over the vertices (ClusterLevels)
+	std::vector<Mesh> simplifyLevels(const Mesh & mesh, const std::vector<unsigned int> & resolutions,
+		Representative mode = REPRESENTATIVE_AVERAGE);
+	//below this the shared pass costs more than it saves (clusterBench: 0.8-0.9x on the game assets)
+	static const size_t LEVELS_PASS_VERTICES = 32768;
 
 	//number of grid cells
     unsigned int r;
@@ -49,20 +55,30 @@ public:
 
     //add a point to a cell
 	void addToCell(const Vec3Df & vertexPos);
-    //add all vertices of the model to the cells
-	void putVertices(const std::vector<Vertex> & vertices);
+    //add all vertex positions of the model to the cells
+	void putVertices(const std::vector<Vec3Df> & positions);
     //find the index containing the given point, return -1 if it cannot be found
-	int isContainedAt(const Vec3Df & pos);
+	long long isContainedAt(const Vec3Df & pos);
 
-	//for each cell, compute a representative point of all contained points
+	//for each occupied cell, compute a representative point of all contained points
 	void computeRepresentatives();
+	//same with quadric representatives, from triangles indexing the added points
+	void computeRepresentatives(const std::vector<Triangle> & triangles);
     //retrieve the representative from representatives by first finding the cell containing pos 
-	//then looking up the representative
+	//then looking up the representative (pos itself when its cell is empty)
 	Vec3Df getRepresentative(const Vec3Df & pos);
 
-	
-    CellContent verticesInCell;
-	RepresentativeList representatives;
+	//number of occupied cells after computeRepresentatives
+	inline size_t occupiedCells() const { return representatives.size(); }
+
+	//points added so far, clustered by computeRepresentatives
+	std::vector<Vec3Df> points;
+	VertexClustering cells;
+	//one per occupied cell, in ascending cell order
+	std::vector<Vec3Df> representatives;
+
+private:
+	void storeRepresentatives(const std::vector<float> & positions);
 };
 
 #endif // GRID_H
@@ -0,0 +1,45 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/************************************************************
+ * Read-only memory mapping of a whole file
+ ************************************************************/
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char * filename);
+    void close();
+
+    inline bool isOpen() const { return ptr != 0; }
+    inline const char * data() const { return ptr; }
+    inline size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile & operator= (const MappedFile &);
+
+    const char * ptr;
+    size_t length;
+#ifdef WIN32
+    void * fileHandle;
+    void * mappingHandle;
+#endif
+};
+
+/************************************************************
+ * File helpers used to validate baked files against their sources
+ ************************************************************/
+//modification time (seconds) and size in bytes, false if the file does not exist
+bool fileStat(const char * filename, uint64_t & mtime, uint64_t & size);
+//64 bit FNV-1a hash
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed = 14695981039346656037ULL);
+bool hashFile(const char * filename, uint64_t & hash);
+//true if size and mtime match, or if the file was touched but its content hash is unchanged
+bool fileUnchanged(const char * filename, uint64_t mtime, uint64_t size, uint64_t hash);
+
+#endif // MAPPEDFILE_H
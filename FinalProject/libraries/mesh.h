@@ -2,50 +2,65 @@
 #define MESH_H
 
 #include "Vertex.h"
+#include <type_traits>
 #include <vector>
 
+class ThreadPool;
+
 /************************************************************
  * Triangle Class
+ *
+ * Three vertex indices and nothing else: trivially copyable, so
+ * a vector of triangles is a plain index buffer.
  ************************************************************/
 class Triangle {
 public:
     inline Triangle () {
         v[0] = v[1] = v[2] = 0;
     }
-    inline Triangle (const Triangle & t) {
-        v[0] = t.v[0];
-        v[1] = t.v[1];
-        v[2] = t.v[2];
-    }
     inline Triangle (unsigned int v0, unsigned int v1, unsigned int v2) {
         v[0] = v0;
         v[1] = v1;
         v[2] = v2;
     }
-    inline virtual ~Triangle () {}
-    inline Triangle & operator= (const Triangle & t) {
-        v[0] = t.v[0];
-        v[1] = t.v[1];
-        v[2] = t.v[2];
-        return (*this);
-    }
     unsigned int v[3];
 };
 
+static_assert(std::is_trivially_copyable<Triangle>::value && sizeof(Triangle) == 3 * sizeof(unsigned int),
+              "triangles must stay index triplets");
+static_assert(std::is_trivially_copyable<Vec3Df>::value && sizeof(Vec3Df) == 3 * sizeof(float),
+              "positions must stay float triplets");
+
 /************************************************************
  * Basic Mesh Class
+ *
+ * Structure of arrays: positions, normals (empty until
+ * computeVertexNormals) and triangles are separate arrays, so
+ * each pass streams only what it reads and the data can be
+ * handed to the clustering and GL code without repacking.
  ************************************************************/
 class Mesh {
 public:
+    static const size_t PARALLEL_VERTICES = 100000;
+
     Mesh();
-    inline Mesh (const std::vector<Vertex> & v, const std::vector<Triangle> & t) : vertices (v), triangles (t)  {}
-    std::vector<Vertex> vertices;
+    inline Mesh (const std::vector<Vec3Df> & p, const std::vector<Triangle> & t) : positions (p), triangles (t)  {}
+    std::vector<Vec3Df> positions;
+    std::vector<Vec3Df> normals;
     std::vector<Triangle> triangles;
 
-    bool loadMesh(const char * filename);
+    inline size_t vertexCount() const { return positions.size(); }
+    //x y z of every vertex, 3 floats each
+    inline const float * positionData() const { return positions.empty() ? 0 : &positions[0][0]; }
+    //3 indices per triangle
+    inline const unsigned int * indexData() const { return triangles.empty() ? 0 : triangles[0].v; }
+
+    //with a pool, meshes of more than PARALLEL_VERTICES vertices are split across its threads
+    //(all but computeVertexNormals, whose scatter is serial); the results are the same either way
+    bool loadMesh(const char * filename, ThreadPool * pool = 0);
     void computeVertexNormals ();
-    void centerAndScaleToUnit ();
-    void computeBoundingCube();
+    void centerAndScaleToUnit (ThreadPool * pool = 0);
+    void computeBoundingCube(ThreadPool * pool = 0);
 
     //Bounding box information
 	//point of bounding box with minimal coordinates ("lower left corner")
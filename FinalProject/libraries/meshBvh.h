@@ -0,0 +1,78 @@
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <cstddef>
+#include <vector>
+
+/************************************************************
+ * Bounding volume hierarchy for hit tests
+ *
+ * A binary tree of boxes over the triangles of a morphing mesh,
+ * built once at load time with the surface area heuristic on
+ * the triangles' boxes over all the poses. Every node also keeps
+ * its box in each pose, and a query blends those with its pose
+ * weights: for weights that are positive and add up to one,
+ * which is what the shader's chain of mix() calls gives for
+ * factors in [0, 1], the blended box holds the blended triangles,
+ * and in a pure pose it is as tight as that pose's own box. The
+ * tree never has to be refitted: the queries blend the corners
+ * of the few triangles they reach and test those exactly.
+ *
+ * Everything is in the mesh's own space; the caller brings its
+ * rays, spheres and pyramids in from the world.
+ ************************************************************/
+
+//the first child of an inner node is the node right after it, the boxes are kept apart
+struct BvhNode {
+    //inner nodes: second child, leaves: first triangle
+    unsigned int offset;
+    //triangles of a leaf, 0 for inner nodes
+    unsigned int count;
+};
+
+class MeshBvh {
+public:
+    MeshBvh();
+
+    //poses[p] + v * stride bytes is the x y z of vertex v in pose p, 3 indices per triangle
+    void build(const std::vector<const float *> & poses, size_t vertexCount, size_t stride,
+               const unsigned int * indices, size_t indexCount, size_t leafSize = 4);
+    void clear();
+    inline bool empty() const { return nodes.empty(); }
+    inline size_t poseCount() const { return poses; }
+    inline size_t triangleCount() const { return triangles.size() / 3; }
+    inline size_t nodeCount() const { return nodes.size(); }
+
+    //weights is poseCount() entries, positive and adding up to one: the pose to test
+    //nearest hit along direction (any length) closer than maxDistance, in units of direction
+    bool raycast(const float * origin, const float * direction, float maxDistance, const float * weights,
+                 float * distance = 0) const;
+    bool segmentHits(const float * from, const float * to, const float * weights) const;
+    bool sphereHits(const float * center, float radius, const float * weights) const;
+    //the pyramid from apex through the convex hull of the cornerCount x y z corners of polygon (up
+    //to 8, the rest are left out), endless past them, meets a triangle: seen from apex, the polygon
+    //covers part of the mesh
+    bool pyramidHits(const float * apex, const float * polygon, size_t cornerCount, const float * weights) const;
+
+    //the weights of the chain of mixes the shader applies, pose 0 mixed towards pose 1 by
+    //factors[0], the result towards pose 2 by factors[1] and so on; factors are clamped to
+    //[0, 1] so the blend stays inside the boxes
+    static void mixWeights(const float * factors, size_t factorCount, float * weights);
+
+private:
+    void corners(unsigned int triangle, const float * weights, float * a, float * b, float * c) const;
+    //low x y z, high x y z of a node in the pose blended with weights, box is the storage if needed
+    const float * bounds(unsigned int node, const float * weights, float * box) const;
+
+    std::vector<BvhNode> nodes;
+    //low and high corner of every node in every pose, node after node
+    std::vector<float> poseBounds;
+    //3 vertex indices per triangle, in leaf order
+    std::vector<unsigned int> triangles;
+    //x y z of every vertex, one pose after the other
+    std::vector<float> positions;
+    size_t vertices;
+    size_t poses;
+};
+
+#endif // MESHBVH_H
@@ -0,0 +1,126 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "mappedFile.h"
+#include <string>
+#include <vector>
+
+/************************************************************
+ * Baked mesh cache
+ *
+ * A baked file holds a welded, pose-merged vertex stream and its
+ * index list exactly as they are handed to glBufferData, preceded
+ * by a header recording the OBJ files it was built from (mtime,
+ * size, hash).
+ * Loading is one mapping and one copy - no text parsing.
+ *
+ * A file can hold several levels (e.g. the LODs of one model)
+ * back to back, each with indices relative to its first vertex.
+ * Files derived with parameters (simplification resolutions...)
+ * also record a key of those, so changing them invalidates the
+ * file like a changed source does.
+ ************************************************************/
+struct MeshCacheLevel {
+    size_t firstVertex;
+    size_t vertexCount;
+    size_t firstIndex;
+    size_t indexCount;
+};
+
+class MeshCache {
+public:
+    static const uint32_t VERSION = 3;
+
+    MeshCache();
+
+    //map cacheFile and check it against its sources and build key; false when missing or stale
+    bool open(const char * cacheFile, const std::vector<std::string> & sources, unsigned int vertexStride, uint64_t buildKey = 0);
+    void close();
+
+    inline const void * vertexData() const { return vertices; }
+    inline size_t vertexCount() const { return count; }
+    inline const unsigned int * indexData() const { return indices; }
+    inline size_t indexCount() const { return indexTotal; }
+    inline size_t levelCount() const { return levels.size(); }
+    inline const MeshCacheLevel & level(size_t i) const { return levels[i]; }
+
+    //without levels the whole file is a single level
+    static bool write(const char * cacheFile, const std::vector<std::string> & sources,
+                      unsigned int vertexStride, const void * vertexData, size_t vertexCount,
+                      const unsigned int * indexData, size_t indexCount,
+                      const std::vector<MeshCacheLevel> & levels = std::vector<MeshCacheLevel>(), uint64_t buildKey = 0);
+
+private:
+    MappedFile file;
+    const void * vertices;
+    size_t count;
+    const unsigned int * indices;
+    size_t indexTotal;
+    std::vector<MeshCacheLevel> levels;
+};
+
+//CPU side of one level
+template <class V>
+struct MeshLevel {
+    std::vector<V> vertices;
+    std::vector<unsigned int> indices;
+};
+
+//Fill vertices and indices from a baked file, returns false when the OBJ path has to be taken
+template <class V>
+bool loadBakedVertices(const char * cacheFile, const std::vector<std::string> & sources,
+                       std::vector<V> & vertices, std::vector<unsigned int> & indices, uint64_t buildKey = 0)
+{
+    MeshCache cache;
+    if (!cache.open(cacheFile, sources, sizeof(V), buildKey))
+        return false;
+    const V * begin = static_cast<const V *>(cache.vertexData());
+    vertices.assign(begin, begin + cache.vertexCount());
+    indices.assign(cache.indexData(), cache.indexData() + cache.indexCount());
+    return true;
+}
+
+template <class V>
+bool bakeVertices(const char * cacheFile, const std::vector<std::string> & sources,
+                  const std::vector<V> & vertices, const std::vector<unsigned int> & indices, uint64_t buildKey = 0)
+{
+    return MeshCache::write(cacheFile, sources, sizeof(V), vertices.data(), vertices.size(), indices.data(), indices.size(),
+                            std::vector<MeshCacheLevel>(), buildKey);
+}
+
+//Fill every level from a baked file, false when they have to be rebuilt
+template <class V>
+bool loadBakedLevels(const char * cacheFile, const std::vector<std::string> & sources, uint64_t buildKey,
+                     std::vector<MeshLevel<V> > & levels)
+{
+    MeshCache cache;
+    if (!cache.open(cacheFile, sources, sizeof(V), buildKey))
+        return false;
+    const V * begin = static_cast<const V *>(cache.vertexData());
+    levels.resize(cache.levelCount());
+    for (size_t i = 0; i < levels.size(); i++) {
+        const MeshCacheLevel & level = cache.level(i);
+        levels[i].vertices.assign(begin + level.firstVertex, begin + level.firstVertex + level.vertexCount);
+        levels[i].indices.assign(cache.indexData() + level.firstIndex, cache.indexData() + level.firstIndex + level.indexCount);
+    }
+    return true;
+}
+
+template <class V>
+bool bakeLevels(const char * cacheFile, const std::vector<std::string> & sources, uint64_t buildKey,
+                const std::vector<MeshLevel<V> > & levels)
+{
+    std::vector<V> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshCacheLevel> ranges(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        MeshCacheLevel range = { vertices.size(), levels[i].vertices.size(), indices.size(), levels[i].indices.size() };
+        ranges[i] = range;
+        vertices.insert(vertices.end(), levels[i].vertices.begin(), levels[i].vertices.end());
+        indices.insert(indices.end(), levels[i].indices.begin(), levels[i].indices.end());
+    }
+    return MeshCache::write(cacheFile, sources, sizeof(V), vertices.data(), vertices.size(),
+                            indices.data(), indices.size(), ranges, buildKey);
+}
+
+#endif // MESHCACHE_H
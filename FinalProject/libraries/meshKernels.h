@@ -0,0 +1,46 @@
+#ifndef MESHKERNELS_H
+#define MESHKERNELS_H
+
+#include <cstddef>
+
+/************************************************************
+ * Vectorized loops over position and normal arrays
+ *
+ * The arrays hold x y z triples back to back (Mesh::positions,
+ * Mesh::normals). SSE versions read four vertices, twelve
+ * floats, as three registers; min, max, sums and the offset and
+ * scale work on them as they are, with the center repeated in
+ * the x y z x / y z x y / z x y z pattern of the registers, and
+ * per-vertex lengths are taken after a 4x3 transpose. They are
+ * used on x86-64 builds and 32-bit ones with SSE2 enabled; the
+ * scalar versions below are the fallback and the reference.
+ * Every kernel works on a sub-range as well, so Mesh can split
+ * large meshes across a ThreadPool.
+ ************************************************************/
+
+//true when the SSE versions are compiled in
+bool meshKernelsUseSimd();
+
+//smallest and largest x y z of count positions
+void positionBounds(const float * xyz, size_t count, float * low, float * high);
+//x y z sums of count positions, in double so a million vertices still add up exactly enough
+void positionSum(const float * xyz, size_t count, double * sum);
+//largest squared distance from center, one square root for the caller instead of one per vertex
+float maxSquaredDistance(const float * xyz, size_t count, const float * center);
+//every position becomes (position - center) * scale
+void translateScale(float * xyz, size_t count, const float * center, float scale);
+//unit normal of each of triangleCount triangles (3 indices each), zero for the ones without area
+void faceNormals(const float * xyz, const unsigned int * indices, size_t triangleCount, float * normals);
+//scale count vectors to unit length, zero vectors stay zero
+void normalizeVectors(float * xyz, size_t count);
+
+//scalar versions: bounds, offsets and normals come out bit for bit the same, sums only differ
+//in the order the doubles are added
+void positionBoundsScalar(const float * xyz, size_t count, float * low, float * high);
+void positionSumScalar(const float * xyz, size_t count, double * sum);
+float maxSquaredDistanceScalar(const float * xyz, size_t count, const float * center);
+void translateScaleScalar(float * xyz, size_t count, const float * center, float scale);
+void faceNormalsScalar(const float * xyz, const unsigned int * indices, size_t triangleCount, float * normals);
+void normalizeVectorsScalar(float * xyz, size_t count);
+
+#endif // MESHKERNELS_H
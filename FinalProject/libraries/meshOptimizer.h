@@ -0,0 +1,69 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/************************************************************
+ * Triangle and vertex order optimization
+ *
+ * Run once on an indexed mesh before it is baked:
+ * 1. triangles are reordered so vertices are reused while they
+ *    are still in the post-transform cache (Forsyth's linear
+ *    speed algorithm, the shader then runs once per vertex
+ *    instead of up to six times);
+ * 2. the result is cut into patches where the cache starts over
+ *    anyway, and patches facing away from the middle of the mesh
+ *    are drawn first, so the outer surface tends to hide what is
+ *    behind it before that gets shaded;
+ * 3. vertices are renumbered in order of first use so the vertex
+ *    fetch walks the buffer forwards.
+ * None of this changes what is drawn, only the order.
+ ************************************************************/
+
+//average cache miss ratio: transformed vertices per triangle with a FIFO cache of cacheSize
+//entries, 3 when nothing is reused, about 0.6 for a well ordered closed mesh
+float averageCacheMissRatio(const unsigned int * indices, size_t indexCount, size_t vertexCount,
+                            unsigned int cacheSize = 16);
+
+//reorder the triangles of indices for the post-transform cache
+void optimizeVertexCache(unsigned int * indices, size_t indexCount, size_t vertexCount);
+
+//reorder cache-optimized triangles patch by patch, outward facing patches first; a patch
+//ends as soon as its own miss ratio is within threshold of the whole patch it was cut from,
+//so the miss ratio grows by about that factor at most
+void optimizeOverdraw(unsigned int * indices, size_t indexCount, const float * positions, size_t vertexCount,
+                      size_t stride, float threshold = 1.05f);
+
+//remap[v] receives the new index of vertex v in order of first use, vertices no triangle uses
+//go last; indices are rewritten, returns the number of vertices used
+size_t optimizeVertexFetchRemap(unsigned int * indices, size_t indexCount, size_t vertexCount,
+                                std::vector<unsigned int> & remap);
+
+//one log line with the miss ratio of the input, after the cache pass and after the overdraw pass
+std::string cacheReport(const std::string & name, float before, float cached, float after);
+
+//all three passes on a welded mesh, positionOffset in bytes (offsetof); returns the log line
+template <class V>
+std::string optimizeMesh(const std::string & name, std::vector<V> & vertices, std::vector<unsigned int> & indices,
+                         size_t positionOffset)
+{
+    float before = averageCacheMissRatio(indices.data(), indices.size(), vertices.size());
+    optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    float cached = averageCacheMissRatio(indices.data(), indices.size(), vertices.size());
+    optimizeOverdraw(indices.data(), indices.size(),
+                     reinterpret_cast<const float *>(reinterpret_cast<const char *>(vertices.data()) + positionOffset),
+                     vertices.size(), sizeof(V));
+
+    std::vector<unsigned int> remap;
+    size_t used = optimizeVertexFetchRemap(indices.data(), indices.size(), vertices.size(), remap);
+    std::vector<V> ordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        ordered[remap[i]] = vertices[i];
+    ordered.resize(used);
+    vertices.swap(ordered);
+    return cacheReport(name, before, cached, averageCacheMissRatio(indices.data(), indices.size(), vertices.size()));
+}
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,77 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <cstddef>
+#include <vector>
+
+class Mesh;
+
+/************************************************************
+ * Meshlets
+ *
+ * Splits an indexed mesh into small clusters of connected
+ * triangles (at most 64 vertices and 124 triangles by default),
+ * each with a bounding sphere and a cone bounding its triangle
+ * normals. A whole cluster can then be skipped when its sphere
+ * is outside the frustum or when the cone shows every one of its
+ * triangles faces away from the eye, before any of its vertices
+ * is shaded.
+ *
+ * Clusters grow greedily from a seed triangle: the next triangle
+ * is an unused neighbour adding the fewest new vertices, ties
+ * going to the one whose normal is closest to the cluster's, so
+ * the cones stay narrow. Once no neighbour fits, the cluster
+ * takes the unused triangle that grows its bounding sphere least
+ * and goes on from there, so it fills up to its limits rather
+ * than ending at the first gap. Seeds are taken in index order, which
+ * after optimizeVertexCache already walks the surface patch by
+ * patch.
+ ************************************************************/
+struct Meshlet {
+    //first entry of MeshletData::vertices and first triangle of MeshletData::triangles
+    unsigned int vertexOffset;
+    unsigned int triangleOffset;
+    unsigned int vertexCount;
+    unsigned int triangleCount;
+};
+
+//laid out as two vec4 for a std430 buffer, so bounds.data() can be uploaded as is to a
+//culling compute shader
+struct MeshletBounds {
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    //sine of the half angle of the normal cone, 1 when the cone is too wide to ever cull
+    float coneCutoff;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    //mesh vertex of every cluster vertex
+    std::vector<unsigned int> vertices;
+    //three cluster vertices per triangle
+    std::vector<unsigned char> triangles;
+
+    void clear();
+    //the mesh indices in cluster order: the triangles of meshlet i are the 3 * triangleCount
+    //indices from 3 * triangleOffset, what a culling pass needs to write indirect draws
+    void indexBuffer(std::vector<unsigned int> & indices) const;
+};
+
+//cluster count positions read stride bytes apart, maxVertices at most 255
+void buildMeshlets(const float * positions, size_t vertexCount, size_t stride, const unsigned int * indices,
+                   size_t indexCount, MeshletData & out, size_t maxVertices = 64, size_t maxTriangles = 124);
+void buildMeshlets(const Mesh & mesh, MeshletData & out, size_t maxVertices = 64, size_t maxTriangles = 124);
+
+//six normalized planes (x y z d, inside where x y z . p + d >= 0) of a column-major
+//model-view-projection matrix, in model space
+void frustumPlanes(const float * mvp, float planes[6][4]);
+
+//true when no triangle of the cluster can be visible from eye (model space): the sphere is
+//outside a plane, or seen from eye the whole sphere lies behind every triangle plane the
+//cone allows
+bool frustumCulled(const MeshletBounds & bounds, const float planes[6][4]);
+bool backfaceCulled(const MeshletBounds & bounds, const float * eye);
+
+#endif // MESHLETS_H
@@ -0,0 +1,48 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/************************************************************
+ * Streaming OBJ parser
+ *
+ * Parses a memory-mapped OBJ file in one pass without copying
+ * lines: v, vt and vn records and v, v/vt, v//vn, v/vt/vn faces.
+ * Polygons are fan-triangulated and negative (relative) indices
+ * are resolved, matching tinyobj::LoadObj with triangulation on.
+ * Everything else (groups, materials, smoothing) is skipped.
+ *
+ * With a ThreadPool, large files are split at line starts into
+ * chunks parsed in parallel, then merged at prefix-sum offsets;
+ * the result is the same as a serial parse.
+ ************************************************************/
+struct ObjIndex {
+    //zero based, -1 when the face corner does not reference one
+    int vertex;
+    int texcoord;
+    int normal;
+};
+
+struct ObjData {
+    std::vector<float> positions;  //x y z
+    std::vector<float> texcoords;  //u v
+    std::vector<float> normals;    //x y z
+    std::vector<ObjIndex> indices; //three corners per triangle
+
+    void clear();
+};
+
+//parse an OBJ held in memory, false with a message in err on malformed input
+bool parseObj(const char * data, size_t size, ObjData & obj, std::string & err, ThreadPool * pool = 0);
+//map fileName and parse it
+bool loadObj(const char * fileName, ObjData & obj, std::string & err, ThreadPool * pool = 0);
+
+//decimal float in the [sign] digits [. digits] [e|E [sign] digits] form, returns the
+//character after the number or p itself when there is no number
+const char * parseFloat(const char * p, const char * end, float & value);
+
+#endif // OBJPARSER_H
@@ -0,0 +1,51 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+//print the compile/link log and return false when it failed
+bool checkShaderErrors(GLuint shader);
+bool checkProgramErrors(GLuint program);
+
+/************************************************************
+ * Shader programs persisted as driver binaries
+ *
+ * A linked program is stored with glGetProgramBinary in
+ * <name>.ffprog, keyed by a hash of its shader sources and of the
+ * GL vendor, renderer and version strings. Later launches restore
+ * it with glProgramBinary and only compile from source when the
+ * key does not match or the driver rejects the binary.
+ ************************************************************/
+class ProgramCache
+{
+public:
+	static const unsigned int VERSION = 1;
+
+	//needs the GL context, 0 when the shaders fail to compile or link
+	GLuint load(const std::string & name, const char * vertexFile, const char * fragmentFile);
+
+	//per program load times, cold (compiled) or warm (restored binary)
+	void printTimings(std::ostream & out) const;
+
+private:
+	struct Timing
+	{
+		std::string name;
+		double milliseconds;
+		bool restored;
+	};
+
+	GLuint compile(const std::string & vertexCode, const std::string & fragmentCode, bool retrievable);
+	std::string driverString() const;
+
+	std::vector<Timing> timings;
+};
+
+#endif // PROGRAMCACHE_H
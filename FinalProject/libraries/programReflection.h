@@ -0,0 +1,87 @@
+#ifndef PROGRAMREFLECTION_H
+#define PROGRAMREFLECTION_H
+
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+/************************************************************
+ * Active uniforms of a linked program
+ *
+ * The program is asked once, after linking or restoring its
+ * binary, for the name, type and location of every uniform it
+ * uses. Typed handles are resolved against that list up front,
+ * so setting a uniform at draw time is a single glUniform call
+ * on a known location, with no name lookup in the driver.
+ *
+ * A uniform the program does not use resolves to location -1,
+ * which GL ignores, so the same handles serve programs that only
+ * use some of them (the shadow pass). A uniform declared with
+ * another type than its handle is reported and also left at -1.
+ ************************************************************/
+class ProgramReflection
+{
+public:
+	//needs the GL context and a linked program
+	explicit ProgramReflection(GLuint program);
+
+	inline GLuint program() const { return handle; }
+	inline size_t uniformCount() const { return uniforms.size(); }
+
+	//location of name when it is active with one of types, -1 otherwise
+	GLint location(const char * name, const GLenum * types, size_t typeCount) const;
+
+private:
+	struct ActiveUniform
+	{
+		std::string name;
+		GLenum type;
+		GLint location;
+	};
+
+	GLuint handle;
+	std::vector<ActiveUniform> uniforms;
+};
+
+//a uniform of the program the handle was resolved for, set while that program is in use
+struct FloatUniform
+{
+	GLint location = -1;
+	void resolve(const ProgramReflection & program, const char * name);
+	inline void set(float value) const { glUniform1f(location, value); }
+};
+
+struct BoolUniform
+{
+	GLint location = -1;
+	void resolve(const ProgramReflection & program, const char * name);
+	inline void set(bool value) const { glUniform1i(location, value ? 1 : 0); }
+};
+
+//sampler2D, set to a texture unit
+struct SamplerUniform
+{
+	GLint location = -1;
+	void resolve(const ProgramReflection & program, const char * name);
+	inline void set(GLint unit) const { glUniform1i(location, unit); }
+};
+
+struct Vec3Uniform
+{
+	GLint location = -1;
+	void resolve(const ProgramReflection & program, const char * name);
+	inline void set(const float * value) const { glUniform3fv(location, 1, value); }
+};
+
+struct Mat4Uniform
+{
+	GLint location = -1;
+	void resolve(const ProgramReflection & program, const char * name);
+	inline void set(const float * value) const { glUniformMatrix4fv(location, 1, GL_FALSE, value); }
+};
+
+#endif // PROGRAMREFLECTION_H
@@ -0,0 +1,156 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+#include "collisionProxy.h"
+#include "meshBvh.h"
+#include "textureCache.h"
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//one level of detail stored behind the others in a shared vertex and index buffer
+struct LodRange
+{
+	GLint baseVertex;
+	GLsizei firstIndex;
+	GLsizei indexCount;
+};
+
+/************************************************************
+ * Levels of detail of one mesh, finest first
+ * The levels sit one after the other in the mesh buffers and
+ * are drawn with glDrawElementsBaseVertex. A level simplified on
+ * an r x r x r grid moves the surface by at most about a cell,
+ * diameter / r, and in practice by a fraction of it (clusterBench),
+ * so it is used while the bounding sphere projects to less than
+ * r * PIXEL_ERROR pixels across. Going coarser waits until the
+ * size is HYSTERESIS below that, so a model sitting on a
+ * threshold does not pop between two levels.
+ ************************************************************/
+struct LodChain
+{
+	static constexpr float PIXEL_ERROR = 4.0f;
+	static constexpr float HYSTERESIS = 0.15f;
+
+	std::vector<LodRange> levels;
+	//grid resolution of every level, 0 for the full mesh
+	std::vector<unsigned int> resolutions;
+	//bounding sphere in model space
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+
+	//level for a projected diameter in pixels, starting from the one used last frame
+	int select(float pixels, int current) const;
+	//with the mesh vertex array bound; levels that have not arrived fall back to the coarsest one there is
+	void draw(int level, GLsizei instances = 1) const;
+};
+
+/************************************************************
+ * GPU objects of one mesh, shared by every model drawing it
+ * (the texture is owned by the TextureRegistry)
+ ************************************************************/
+struct MeshResource
+{
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ebo = 0;
+	GLsizei indexCount = 0;
+	GLuint texture = 0;
+	int textureNumber = 0;
+	LodChain lods;
+	std::shared_ptr<const MeshBvh> hitMesh;
+	std::shared_ptr<const ConvexProxy> proxy;
+};
+
+/************************************************************
+ * Meshes keyed by asset path
+ * The first load of a path uploads it, every later lookup hands
+ * out the same buffers, so memory does not grow with the number
+ * of instances.
+ ************************************************************/
+class MeshRegistry
+{
+public:
+	std::shared_ptr<const MeshResource> find(const std::string & path) const;
+	std::shared_ptr<const MeshResource> add(const std::string & path, const MeshResource & mesh);
+	//delete all GL objects, needs the context to still be current
+	void release();
+	inline size_t size() const { return meshes.size(); }
+
+private:
+	std::map<std::string, std::shared_ptr<MeshResource> > meshes;
+};
+
+/************************************************************
+ * Decoded image, can be produced on any thread
+ * Either a plain RGB8 image from stb (no levels, mipmaps are
+ * generated on upload) or a baked mip chain, in which case
+ * pixels owns the file buffer the levels point into.
+ ************************************************************/
+struct TextureImage
+{
+	int width = 0;
+	int height = 0;
+	TextureFormat format = TEXTURE_RGB8;
+	std::vector<TextureLevel> levels;
+	std::shared_ptr<unsigned char> pixels;
+};
+
+//the baked file when it is up to date, otherwise the image itself
+bool decodeTexture(const char * fileName, TextureImage & image);
+//stb only, RGB8 or RGBA8
+bool decodeImage(const char * fileName, TextureImage & image, int channels = 3);
+//upload into a new texture, needs the GL context; false for block
+//compressed images when the driver lacks S3TC
+bool uploadTexture(const TextureImage & image, GLuint & texture);
+
+/************************************************************
+ * Texture object and the texture unit it is bound to
+ ************************************************************/
+struct TextureResource
+{
+	GLuint texture = 0;
+	int textureNumber = 0;
+};
+
+/************************************************************
+ * Textures keyed by file path
+ * Each file is decoded once and uploaded once, every model using
+ * it shares the texture object and its texture unit, so spawning
+ * more models does not add decodes or texture units.
+ ************************************************************/
+class TextureRegistry
+{
+public:
+	explicit TextureRegistry(int firstTextureNumber = 1);
+
+	//thread safe, concurrent requests for one path share a single decode;
+	//true without an image when the path is already uploaded
+	bool decode(const std::string & path, TextureImage & image);
+	//upload under path unless it is already there, needs the GL context
+	std::shared_ptr<const TextureResource> add(const std::string & path, const TextureImage & image);
+	//decode and upload on first use, needs the GL context
+	std::shared_ptr<const TextureResource> load(const std::string & path);
+	std::shared_ptr<const TextureResource> find(const std::string & path) const;
+
+	//delete all GL objects, needs the context to still be current
+	void release();
+	size_t size() const;
+
+private:
+	int nextTextureNumber;
+	mutable std::mutex mutex;
+	std::map<std::string, std::shared_future<TextureImage> > decoded;
+	std::map<std::string, std::shared_ptr<TextureResource> > textures;
+};
+
+#endif // RESOURCES_H
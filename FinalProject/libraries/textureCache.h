@@ -0,0 +1,65 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum TextureFormat {
+    TEXTURE_RGB8 = 0, //3 bytes per texel
+    TEXTURE_BC1 = 1,  //DXT1, 8 bytes per 4x4 block, opaque
+    TEXTURE_BC3 = 2   //DXT5, 16 bytes per 4x4 block, BC1 colour plus 8 level alpha
+};
+
+//one mip level, data points into the buffer owning the whole texture
+struct TextureLevel {
+    int width;
+    int height;
+    const unsigned char * data;
+    size_t size;
+};
+
+/************************************************************
+ * Baked texture container (.fftex)
+ *
+ * Holds the complete mip chain of one image, either as RGB8 or
+ * block compressed (BC1/BC3), preceded by a header recording the
+ * image it was baked from (mtime, size, hash).
+ * Loading is one read into one buffer; every level is handed to
+ * the driver as it is stored.
+ ************************************************************/
+struct BakedTexture {
+    TextureFormat format;
+    std::vector<TextureLevel> levels;
+    std::shared_ptr<unsigned char> data;
+};
+
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+//anivia.png -> anivia.fftex
+std::string bakedTexturePath(const std::string & source);
+
+//read bakedFile and check it against source; false when missing or stale
+bool loadBakedTexture(const char * bakedFile, const char * source, BakedTexture & texture);
+//build the mip chain of an RGBA8 image in the given format and write it next to source
+bool bakeTexture(const char * bakedFile, const char * source, const unsigned char * rgba,
+                 int width, int height, TextureFormat format);
+
+/************************************************************
+ * Building blocks of the baker
+ ************************************************************/
+//number of levels down to 1x1
+int mipLevelCount(int width, int height);
+//2x2 box filter of an RGBA8 image, odd edges are clamped
+void downsample(const unsigned char * rgba, int width, int height, std::vector<unsigned char> & half);
+//bytes of one level in the given format
+size_t levelSize(TextureFormat format, int width, int height);
+//encode one RGBA8 level, blocks on the right and bottom edges repeat their last texel
+void encodeLevel(TextureFormat format, const unsigned char * rgba, int width, int height, unsigned char * out);
+//4x4 RGBA8 texels in row order to one block
+void encodeBC1Block(const unsigned char * block, unsigned char * out);
+void encodeBC3Block(const unsigned char * block, unsigned char * out);
+
+#endif // TEXTURECACHE_H
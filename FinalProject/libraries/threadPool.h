@@ -0,0 +1,48 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/************************************************************
+ * Fixed set of worker threads running queued tasks
+ ************************************************************/
+class ThreadPool {
+public:
+    //0 threads means one per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    void submit(const std::function<void()> & task);
+    //block until the queue is empty and every worker is idle
+    void wait();
+    //run body(0) .. body(count - 1) on the workers and the calling thread, returns when all are done;
+    //the caller only waits for items already running, so it is safe to call from a worker
+    void parallelFor(size_t count, const std::function<void(size_t)> & body);
+
+    inline unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+    //index of the calling worker in [0, size()), -1 on any other thread
+    static int workerIndex();
+
+private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator= (const ThreadPool &);
+
+    void work(int index);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    unsigned int busy;
+    bool stopping;
+};
+
+#endif // THREADPOOL_H
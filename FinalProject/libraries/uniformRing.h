@@ -0,0 +1,80 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+#include <cstddef>
+
+/************************************************************
+ * Ring of per-draw parameter blocks
+ *
+ * Every draw copies its blocks into the next free range of one
+ * buffer and binds that range with glBindBufferRange, instead of
+ * setting each parameter with its own glUniform call. An
+ * instanced draw pushes one block per instance in a single range,
+ * read as an array by the shader. The buffer holds FRAMES frames
+ * of ranges; a frame writes its part while the GPU may still read
+ * the parts of the frames before it, and a fence per part makes
+ * the writer wait before reusing one the GPU has not finished
+ * with.
+ *
+ * The ranges are bound to a uniform block or, for arrays of any
+ * length, a shader storage block; each starts at the offset
+ * alignment of its target.
+ *
+ * With ARB_buffer_storage (core in 4.4) the buffer is mapped
+ * once, persistently and coherently, so a push is a memcpy.
+ * Without it each range is written with glBufferSubData, which
+ * leaves the synchronisation to the driver.
+ *
+ * A frame pushing more blocks than a part holds waits for the GPU
+ * and starts again in a buffer at least twice the size.
+ ************************************************************/
+class UniformRing
+{
+public:
+	static const int FRAMES = 3;
+
+	//needs the GL context; target is GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER, blockSize bytes
+	//per draw or instance, bound to binding. Without allowPersistent the glBufferSubData path is taken
+	//even where buffer storage is supported, for comparisons
+	UniformRing(GLenum target, GLuint binding, size_t blockSize, size_t blocksPerFrame = 256, bool allowPersistent = true);
+	~UniformRing();
+
+	//before the first push of a frame, waits for the GPU to be done with the part it reuses
+	void beginFrame();
+	//copy count blocks of blockSize bytes into the next range and bind it for the next draw
+	void push(const void * blocks, size_t count = 1);
+	//after the last draw of the frame
+	void endFrame();
+
+	inline bool persistent() const { return mapped != 0; }
+	inline size_t blocksPerFrame() const { return capacity / blockSize; }
+
+private:
+	UniformRing(const UniformRing &);
+	UniformRing & operator=(const UniformRing &);
+
+	void allocate(size_t bytesPerFrame);
+	void release();
+
+	GLenum target;
+	GLuint binding;
+	bool allowPersistent;
+	size_t blockSize;
+	//GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT or GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+	size_t alignment;
+	//bytes in the part of one frame, a multiple of alignment
+	size_t capacity;
+	GLuint buffer;
+	char * mapped;
+	GLsync fences[FRAMES];
+	int frame;
+	//bytes of the current part written this frame
+	size_t used;
+};
+
+#endif // UNIFORMRING_H
@@ -0,0 +1,172 @@
+#ifndef VERTEXCLUSTERING_H
+#define VERTEXCLUSTERING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/************************************************************
+ * Sort-based vertex clustering
+ *
+ * Puts every vertex in a cell of an r x r x r grid of cubes:
+ * the cell keys of all vertices are computed in one pass and
+ * radix-sorted together with the vertex indices, so each
+ * occupied cell becomes one contiguous run of vertices.
+ * Runs keep the input order of their vertices and are numbered
+ * in ascending cell order. Nothing is allocated per cell and
+ * empty cells cost nothing, so fine grids (r = 256 and up)
+ * cost about the same as coarse ones.
+ ************************************************************/
+class VertexClustering {
+public:
+    VertexClustering();
+
+    //cluster count positions read stride bytes apart; cells are size / r wide with the
+    //first one starting at origin, positions outside the grid go to the nearest border cell
+    void build(const float * positions, size_t count, size_t stride, const float * origin, float size, unsigned int r);
+
+    inline size_t clusterCount() const { return cells.size(); }
+    //x + r * y + r * r * z of the cell holding a cluster
+    inline uint64_t cell(size_t cluster) const { return cells[cluster]; }
+    //cluster of a cell, -1 when the cell is empty; binary search over the occupied cells
+    long long findCell(uint64_t cell) const;
+    //cluster of every input vertex
+    inline const std::vector<unsigned int> & vertexClusters() const { return clusterOf; }
+    //the vertices of a cluster, in input order
+    inline const unsigned int * begin(size_t cluster) const { return order.data() + runStart[cluster]; }
+    inline const unsigned int * end(size_t cluster) const { return order.data() + runStart[cluster + 1]; }
+
+    //mean position of each cluster, 3 floats per cluster
+    void averagePositions(const float * positions, size_t stride, std::vector<float> & out) const;
+    //position of each cluster minimizing the summed squared distances to the planes of the
+    //triangles touching it (quadric error metric, area weighted), kept inside its cell;
+    //directions the planes leave free are settled at the mean, so flat and edge-only
+    //clusters stay where averaging would put them
+    void quadricPositions(const float * positions, size_t stride, const unsigned int * indices, size_t indexCount,
+                          std::vector<float> & out) const;
+
+private:
+    float gridOrigin[3];
+    float cellSize;
+    unsigned int resolution;
+    std::vector<uint64_t> cells;
+    std::vector<unsigned int> clusterOf;
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> runStart;
+};
+
+/************************************************************
+ * Vertex clustering at several resolutions in one pass
+ *
+ * The vertices are read once, for their cells on a base grid
+ * whose resolution is the least common multiple of the requested
+ * ones, so every cell of every level is an exact block of base
+ * cells and its coordinates are integer divisions of theirs.
+ * Levels are built finest first, each from the clusters of the
+ * coarsest level already built that nests in it (30 from 60) or
+ * else from the base cells, merging cell keys and position sums.
+ * Cells are numbered through a hash table sized to the clusters,
+ * so a level costs one pass over its input and a sort of its own
+ * clusters only. When the least common multiple does not fit a
+ * 64-bit key, levels without a finer nesting level read the
+ * vertices again.
+ ************************************************************/
+class ClusterLevels {
+public:
+    ClusterLevels();
+
+    //cluster count positions read stride bytes apart at every resolution, on the grid of
+    //VertexClustering::build; levels keep the order of resolutions
+    void build(const float * positions, size_t count, size_t stride, const float * origin, float size,
+               const std::vector<unsigned int> & resolutions);
+
+    inline size_t levelCount() const { return levels.size(); }
+    inline unsigned int resolution(size_t level) const { return levels[level].r; }
+    inline size_t clusterCount(size_t level) const { return levels[level].cells.size(); }
+    //x + r * y + r * r * z of the cell holding a cluster, ascending within a level
+    inline uint64_t cell(size_t level, size_t cluster) const { return levels[level].cells[cluster]; }
+    //cluster of every input vertex at a level
+    inline const std::vector<unsigned int> & vertexClusters(size_t level) const { return levels[level].clusterOf; }
+    //resolution of the shared base grid, 0 when it would not fit the keys
+    inline unsigned int baseResolution() const { return base; }
+
+    //mean position of each cluster of a level, 3 floats per cluster
+    void averagePositions(size_t level, std::vector<float> & out) const;
+    //quadric positions as in VertexClustering, from the triangles of the input vertices
+    void quadricPositions(size_t level, const float * positions, size_t stride, const unsigned int * indices,
+                          size_t indexCount, std::vector<float> & out) const;
+
+private:
+    struct Level {
+        unsigned int r;
+        std::vector<uint64_t> cells;
+        //x y z sum and vertex count of every cluster
+        std::vector<double> sums;
+        std::vector<unsigned int> clusterOf;
+    };
+
+    void cellCoordinates(const float * positions, size_t count, size_t stride, unsigned int r,
+                         std::vector<unsigned int> & coords) const;
+    void fromVertices(Level & level, const float * positions, size_t stride, const std::vector<unsigned int> & coords,
+                      unsigned int factor) const;
+    void coarsen(const Level & finer, Level & level) const;
+
+    float gridOrigin[3];
+    float gridSize;
+    unsigned int base;
+    std::vector<Level> levels;
+};
+
+//seam-aware simplification of indexed vertices made only of floats, at every resolution.
+//Vertices sharing a cell merge only within one chart (the triangles connected through
+//shared vertices: UV and normal seams split the vertices, so they bound the charts) and
+//their attributes are averaged, the triples at normalOffsets renormalized. The position
+//triples at positionOffsets (the first one places the grid, the others are further poses)
+//are averaged over the whole cell instead, so every chart of a cell gets the same position
+//and seams do not open. Triangles with two corners in one cell are dropped. Offsets count
+//floats; the grid is the cube of Grid::clusterMesh
+void clusterAttributeLevels(const float * vertices, size_t count, size_t floatsPerVertex,
+                            const std::vector<size_t> & positionOffsets, const std::vector<size_t> & normalOffsets,
+                            const unsigned int * indices, size_t indexCount, const std::vector<unsigned int> & resolutions,
+                            std::vector<std::vector<float> > & levelVertices, std::vector<std::vector<unsigned int> > & levelIndices);
+
+//clusterAttributeLevels on a vertex struct of floats, offsets in bytes (offsetof)
+template <class V>
+void simplifyAttributeLevels(const std::vector<V> & vertices, const std::vector<unsigned int> & indices,
+                             const std::vector<size_t> & positionOffsets, const std::vector<size_t> & normalOffsets,
+                             const std::vector<unsigned int> & resolutions, std::vector<std::vector<V> > & levelVertices,
+                             std::vector<std::vector<unsigned int> > & levelIndices)
+{
+    static_assert(sizeof(V) % sizeof(float) == 0, "vertices must be made of floats");
+    static_assert(std::is_trivially_copyable<V>::value, "vertices are copied as raw floats");
+    std::vector<size_t> positions(positionOffsets.size());
+    for (size_t i = 0; i < positions.size(); i++)
+        positions[i] = positionOffsets[i] / sizeof(float);
+    std::vector<size_t> normals(normalOffsets.size());
+    for (size_t i = 0; i < normals.size(); i++)
+        normals[i] = normalOffsets[i] / sizeof(float);
+    std::vector<std::vector<float> > levels;
+    clusterAttributeLevels(reinterpret_cast<const float *>(vertices.data()), vertices.size(), sizeof(V) / sizeof(float),
+                           positions, normals, indices.data(), indices.size(), resolutions, levels, levelIndices);
+    levelVertices.resize(levels.size());
+    for (size_t l = 0; l < levels.size(); l++) {
+        levelVertices[l].resize(levels[l].size() * sizeof(float) / sizeof(V));
+        if (!levels[l].empty())
+            memcpy(static_cast<void *>(levelVertices[l].data()), levels[l].data(), levels[l].size() * sizeof(float));
+    }
+}
+
+//x + r * y + r * r * z, 64 bits wide so grids beyond r = 1290 do not overflow
+inline uint64_t cellKey(unsigned int x, unsigned int y, unsigned int z, unsigned int r)
+{
+    return x + static_cast<uint64_t>(r) * (y + static_cast<uint64_t>(r) * z);
+}
+
+//stable LSD radix sort of keys with values moving along; only the digits below the largest
+//key are sorted and passes whose digit is the same for every key are skipped, so the cost
+//follows the number of keys and not the size of the grid
+void radixSortPairs(std::vector<uint64_t> & keys, std::vector<unsigned int> & values);
+
+#endif // VERTEXCLUSTERING_H
@@ -0,0 +1,38 @@
+#ifndef WELD_H
+#define WELD_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/************************************************************
+ * Vertex welding
+ *
+ * Turns a de-indexed stream (three corners per triangle) into
+ * unique vertices plus an index list. Corners are merged only
+ * when every byte matches, so all morph poses, normals and
+ * texture coordinates survive and UV seams keep their splits.
+ ************************************************************/
+
+//remap[i] receives the unique index of corner i, returns the number of unique vertices;
+//indices are handed out in first-seen order
+size_t weldCorners(const void * corners, size_t count, size_t stride, std::vector<unsigned int> & remap);
+
+//one log line comparing the de-indexed and the welded buffer sizes
+std::string weldReport(const std::string & name, size_t corners, size_t vertices, size_t stride);
+
+//in place: vertices goes from one entry per corner to one entry per unique vertex
+template <class V>
+void weldVertices(std::vector<V> & vertices, std::vector<unsigned int> & indices)
+{
+    size_t unique = weldCorners(vertices.data(), vertices.size(), sizeof(V), indices);
+    //a new index is never larger than the corner it first appears at, so nothing unread is overwritten
+    size_t next = 0;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (indices[i] == next)
+            vertices[next++] = vertices[i];
+    }
+    vertices.resize(unique);
+}
+
+#endif // WELD_H
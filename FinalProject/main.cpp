@@ -27,17 +27,20 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <limits>
 
 #include "Model.h"
 #include "Vec3D.h"
 #include "mesh.h"
+#include "objParser.h"
 #include "grid.h"
+#include "meshCache.h"
+#include "assetLoader.h"
+#include "weld.h"
+#include "meshOptimizer.h"
+#include "programCache.h"
 
 
-Mesh mesh;
-Mesh simplified;
-Grid grid;
-
 bool lightView = false;
 
 double lastFrameTime = 0.0;
@@ -46,7 +49,10 @@ double const maxFrameRate = 60;
 // global variables
 
 glm::vec3 lightDir = { 0,-1,1 };
-int Model::textureCount = 1;
+TextureRegistry Model::textures(1);
+MeshRegistry meshRegistry;
+// workers that large OBJ files are parsed on in chunks, none means serial parsing
+ThreadPool *objParsePool = nullptr;
 
 Anivia anivia;
 //Enemy enemy;
@@ -58,6 +64,9 @@ Shape flame, icicleDiamond;
 std::vector<Shape> icicles;
 std::vector<Shape> flames;
 std::vector<Shape> lifeCrystals;
+// texture scroll of the icicles and flames, added to their texture coordinates by the shader
+glm::vec2 icicleScroll = { 0,0 };
+glm::vec2 flameScroll = { 0,0 };
 int currentIcicle = 0;
 int currentFlame = 0;
 bool bossHit = false;
@@ -74,23 +83,19 @@ Terrain terrain(20, 20, lightDir);
 const int WIDTH = 600;
 const int HEIGHT = 800;
 
-std::vector<BossVertex> formatMeshVertices(std::vector<Vertex> vertices, std::vector<Triangle> triangles)
+// The mesh is already indexed, so its positions, normals and triangles map straight onto the vertex and index buffers
+void formatMeshVertices(const Mesh &mesh, std::vector<BossVertex> &bossVertices, std::vector<unsigned int> &indices)
 {
-	std::vector<BossVertex> bossVertices;
-	for (int i=0;i<triangles.size();++i)
+	bossVertices.resize(mesh.positions.size());
+	for (int i = 0; i < mesh.positions.size(); ++i)
 	{
-	    for(int v = 0; v < 3 ; v++){
-			BossVertex vertex;
-			glm::vec3 pos, normal;
-			normal = { vertices[triangles[i].v[v]].n[0], vertices[triangles[i].v[v]].n[1], vertices[triangles[i].v[v]].n[2] };
-			pos = { vertices[triangles[i].v[v]].p[0], vertices[triangles[i].v[v]].p[1] , vertices[triangles[i].v[v]].p[2] };
-			vertex.pos = pos;
-			vertex.normal = normal;
-			bossVertices.push_back(vertex);
-	    }
-	
+		BossVertex vertex = {};
+		vertex.pos = { mesh.positions[i][0], mesh.positions[i][1], mesh.positions[i][2] };
+		vertex.normal = { mesh.normals[i][0], mesh.normals[i][1], mesh.normals[i][2] };
+		bossVertices[i] = vertex;
 	}
-	return bossVertices;
+	// triangles are index triplets already
+	indices.assign(mesh.indexData(), mesh.indexData() + 3 * mesh.triangles.size());
 }
 
 struct Mouse
@@ -106,58 +111,6 @@ struct Mouse
 
 Mouse mouse;
 
-// Helper function to read a file like a shader
-std::string readFile(const std::string& path) {
-	std::ifstream file(path, std::ios::binary);
-	
-	std::stringstream buffer;
-	buffer << file.rdbuf();
-
-	return buffer.str();
-}
-
-bool checkShaderErrors(GLuint shader) {
-	// Check if the shader compiled successfully
-	GLint compileSuccessful;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileSuccessful);
-
-	// If it didn't, then read and print the compile log
-	if (!compileSuccessful) {
-		GLint logLength;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-
-		std::vector<GLchar> logBuffer(logLength);
-		glGetShaderInfoLog(shader, logLength, nullptr, logBuffer.data());
-
-		std::cerr << logBuffer.data() << std::endl;
-		
-		return false;
-	} else {
-		return true;
-	}
-}
-
-bool checkProgramErrors(GLuint program) {
-	// Check if the program linked successfully
-	GLint linkSuccessful;
-	glGetProgramiv(program, GL_LINK_STATUS, &linkSuccessful);
-
-	// If it didn't, then read and print the link log
-	if (!linkSuccessful) {
-		GLint logLength;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-		std::vector<GLchar> logBuffer(logLength);
-		glGetProgramInfoLog(program, logLength, nullptr, logBuffer.data());
-
-		std::cerr << logBuffer.data() << std::endl;
-		
-		return false;
-	} else {
-		return true;
-	}
-}
-
 // OpenGL debug callback
 void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
 	if (severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
@@ -270,21 +223,71 @@ void initBoss(Boss &boss)
 	boss.safeDistance = 2.0;
 	boss.coolDownTime = 3.0;
 	boss.mixFactor.increment = 0.05;
-	mesh.loadMesh("boss.obj");
-	boss.vertices = formatMeshVertices(mesh.vertices, mesh.triangles);
-	boss.simplifiedVertices.push_back(boss.vertices);
-		
-	for (int i = 0; i < 5; i++)
+}
+
+// Full boss mesh for the damage states, drawn until its simplified levels are ready
+int buildBossMesh(Boss &boss)
+{
+	Mesh mesh;
+	if (!mesh.loadMesh("boss.obj", objParsePool))
+	{
+		std::cerr << "Failed to load boss.obj" << std::endl;
+		return EXIT_FAILURE;
+	}
+	formatMeshVertices(mesh, boss.vertices, boss.indices);
+	return 0;
+}
+
+// Grid resolutions of the simplified boss levels, finest first
+const std::vector<unsigned int> bossLodResolutions = { 70, 60, 50, 40, 30 };
+const std::vector<std::string> bossLodSources = { "boss.obj" };
+
+// Everything the simplified levels depend on besides boss.obj, change the tag when the simplification changes
+uint64_t bossLodKey()
+{
+	std::string key = "grid levels average cache kernels 2";
+	for (unsigned int r : bossLodResolutions)
+		key += " " + std::to_string(r);
+	return hashBytes(key.data(), key.size());
+}
+
+// Simplified boss meshes for the damage states, CPU only
+int simplifyBoss(std::vector<MeshLevel<BossVertex> > &levels)
+{
+	Mesh mesh;
+	if (!mesh.loadMesh("boss.obj", objParsePool))
+	{
+		std::cerr << "Failed to load boss.obj" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// every resolution at once, the boss is small enough for simplifyLevels to run them separately
+	Grid grid;
+	std::vector<Mesh> simplifiedLevels = grid.simplifyLevels(mesh, bossLodResolutions);
+	levels.resize(bossLodResolutions.size());
+	for (size_t i = 0; i < bossLodResolutions.size(); i++)
 	{
-		Mesh simplified;
-		simplified = grid.simplifyMesh(mesh, 70 - i * 10);
-		for (int y = 0; y < simplified.vertices.size(); y++) {
-			simplified.vertices[y].p[1] += 0.50;
-			simplified.vertices[y].p[2] -= 0.17;
+		Mesh &simplified = simplifiedLevels[i];
+		for (int y = 0; y < simplified.positions.size(); y++) {
+			simplified.positions[y][1] += 0.50;
+			simplified.positions[y][2] -= 0.17;
 		}
+		formatMeshVertices(simplified, levels[i].vertices, levels[i].indices);
+		std::cerr << optimizeMesh("boss r=" + std::to_string(bossLodResolutions[i]), levels[i].vertices, levels[i].indices, offsetof(BossVertex, pos));
+	}
+	return 0;
+}
 
-		boss.simplifiedVertices.push_back(formatMeshVertices(simplified.vertices, simplified.triangles));
-	}	
+// Take the simplified levels from boss_lods.ffmesh when it is up to date, otherwise simplify and bake them
+int buildBossLods(std::vector<MeshLevel<BossVertex> > &levels)
+{
+	if (loadBakedLevels("boss_lods.ffmesh", bossLodSources, bossLodKey(), levels))
+		return 0;
+	if (simplifyBoss(levels) != 0)
+		return EXIT_FAILURE;
+	if (!bakeLevels("boss_lods.ffmesh", bossLodSources, bossLodKey(), levels))
+		std::cerr << "Could not write boss_lods.ffmesh" << std::endl;
+	return 0;
 }
 
 void initIcicles(std::vector<Shape> &icicles)
@@ -322,7 +325,6 @@ void initIcicles(std::vector<Shape> &icicles)
 		shape.points.push_back(vertex);
 	}
 	shape.indices = { 0,1,4,1,2,3,1,3,4 };
-	shape.vertices = shape.generateVertices();
 
 	for(int i = 0; i < 5; i++)
 	{
@@ -363,7 +365,6 @@ void initLifeCrystal(Shape &shape)
 		shape.points.push_back(vertex);
 	}
 	shape.indices = { 0,1,3,1,2,3 };
-	shape.vertices = shape.generateVertices();
 }
 
 void initLifeCrystals(std::vector<Shape> &crystals)
@@ -416,7 +417,6 @@ void initFlame(Shape &shape)
 		shape.points.push_back(vertex);
 	}
 	shape.indices = { 0,1,2,0,2,3,0,3,4,0,4,5,0,5,6,0,6,7 };
-	shape.vertices = shape.generateVertices();
 }
 
 void initFlames(std::vector<Shape> &flames)
@@ -437,51 +437,394 @@ void initIceBerg(Model &iceBerg)
 	iceBerg.position = { 0,1,2.8 };
 }
 
-int loadIceBerg(IceBerg &iceBerg)
+// Append the triangle corners of an OBJ file as the base pose (position, normal, texture coordinates)
+template <class V>
+int loadBasePose(const std::string &fileName, std::vector<V> &vertices)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
+	ObjData obj;
 	std::string err;
-	//load
+
+	if (!loadObj(fileName.c_str(), obj, err, objParsePool)) {
+		std::cerr << err << std::endl;
+		return EXIT_FAILURE;
+	}
+	// Read triangle vertices from OBJ file
+	vertices.reserve(vertices.size() + obj.indices.size());
+	for (const auto& index : obj.indices) {
+		V vertex = {};
+
+		// Retrieve coordinates for vertex by index
+		vertex.pos = {
+			obj.positions[3 * index.vertex + 0],
+			obj.positions[3 * index.vertex + 1],
+			obj.positions[3 * index.vertex + 2]
+		};
+
+		// Retrieve components of normal by index
+		if (index.normal >= 0) {
+			vertex.normal = {
+				obj.normals[3 * index.normal + 0],
+				obj.normals[3 * index.normal + 1],
+				obj.normals[3 * index.normal + 2]
+			};
+		}
+
+		// Retrieve coordinates for texture
+		if (index.texcoord >= 0) {
+			vertex.texCoor = {
+				obj.texcoords[2 * index.texcoord + 0],
+				obj.texcoords[2 * index.texcoord + 1]
+			};
+		}
+
+		vertices.push_back(vertex);
+	}
+	return 0;
+}
+
+// Read an OBJ file with the same topology into one morph pose (pos/normal members) of already loaded vertices
+template <class V>
+int loadPose(const std::string &fileName, std::vector<V> &vertices, glm::vec3 V::*pos, glm::vec3 V::*normal)
+{
+	ObjData obj;
+	std::string err;
+
+	if (!loadObj(fileName.c_str(), obj, err, objParsePool)) {
+		std::cerr << err << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (obj.indices.size() > vertices.size()) {
+		std::cerr << fileName << ": pose has more vertices than the base pose" << std::endl;
+		return EXIT_FAILURE;
+	}
+	// Read triangle vertices from OBJ file
+	for (size_t i = 0; i < obj.indices.size(); i++) {
+		const ObjIndex &index = obj.indices[i];
+
+		// Retrieve coordinates for vertex by index
+		vertices[i].*pos = {
+			obj.positions[3 * index.vertex + 0],
+			obj.positions[3 * index.vertex + 1],
+			obj.positions[3 * index.vertex + 2]
+		};
+
+		// Retrieve components of normal by index
+		if (index.normal >= 0) {
+			vertices[i].*normal = {
+				obj.normals[3 * index.normal + 0],
+				obj.normals[3 * index.normal + 1],
+				obj.normals[3 * index.normal + 2]
+			};
+		}
+	}
+	return 0;
+}
+
+// OBJ files merged into each baked vertex stream, base pose first
+const std::vector<std::string> aniviaPoses = { "anivia_start.obj", "anivia_open_wing.obj", "anivia_attack.obj", "anivia_dead.obj" };
+const std::vector<std::string> enemyPoses = { "aatrox_low.obj", "aatrox_high.obj", "aatrox_dead.obj" };
+const std::vector<std::string> bossPoses = { "boss_low.obj", "boss_high.obj", "boss_attack.obj" };
+const std::vector<std::string> iceBergPoses = { "iceberg.obj" };
+
+int buildAniviaVertices(std::vector<AniviaVertex> &vertices)
+{
+	vertices.clear();
+	if (loadBasePose(aniviaPoses[0], vertices) ||
+		loadPose(aniviaPoses[1], vertices, &AniviaVertex::pos_idle, &AniviaVertex::normal_idle) ||
+		loadPose(aniviaPoses[2], vertices, &AniviaVertex::pos_attack, &AniviaVertex::normal_attack) ||
+		loadPose(aniviaPoses[3], vertices, &AniviaVertex::pos_dead, &AniviaVertex::normal_dead))
+		return EXIT_FAILURE;
+	return 0;
+}
+
+int buildEnemyVertices(std::vector<EnemyVertex> &vertices)
+{
+	vertices.clear();
+	if (loadBasePose(enemyPoses[0], vertices) ||
+		loadPose(enemyPoses[1], vertices, &EnemyVertex::pos_idle, &EnemyVertex::normal_idle) ||
+		loadPose(enemyPoses[2], vertices, &EnemyVertex::pos_dead, &EnemyVertex::normal_dead))
+		return EXIT_FAILURE;
+	return 0;
+}
+
+int buildBossVertices(std::vector<BossVertex> &vertices)
+{
+	vertices.clear();
+	if (loadBasePose(bossPoses[0], vertices) ||
+		loadPose(bossPoses[1], vertices, &BossVertex::pos_idle, &BossVertex::normal_idle) ||
+		loadPose(bossPoses[2], vertices, &BossVertex::pos_attack, &BossVertex::normal_attack))
+		return EXIT_FAILURE;
+	return 0;
+}
+
+int buildIceBergVertices(std::vector<VertexBasic> &vertices)
+{
+	vertices.clear();
+	return loadBasePose(iceBergPoses[0], vertices);
+}
+
+// Everything the baked meshes depend on besides their OBJ files, change it when buildMesh changes
+uint64_t meshKey()
+{
+	std::string key = "weld cache 1";
+	return hashBytes(key.data(), key.size());
+}
+
+// Parse the OBJ poses, weld the per-corner stream into unique vertices and indices, then order
+// the triangles for the vertex cache and the vertices for fetching
+template <class V>
+int buildMesh(const char *name, std::vector<V> &vertices, std::vector<unsigned int> &indices, int (*build)(std::vector<V> &))
+{
+	if (build(vertices) != 0)
+		return EXIT_FAILURE;
+	weldVertices(vertices, indices);
+	std::cerr << weldReport(name, indices.size(), vertices.size(), sizeof(V));
+	std::cerr << optimizeMesh(name, vertices, indices, offsetof(V, pos));
+	return 0;
+}
+
+// Take the vertex and index buffers from their baked file when it is up to date, otherwise build and bake them
+template <class V>
+int loadVertices(const char *cacheFile, const std::vector<std::string> &sources, std::vector<V> &vertices, std::vector<unsigned int> &indices, int (*build)(std::vector<V> &))
+{
+	if (loadBakedVertices(cacheFile, sources, vertices, indices, meshKey()))
+		return 0;
+	if (buildMesh(cacheFile, vertices, indices, build) != 0)
+		return EXIT_FAILURE;
+	if (!bakeVertices(cacheFile, sources, vertices, indices, meshKey()))
+		std::cerr << "Could not write " << cacheFile << std::endl;
+	return 0;
+}
+
+template <class V>
+bool bakeMesh(const char *cacheFile, const std::vector<std::string> &sources, int (*build)(std::vector<V> &))
+{
+	std::vector<V> vertices;
+	std::vector<unsigned int> indices;
+	return buildMesh(cacheFile, vertices, indices, build) == 0 && bakeVertices(cacheFile, sources, vertices, indices, meshKey());
+}
+
+// Where a vertex type keeps its pose positions (the base pose first) and its normals
+struct VertexLayout
+{
+	std::vector<size_t> positions;
+	std::vector<size_t> normals;
+};
+
+const VertexLayout aniviaLayout = {
+	{ offsetof(AniviaVertex, pos), offsetof(AniviaVertex, pos_idle), offsetof(AniviaVertex, pos_attack), offsetof(AniviaVertex, pos_dead) },
+	{ offsetof(AniviaVertex, normal), offsetof(AniviaVertex, normal_idle), offsetof(AniviaVertex, normal_attack), offsetof(AniviaVertex, normal_dead) } };
+const VertexLayout enemyLayout = {
+	{ offsetof(EnemyVertex, pos), offsetof(EnemyVertex, pos_idle), offsetof(EnemyVertex, pos_dead) },
+	{ offsetof(EnemyVertex, normal), offsetof(EnemyVertex, normal_idle), offsetof(EnemyVertex, normal_dead) } };
+const VertexLayout bossLayout = {
+	{ offsetof(BossVertex, pos), offsetof(BossVertex, pos_idle), offsetof(BossVertex, pos_attack) },
+	{ offsetof(BossVertex, normal), offsetof(BossVertex, normal_idle), offsetof(BossVertex, normal_attack) } };
+
+// Seam-aware levels of detail of the textured models, they keep the UVs and morph poses
+const std::vector<unsigned int> aniviaLodResolutions = { 70, 50, 30 };
+const std::vector<unsigned int> enemyLodResolutions = { 70, 50, 30 };
+const std::vector<unsigned int> bossTexturedLodResolutions = { 50, 30, 20 };
+
+// Everything the cached levels depend on besides their sources, change the tag when the clustering changes
+uint64_t lodKey(const std::vector<unsigned int> &resolutions)
+{
+	std::string key = "seams shared positions cache 1";
+	for (unsigned int r : resolutions)
+		key += " " + std::to_string(r);
+	return hashBytes(key.data(), key.size());
+}
+
+template <class V>
+void simplifyLods(const char *name, const std::vector<V> &vertices, const std::vector<unsigned int> &indices, const VertexLayout &layout,
+	const std::vector<unsigned int> &resolutions, std::vector<MeshLevel<V> > &levels)
+{
+	std::vector<std::vector<V> > levelVertices;
+	std::vector<std::vector<unsigned int> > levelIndices;
+	simplifyAttributeLevels(vertices, indices, layout.positions, layout.normals, resolutions, levelVertices, levelIndices);
+	levels.resize(levelVertices.size());
+	for (size_t i = 0; i < levels.size(); i++)
 	{
-		int vertexCounter = 0;
-		// load initial pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "iceberg.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
+		levels[i].vertices.swap(levelVertices[i]);
+		levels[i].indices.swap(levelIndices[i]);
+		std::cerr << optimizeMesh(std::string(name) + " r=" + std::to_string(resolutions[i]), levels[i].vertices, levels[i].indices, layout.positions[0]);
+	}
+}
+
+// Take the levels of a welded mesh from cacheFile when it is up to date, otherwise simplify and bake them;
+// an empty vertices is parsed from the poses first
+template <class V>
+int loadLods(const char *cacheFile, const std::vector<std::string> &sources, const VertexLayout &layout, const std::vector<unsigned int> &resolutions,
+	std::vector<V> &vertices, std::vector<unsigned int> &indices, int (*build)(std::vector<V> &), std::vector<MeshLevel<V> > &levels)
+{
+	if (loadBakedLevels(cacheFile, sources, lodKey(resolutions), levels))
+		return 0;
+	if (vertices.empty() && buildMesh(cacheFile, vertices, indices, build) != 0)
+		return EXIT_FAILURE;
+	simplifyLods(cacheFile, vertices, indices, layout, resolutions, levels);
+	if (!bakeLevels(cacheFile, sources, lodKey(resolutions), levels))
+		std::cerr << "Could not write " << cacheFile << std::endl;
+	return 0;
+}
+
+template <class V>
+bool bakeLods(const char *cacheFile, const std::vector<std::string> &sources, const VertexLayout &layout, const std::vector<unsigned int> &resolutions,
+	int (*build)(std::vector<V> &))
+{
+	std::vector<V> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLevel<V> > levels;
+	if (buildMesh(cacheFile, vertices, indices, build) != 0)
+		return false;
+	simplifyLods(cacheFile, vertices, indices, layout, resolutions, levels);
+	return bakeLevels(cacheFile, sources, lodKey(resolutions), levels);
+}
+
+// Convex collision proxies of the characters that touch each other, the baked file holds one level per pose
+uint64_t proxyKey()
+{
+	std::string key = "kdop 128 margin 1";
+	return hashBytes(key.data(), key.size());
+}
+
+template <class V>
+void buildProxy(const std::vector<V> &vertices, const VertexLayout &layout, ConvexProxy &proxy)
+{
+	std::vector<const float *> poses;
+	for (size_t offset : layout.positions)
+		poses.push_back(reinterpret_cast<const float *>(reinterpret_cast<const char *>(vertices.data()) + offset));
+	proxy.build(poses, vertices.size(), sizeof(V));
+}
+
+bool bakeProxy(const char *cacheFile, const std::vector<std::string> &sources, const ConvexProxy &proxy)
+{
+	std::vector<MeshLevel<float> > levels(proxy.poseCount());
+	for (size_t i = 0; i < levels.size(); i++)
+		proxy.savePose(i, levels[i].vertices);
+	return bakeLevels(cacheFile, sources, proxyKey(), levels);
+}
+
+// Take the proxy of a welded mesh from cacheFile when it is up to date, otherwise derive it from the poses and bake it
+template <class V>
+void loadProxy(const char *cacheFile, const std::vector<std::string> &sources, const std::vector<V> &vertices, const VertexLayout &layout, ConvexProxy &proxy)
+{
+	std::vector<MeshLevel<float> > levels;
+	if (loadBakedLevels(cacheFile, sources, proxyKey(), levels) && levels.size() == layout.positions.size())
+	{
+		bool valid = true;
+		for (size_t i = 0; i < levels.size() && valid; i++)
+			valid = proxy.addPose(levels[i].vertices.data(), levels[i].vertices.size());
+		if (valid)
+			return;
+		proxy.clear();
+	}
+	buildProxy(vertices, layout, proxy);
+	if (!bakeProxy(cacheFile, sources, proxy))
+		std::cerr << "Could not write " << cacheFile << std::endl;
+}
+
+template <class V>
+bool bakeProxy(const char *cacheFile, const std::vector<std::string> &sources, const VertexLayout &layout, int (*build)(std::vector<V> &))
+{
+	std::vector<V> vertices;
+	std::vector<unsigned int> indices;
+	ConvexProxy proxy;
+	if (buildMesh(cacheFile, vertices, indices, build) != 0)
+		return false;
+	buildProxy(vertices, layout, proxy);
+	return bakeProxy(cacheFile, sources, proxy);
+}
+
+// Rebuild every baked mesh from its OBJ files (run with --bake)
+int bakeMeshes()
+{
+	if (!bakeMesh("anivia.ffmesh", aniviaPoses, buildAniviaVertices) ||
+		!bakeMesh("aatrox.ffmesh", enemyPoses, buildEnemyVertices) ||
+		!bakeMesh("boss.ffmesh", bossPoses, buildBossVertices) ||
+		!bakeMesh("iceberg.ffmesh", iceBergPoses, buildIceBergVertices))
+	{
+		std::cerr << "Baking meshes failed!" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<MeshLevel<BossVertex> > bossLods;
+	if (simplifyBoss(bossLods) != 0 || !bakeLevels("boss_lods.ffmesh", bossLodSources, bossLodKey(), bossLods))
+	{
+		std::cerr << "Baking boss_lods.ffmesh failed!" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!bakeLods("anivia_lods.ffmesh", aniviaPoses, aniviaLayout, aniviaLodResolutions, buildAniviaVertices) ||
+		!bakeLods("aatrox_lods.ffmesh", enemyPoses, enemyLayout, enemyLodResolutions, buildEnemyVertices) ||
+		!bakeLods("boss_textured_lods.ffmesh", bossPoses, bossLayout, bossTexturedLodResolutions, buildBossVertices))
+	{
+		std::cerr << "Baking the textured levels of detail failed!" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (!bakeProxy("anivia_proxy.ffmesh", aniviaPoses, aniviaLayout, buildAniviaVertices) ||
+		!bakeProxy("aatrox_proxy.ffmesh", enemyPoses, enemyLayout, buildEnemyVertices))
+	{
+		std::cerr << "Baking the collision proxies failed!" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "Baked anivia.ffmesh, aatrox.ffmesh, boss.ffmesh, iceberg.ffmesh, boss_lods.ffmesh, the anivia, aatrox and boss_textured level of detail files and the anivia and aatrox collision proxies" << std::endl;
+	return 0;
+}
+
+// Images baked into mip chains next to themselves
+const char *bakedTextures[] = { "anivia.png", "Aatrox_Base_Mat.png", "legenddragon-fire.png", "iceberg.jpg", "terrain.jpg", "icicle.png", "fire2.png" };
+
+// Rebuild every baked texture (run with --bake), BC1 unless uncompressed is asked for;
+// the game samples RGB only, alpha is kept (BC3) only on request
+int bakeTextures(bool compress, bool keepAlpha)
+{
+	for (const char *fileName : bakedTextures)
+	{
+		TextureImage image;
+		if (!decodeImage(fileName, image, 4))
+		{
+			std::cout << "Skipped " << fileName << std::endl;
+			continue;
 		}
-		// Read triangle vertices from OBJ file
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				EnemyVertex vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				// Retrieve coordinates for texture
-				vertex.texCoor = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-
-				iceBerg.vertices.push_back(vertex);
-			}
+
+		unsigned char *rgba = image.pixels.get();
+		size_t texels = (size_t)image.width * image.height;
+		bool hasAlpha = false;
+		for (size_t i = 0; i < texels; i++)
+		{
+			if (!keepAlpha)
+				rgba[4 * i + 3] = 255;
+			hasAlpha = hasAlpha || rgba[4 * i + 3] != 255;
 		}
+		TextureFormat format = !compress ? TEXTURE_RGB8 : hasAlpha ? TEXTURE_BC3 : TEXTURE_BC1;
+
+		std::string bakedFile = bakedTexturePath(fileName);
+		if (!bakeTexture(bakedFile.c_str(), fileName, rgba, image.width, image.height, format))
+		{
+			std::cerr << "Baking " << fileName << " failed!" << std::endl;
+			return EXIT_FAILURE;
+		}
+		uint64_t mtime, size;
+		fileStat(bakedFile.c_str(), mtime, size);
+		std::cout << "Baked " << bakedFile << ": " << image.width << "x" << image.height << ", "
+			<< mipLevelCount(image.width, image.height) << " levels, " << texels * 3 / 1024 << " KB RGB8 -> "
+			<< size / 1024 << " KB" << std::endl;
+	}
+	return 0;
+}
 
+// Element buffer, recorded in the currently bound vertex array
+void loadIndices(GLuint &ebo, const std::vector<unsigned int> &indices)
+{
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+}
+
+int loadIceBerg(IceBerg &iceBerg, const TextureImage &texture)
+{
+	//load
+	{
 		// load texture for enemy
-		iceBerg.loadTexture("iceberg.jpg");
+		iceBerg.loadTexture("iceberg.jpg", texture);
 
 		/////// handle the vertices of enemy
 		{
@@ -503,6 +846,8 @@ int loadIceBerg(IceBerg &iceBerg)
 			glBindBuffer(GL_ARRAY_BUFFER, iceBerg.vbo);
 			glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, texCoor)));
 			glEnableVertexAttribArray(8);
+
+			loadIndices(iceBerg.ebo, iceBerg.indices);
 		}
 		return 0;
 	}
@@ -529,152 +874,96 @@ void initEnemies(std::vector<Enemy> &enemies)
 		enemies.push_back(enemy);
 	}
 }
-int loadAnivia(Anivia &anivia)
+// Full mesh followed by its simplified levels in one vertex and one index buffer, their draw ranges
+// and the bounding sphere of every pose go to chain
+template <class V>
+void uploadLods(GLuint vao, GLuint vbo, GLuint ebo, const std::vector<V> &fullVertices, const std::vector<unsigned int> &fullIndices,
+	const std::vector<MeshLevel<V> > &levels, const std::vector<unsigned int> &resolutions, const VertexLayout &layout, LodChain &chain)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-
-	//load ANIVIA
+	std::vector<V> vertices = fullVertices;
+	std::vector<unsigned int> indices = fullIndices;
+	LodRange full = { 0, 0, (GLsizei)indices.size() };
+	chain.levels.assign(1, full);
+	chain.resolutions.assign(1, 0);
+	for (size_t i = 0; i < levels.size(); i++)
 	{
-		int vertexCounter = 0;
-		// load initial pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "anivia_start.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				AniviaVertex vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				// Retrieve coordinates for texture
-				vertex.texCoor = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-
-				anivia.vertices.push_back(vertex);
-			}
-		}
+		LodRange range = { (GLint)vertices.size(), (GLsizei)indices.size(), (GLsizei)levels[i].indices.size() };
+		chain.levels.push_back(range);
+		chain.resolutions.push_back(resolutions[i]);
+		vertices.insert(vertices.end(), levels[i].vertices.begin(), levels[i].vertices.end());
+		indices.insert(indices.end(), levels[i].indices.begin(), levels[i].indices.end());
+	}
 
-		//load idle pose (animation between initial and idle pose)
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "anivia_open_wing.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				anivia.vertices[vertexCounter].pos_idle = vertex.pos;
-				anivia.vertices[vertexCounter].normal_idle = vertex.normal;
-				vertexCounter++;
-			}
+	// box center of all poses, radius to the farthest pose position
+	glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+	for (const V &vertex : fullVertices)
+		for (size_t offset : layout.positions)
+		{
+			const glm::vec3 &p = *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const char *>(&vertex) + offset);
+			low = glm::min(low, p);
+			high = glm::max(high, p);
 		}
+	glm::vec3 center = 0.5f * (low + high);
+	float radius = 0.0f;
+	for (const V &vertex : fullVertices)
+		for (size_t offset : layout.positions)
+			radius = std::max(radius, glm::distance(center, *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const char *>(&vertex) + offset)));
+	chain.center[0] = center.x;
+	chain.center[1] = center.y;
+	chain.center[2] = center.z;
+	chain.radius = radius;
 
-		//load attack pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "anivia_attack.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				anivia.vertices[vertexCounter].pos_attack = vertex.pos;
-				anivia.vertices[vertexCounter].normal_attack = vertex.normal;
-				vertexCounter++;
-			}
-		}
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(V), vertices.data(), GL_STATIC_DRAW);
+	// the element binding belongs to the vertex array
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+}
 
-		//load idle pose (animation between initial and idle pose)
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "anivia_dead.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				anivia.vertices[vertexCounter].pos_dead = vertex.pos;
-				anivia.vertices[vertexCounter].normal_dead = vertex.normal;
-				vertexCounter++;
-			}
-		}
-	}
+// Textured boss levels, they arrive from a background job and may come before or after the boss buffers
+std::vector<MeshLevel<BossVertex> > bossTexturedLevels;
+
+void uploadTexturedBoss(Boss &boss)
+{
+	uploadLods(boss.vao_tex, boss.vbo_tex, boss.ebo_tex, boss.texturedVertices, boss.texturedIndices, bossTexturedLevels,
+		bossTexturedLodResolutions, bossLayout, boss.texturedLods);
+}
+
+// CPU side of a mesh that is not kept by its model, filled by the decode step
+template <class V>
+struct MeshData
+{
+	std::vector<V> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLevel<V> > levels;
+	TextureImage texture;
+	MeshBvh hitMesh;
+	ConvexProxy proxy;
+};
+
+// Hit test tree over every pose of a mesh, built with the decode step
+template <class V>
+void buildHitMesh(const std::vector<V> &vertices, const std::vector<unsigned int> &indices, const VertexLayout &layout, MeshBvh &hitMesh)
+{
+	std::vector<const float *> poses;
+	for (size_t offset : layout.positions)
+		poses.push_back(reinterpret_cast<const float *>(reinterpret_cast<const char *>(vertices.data()) + offset));
+	hitMesh.build(poses, vertices.size(), sizeof(V), indices.data(), indices.size());
+}
 
+int loadAnivia(Anivia &anivia, MeshData<AniviaVertex> &data)
+{
 	// load texture for anivia
-	anivia.loadTexture("anivia.png");
+	anivia.loadTexture("anivia.png", data.texture);
+	anivia.vertices.swap(data.vertices);
+	anivia.indices.swap(data.indices);
+	anivia.hitMesh = std::make_shared<const MeshBvh>(std::move(data.hitMesh));
+	anivia.proxy = std::make_shared<const ConvexProxy>(std::move(data.proxy));
 
 	/////// handle the vertices of anivia
 	{
 		glGenBuffers(1, &anivia.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, anivia.vbo);
-		glBufferData(GL_ARRAY_BUFFER, anivia.vertices.size() * sizeof(AniviaVertex), anivia.vertices.data(), GL_STATIC_DRAW);
 
 		glGenVertexArrays(1, &anivia.vao);
 		glBindVertexArray(anivia.vao);
@@ -714,156 +1003,76 @@ int loadAnivia(Anivia &anivia)
 		glBindBuffer(GL_ARRAY_BUFFER, anivia.vbo);
 		glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(AniviaVertex), reinterpret_cast<void*>(offsetof(AniviaVertex, texCoor)));
 		glEnableVertexAttribArray(8);
+
+		glGenBuffers(1, &anivia.ebo);
+		uploadLods(anivia.vao, anivia.vbo, anivia.ebo, anivia.vertices, anivia.indices, data.levels, aniviaLodResolutions, aniviaLayout, anivia.lods);
 	}
 	return 0;
 }
-int loadEnemy(Enemy &enemy)
+// Upload the Aatrox poses once, every Enemy draws with the same buffers and texture
+std::shared_ptr<const MeshResource> loadEnemyMesh(MeshData<EnemyVertex> &data)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-	//load
-	{
-		int vertexCounter = 0;
-		// load initial pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "aatrox_low.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				EnemyVertex vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				// Retrieve coordinates for texture
-				vertex.texCoor = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-
-				enemy.vertices.push_back(vertex);
-			}
-		}
-
-		//load idle pose (animation between initial and idle pose)
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "aatrox_high.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				enemy.vertices[vertexCounter].pos_idle = vertex.pos;
-				enemy.vertices[vertexCounter].normal_idle = vertex.normal;
-				vertexCounter++;
-			}
-		}
-
-		//load dead pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "aatrox_dead.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				enemy.vertices[vertexCounter].pos_dead = vertex.pos;
-				enemy.vertices[vertexCounter].normal_dead = vertex.normal;
-				vertexCounter++;
-			}
-		}
+	std::shared_ptr<const MeshResource> shared = meshRegistry.find(enemyPoses[0]);
+	if (shared)
+		return shared;
 
-	}
+	MeshResource mesh;
+	mesh.indexCount = data.indices.size();
+	mesh.hitMesh = std::make_shared<const MeshBvh>(std::move(data.hitMesh));
+	mesh.proxy = std::make_shared<const ConvexProxy>(std::move(data.proxy));
 
 	// load texture for enemy
-	enemy.loadTexture("Aatrox_Base_Mat.png");
+	std::shared_ptr<const TextureResource> enemyTexture = Model::textures.add("Aatrox_Base_Mat.png", data.texture);
+	mesh.texture = enemyTexture->texture;
+	mesh.textureNumber = enemyTexture->textureNumber;
 
 	/////// handle the vertices of enemy
 	{
-		glGenBuffers(1, &enemy.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
-		glBufferData(GL_ARRAY_BUFFER, enemy.vertices.size() * sizeof(EnemyVertex), enemy.vertices.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &mesh.vbo);
 
-		glGenVertexArrays(1, &enemy.vao);
-		glBindVertexArray(enemy.vao);
+		glGenVertexArrays(1, &mesh.vao);
+		glBindVertexArray(mesh.vao);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, pos)));
 		glEnableVertexAttribArray(0);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, normal)));
 		glEnableVertexAttribArray(1);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, pos_idle)));
 		glEnableVertexAttribArray(2);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, normal_idle)));
 		glEnableVertexAttribArray(3);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, pos_dead)));
 		glEnableVertexAttribArray(6);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, normal_dead)));
 		glEnableVertexAttribArray(7);
 
-		glBindBuffer(GL_ARRAY_BUFFER, enemy.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
 		glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(EnemyVertex), reinterpret_cast<void*>(offsetof(EnemyVertex, texCoor)));
 		glEnableVertexAttribArray(8);
+
+		glGenBuffers(1, &mesh.ebo);
+		uploadLods(mesh.vao, mesh.vbo, mesh.ebo, data.vertices, data.indices, data.levels, enemyLodResolutions, enemyLayout, mesh.lods);
 	}
+	return meshRegistry.add(enemyPoses[0], mesh);
+}
+
+int loadEnemy(Enemy &enemy)
+{
+	std::shared_ptr<const MeshResource> mesh = meshRegistry.find(enemyPoses[0]);
+	if (!mesh)
+		return EXIT_FAILURE;
+	enemy.useMesh(*mesh);
 	return 0;
 }
 
@@ -875,8 +1084,11 @@ void loadEnemies(std::vector<Enemy> &enemies)
 	}
 }
 
-int loadBoss(Boss &boss)
+int loadBossMesh(Boss &boss)
 {
+	// level 0, in front of any simplified level that is already there
+	boss.simplifiedVertices.insert(boss.simplifiedVertices.begin(), boss.vertices);
+	boss.simplifiedIndices.insert(boss.simplifiedIndices.begin(), boss.indices);
 
 	/////// for simplified model
 	{
@@ -894,123 +1106,22 @@ int loadBoss(Boss &boss)
 		glBindBuffer(GL_ARRAY_BUFFER, boss.vbo);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BossVertex), reinterpret_cast<void*>(offsetof(BossVertex, normal)));
 		glEnableVertexAttribArray(1);
-	}
-
-
-	////// LOAD MODEL WITH TEXTURE FOR ANIMATION
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
-	//load
-	{
-		int vertexCounter = 0;
-		// load initial pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "boss_low.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				BossVertex vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				// Retrieve coordinates for texture
-				vertex.texCoor = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-
-				boss.texturedVertices.push_back(vertex);
-			}
-		}
-
-		//load idle pose (animation between initial and idle pose)
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "boss_high.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				boss.texturedVertices[vertexCounter].pos_idle = vertex.pos;
-				boss.texturedVertices[vertexCounter].normal_idle = vertex.normal;
-				vertexCounter++;
-			}
-		}
 
-		//load dead pose
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, "boss_attack.obj")) {
-			std::cerr << err << std::endl;
-			return EXIT_FAILURE;
-		}
-		// Read triangle vertices from OBJ file
-		vertexCounter = 0;
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				VertexBasic vertex = {};
-
-				// Retrieve coordinates for vertex by index
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
-
-				// Retrieve components of normal by index
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-
-				boss.texturedVertices[vertexCounter].pos_attack = vertex.pos;
-				boss.texturedVertices[vertexCounter].normal_attack = vertex.normal;
-				vertexCounter++;
-			}
-		}
+		// sized for the full mesh, every simplified level is smaller
+		loadIndices(boss.ebo, boss.indices);
 	}
+	return 0;
+}
 
-
+int loadBoss(Boss &boss, const TextureImage &texture)
+{
+	////// LOAD MODEL WITH TEXTURE FOR ANIMATION
 	// load texture for enemy
-	boss.loadTexture("legenddragon-fire.png");
+	boss.loadTexture("legenddragon-fire.png", texture);
 
 	/////// handle the vertices of boss
 	{
 		glGenBuffers(1, &boss.vbo_tex);
-		glBindBuffer(GL_ARRAY_BUFFER, boss.vbo_tex);
-		glBufferData(GL_ARRAY_BUFFER, boss.texturedVertices.size() * sizeof(BossVertex), boss.texturedVertices.data(), GL_STATIC_DRAW);
 
 		glGenVertexArrays(1, &boss.vao_tex);
 		glBindVertexArray(boss.vao_tex);
@@ -1042,11 +1153,14 @@ int loadBoss(Boss &boss)
 		glBindBuffer(GL_ARRAY_BUFFER, boss.vbo_tex);
 		glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(BossVertex), reinterpret_cast<void*>(offsetof(BossVertex, texCoor)));
 		glEnableVertexAttribArray(8);
+
+		glGenBuffers(1, &boss.ebo_tex);
+		uploadTexturedBoss(boss);
 	}
 	return 0;
 }
 
-int loadTerrain(Terrain &terrain)
+int loadTerrain(Terrain &terrain, const TextureImage &texture)
 {
 	////////////////terrain
 	{
@@ -1074,83 +1188,207 @@ int loadTerrain(Terrain &terrain)
 		glEnableVertexAttribArray(9);
 	}
 	// add texture for terrain
-	terrain.loadTexture("terrain.jpg");
+	terrain.loadTexture("terrain.jpg", texture);
 
 	
 	return 0;
 }
 
-void loadIcicle(Shape &icicle)
+// Every shape of a kind has the same points, so they all draw with the buffers built from the first one
+void loadShapes(std::vector<Shape> &shapes, const char *textureName, const TextureImage &texture)
 {
-	icicle.loadTexture("icicle.png");
-	glGenBuffers(1, &icicle.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, icicle.vbo);
-	glBufferData(GL_ARRAY_BUFFER, icicle.vertices.size() * sizeof(VertexBasic), icicle.vertices.data(), GL_STATIC_DRAW);
-
-	glGenVertexArrays(1, &icicle.vao);
-	glBindVertexArray(icicle.vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, icicle.vbo);
+	if (shapes.empty())
+		return;
+	Shape &shape = shapes[0];
+	shape.loadTexture(textureName, texture);
+	glGenBuffers(1, &shape.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
+	glBufferData(GL_ARRAY_BUFFER, shape.points.size() * sizeof(VertexBasic), shape.points.data(), GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &shape.vao);
+	glBindVertexArray(shape.vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, pos)));
 	glEnableVertexAttribArray(0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, icicle.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, normal)));
 	glEnableVertexAttribArray(1);
 
-	glBindBuffer(GL_ARRAY_BUFFER, icicle.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
 	glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, texCoor)));
 	glEnableVertexAttribArray(8);
-}
 
-void loadCrystal(Shape &crystal)
-{
-	crystal.loadTexture("icicle.png");
-	glGenBuffers(1, &crystal.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, crystal.vbo);
-	glBufferData(GL_ARRAY_BUFFER, crystal.vertices.size() * sizeof(VertexBasic), crystal.vertices.data(), GL_STATIC_DRAW);
+	loadIndices(shape.ebo, shape.indices);
 
-	glGenVertexArrays(1, &crystal.vao);
-	glBindVertexArray(crystal.vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, crystal.vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, pos)));
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, crystal.vbo);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, normal)));
-	glEnableVertexAttribArray(1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, crystal.vbo);
-	glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, texCoor)));
-	glEnableVertexAttribArray(8);
+	for (int i = 1; i < shapes.size(); i++)
+	{
+		shapes[i].vao = shape.vao;
+		shapes[i].vbo = shape.vbo;
+		shapes[i].ebo = shape.ebo;
+		shapes[i].texture = shape.texture;
+		shapes[i].textureNumber = shape.textureNumber;
+	}
 }
 
+// Every enemy in one instanced draw per level of detail: they share the Aatrox buffers and texture, and
+// each instance reads its placement and poses from its own entry of the draw parameters
+void drawEnemies(const std::vector<Enemy> &enemies, const DrawUniforms &uniforms, int levelShift)
+{
+	if (enemies.empty())
+		return;
+	int coarsest = 0;
+	for (const Enemy &enemy : enemies)
+		coarsest = std::max(coarsest, enemy.lodLevel);
+	std::vector<DrawParameters> instances;
+	instances.reserve(enemies.size());
+	glBindVertexArray(enemies[0].vao);
+	for (int level = 0; level <= coarsest; level++)
+	{
+		instances.clear();
+		for (const Enemy &enemy : enemies)
+			if (enemy.lodLevel == level)
+				instances.push_back(enemy.drawParameters());
+		if (instances.empty())
+			continue;
+		enemies[0].submit(uniforms, instances.data(), instances.size());
+		enemies[0].drawLod(level + levelShift, GLsizei(instances.size()));
+	}
+}
 
-void loadFlame(Shape &flame)
+// Every shape of a kind in one instanced draw, with the buffers loadShapes shares between them
+void drawShapes(const std::vector<Shape> &shapes, const DrawUniforms &uniforms, const glm::vec2 &texOffset = glm::vec2(0.0f))
 {
-	flame.loadTexture("fire2.png");
-	glGenBuffers(1, &flame.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-	glBufferData(GL_ARRAY_BUFFER, flame.vertices.size() * sizeof(VertexBasic), flame.vertices.data(), GL_STATIC_DRAW);
+	if (shapes.empty())
+		return;
+	std::vector<DrawParameters> instances;
+	instances.reserve(shapes.size());
+	for (const Shape &shape : shapes)
+	{
+		instances.push_back(shape.drawParameters());
+		instances.back().texOffset = texOffset;
+	}
+	glBindVertexArray(shapes[0].vao);
+	shapes[0].submit(uniforms, instances.data(), instances.size());
+	glDrawElementsInstanced(GL_TRIANGLES, GLsizei(shapes[0].indices.size()), GL_UNSIGNED_INT, 0, GLsizei(instances.size()));
+}
 
-	glGenVertexArrays(1, &flame.vao);
-	glBindVertexArray(flame.vao);
+// A missing texture is reported by the decode and leaves its models untextured, it does not stop the game
+bool decodeOptionalTexture(const char *fileName, TextureImage &texture)
+{
+	Model::textures.decode(fileName, texture);
+	return true;
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, pos)));
-	glEnableVertexAttribArray(0);
+// Queue every startup asset: decoding runs on the worker pool, the GL upload on the context thread
+void queueAssets(AssetLoader &loader)
+{
+	loader.add<MeshData<AniviaVertex> >("anivia",
+		[](MeshData<AniviaVertex> &data) {
+			if (loadVertices("anivia.ffmesh", aniviaPoses, data.vertices, data.indices, buildAniviaVertices) != 0)
+				return false;
+			buildHitMesh(data.vertices, data.indices, aniviaLayout, data.hitMesh);
+			loadProxy("anivia_proxy.ffmesh", aniviaPoses, data.vertices, aniviaLayout, data.proxy);
+			return loadLods("anivia_lods.ffmesh", aniviaPoses, aniviaLayout, aniviaLodResolutions, data.vertices, data.indices, buildAniviaVertices, data.levels) == 0 &&
+				decodeOptionalTexture("anivia.png", data.texture);
+		},
+		[](MeshData<AniviaVertex> &data) { return loadAnivia(anivia, data) == 0; });
+	loader.add<MeshData<EnemyVertex> >("aatrox",
+		[](MeshData<EnemyVertex> &data) {
+			if (loadVertices("aatrox.ffmesh", enemyPoses, data.vertices, data.indices, buildEnemyVertices) != 0)
+				return false;
+			buildHitMesh(data.vertices, data.indices, enemyLayout, data.hitMesh);
+			loadProxy("aatrox_proxy.ffmesh", enemyPoses, data.vertices, enemyLayout, data.proxy);
+			return loadLods("aatrox_lods.ffmesh", enemyPoses, enemyLayout, enemyLodResolutions, data.vertices, data.indices, buildEnemyVertices, data.levels) == 0 &&
+				decodeOptionalTexture("Aatrox_Base_Mat.png", data.texture);
+		},
+		[](MeshData<EnemyVertex> &data) {
+			if (!loadEnemyMesh(data))
+				return false;
+			loadEnemies(enemies);
+			return true;
+		});
+	loader.add<MeshData<BossVertex> >("boss",
+		[](MeshData<BossVertex> &data) {
+			if (loadVertices("boss.ffmesh", bossPoses, data.vertices, data.indices, buildBossVertices) != 0)
+				return false;
+			buildHitMesh(data.vertices, data.indices, bossLayout, data.hitMesh);
+			return decodeOptionalTexture("legenddragon-fire.png", data.texture);
+		},
+		[](MeshData<BossVertex> &data) {
+			boss.texturedVertices.swap(data.vertices);
+			boss.texturedIndices.swap(data.indices);
+			boss.hitMesh = std::make_shared<const MeshBvh>(std::move(data.hitMesh));
+			return loadBoss(boss, data.texture) == 0;
+		});
+	loader.add("boss mesh",
+		[]() { return buildBossMesh(boss) == 0; },
+		[]() { return loadBossMesh(boss) == 0; });
+	// not needed for the first frames, the boss uses its full mesh until these arrive
+	loader.addBackground<std::vector<MeshLevel<BossVertex> > >("boss LODs",
+		[](std::vector<MeshLevel<BossVertex> > &levels) { return buildBossLods(levels) == 0; },
+		[](std::vector<MeshLevel<BossVertex> > &levels) {
+			for (size_t i = 0; i < levels.size(); i++)
+			{
+				boss.simplifiedVertices.push_back(levels[i].vertices);
+				boss.simplifiedIndices.push_back(levels[i].indices);
+			}
+			return true;
+		});
+	loader.addBackground<std::vector<MeshLevel<BossVertex> > >("boss textured LODs",
+		[](std::vector<MeshLevel<BossVertex> > &levels) {
+			// parsed here rather than read from boss.ffmesh, which the boss job may be rewriting
+			std::vector<BossVertex> vertices;
+			std::vector<unsigned int> indices;
+			return loadLods("boss_textured_lods.ffmesh", bossPoses, bossLayout, bossTexturedLodResolutions, vertices, indices, buildBossVertices, levels) == 0;
+		},
+		[](std::vector<MeshLevel<BossVertex> > &levels) {
+			bossTexturedLevels.swap(levels);
+			// before the boss buffers exist, loadBoss uploads them with the full mesh
+			if (boss.vao_tex)
+				uploadTexturedBoss(boss);
+			return true;
+		});
+	loader.add<TextureImage>("iceberg",
+		[](TextureImage &texture) { return loadVertices("iceberg.ffmesh", iceBergPoses, iceBerg.vertices, iceBerg.indices, buildIceBergVertices) == 0 && decodeOptionalTexture("iceberg.jpg", texture); },
+		[](TextureImage &texture) { return loadIceBerg(iceBerg, texture) == 0; });
+	loader.add<TextureImage>("terrain.jpg",
+		[](TextureImage &texture) { return decodeOptionalTexture("terrain.jpg", texture); },
+		[](TextureImage &texture) { return loadTerrain(terrain, texture) == 0; });
+	loader.add<TextureImage>("icicle.png",
+		[](TextureImage &texture) { return decodeOptionalTexture("icicle.png", texture); },
+		[](TextureImage &texture) {
+			loadShapes(icicles, "icicle.png", texture);
+			loadShapes(lifeCrystals, "icicle.png", texture);
+			return true;
+		});
+	loader.add<TextureImage>("fire2.png",
+		[](TextureImage &texture) { return decodeOptionalTexture("fire2.png", texture); },
+		[](TextureImage &texture) {
+			loadShapes(flames, "fire2.png", texture);
+			return true;
+		});
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, normal)));
-	glEnableVertexAttribArray(1);
+int main(int argc, char** argv) {
+	std::chrono::steady_clock::time_point startupBegin = std::chrono::steady_clock::now();
 
-	glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-	glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(VertexBasic), reinterpret_cast<void*>(offsetof(VertexBasic, texCoor)));
-	glEnableVertexAttribArray(8);
-}
+	// Offline bake of the OBJ vertex streams and textures, no window needed
+	if (argc > 1 && std::string(argv[1]) == "--bake")
+	{
+		bool compress = true, keepAlpha = false;
+		for (int i = 2; i < argc; i++)
+		{
+			compress = compress && std::string(argv[i]) != "--rgb";
+			keepAlpha = keepAlpha || std::string(argv[i]) == "--alpha";
+		}
+		ThreadPool bakePool;
+		objParsePool = &bakePool;
+		int result = bakeMeshes();
+		return result != 0 ? result : bakeTextures(compress, keepAlpha);
+	}
 
-int main() {
 	//init
 	initAnivia(anivia);
 	initIcicles(icicles);
@@ -1161,6 +1399,11 @@ int main() {
 	initEnemies(enemies);
 	initIceBerg(iceBerg);
 
+	// Decode assets on the worker pool while the window and shaders are set up
+	AssetLoader loader;
+	objParsePool = &loader.threads();
+	queueAssets(loader);
+
 	if (!glfwInit()) {
 		std::cerr << "Failed to initialize GLFW!" << std::endl;
 		return EXIT_FAILURE;
@@ -1195,99 +1438,36 @@ int main() {
 	// Set up OpenGL debug callback
 	glDebugMessageCallback(debugCallback, nullptr);
 
-	GLuint mainProgram = glCreateProgram();
-	GLuint shadowProgram = glCreateProgram();
-
-
-	////////////////// Load and compile main shader program
-	{
-		std::string vertexShaderCode = readFile("shader.vert");
-		const char* vertexShaderCodePtr = vertexShaderCode.data();
-
-		GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &vertexShaderCodePtr, nullptr);
-		glCompileShader(vertexShader);
-
-		std::string fragmentShaderCode = readFile("shader.frag");
-		const char* fragmentShaderCodePtr = fragmentShaderCode.data();
-
-		GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fragmentShaderCodePtr, nullptr);
-		glCompileShader(fragmentShader);
-
-		if (!checkShaderErrors(vertexShader) || !checkShaderErrors(fragmentShader)) {
-			std::cerr << "Shader(s) failed to compile!" << std::endl;
-			std::cout << "Press enter to close."; getchar();
-			return EXIT_FAILURE;
-		}
-
-		// Combine vertex and fragment shaders into single shader program
-		glAttachShader(mainProgram, vertexShader);
-		glAttachShader(mainProgram, fragmentShader);
-		glLinkProgram(mainProgram);
-
-		if (!checkProgramErrors(mainProgram)) {
-			std::cerr << "Main program failed to link!" << std::endl;
-			std::cout << "Press enter to close."; getchar();
-			return EXIT_FAILURE;
-		}
+	// The vertex shaders read the per draw parameters from a shader storage block, without one no model can be placed
+	GLint vertexStorageBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+	if (vertexStorageBlocks < 1) {
+		std::cerr << "The driver has no shader storage blocks in vertex shaders!" << std::endl;
+		std::cout << "Press enter to close."; getchar();
+		return EXIT_FAILURE;
 	}
 
-	////////////////// Load and compile shadow shader program
-	{
-		std::string vertexShaderCode = readFile("shadow.vert");
-		const char* vertexShaderCodePtr = vertexShaderCode.data();
-
-		GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &vertexShaderCodePtr, nullptr);
-		glCompileShader(vertexShader);
-
-		std::string fragmentShaderCode = readFile("shadow.frag");
-		const char* fragmentShaderCodePtr = fragmentShaderCode.data();
-
-		GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fragmentShaderCodePtr, nullptr);
-		glCompileShader(fragmentShader);
-
-		if (!checkShaderErrors(vertexShader) || !checkShaderErrors(fragmentShader)) {
-			std::cerr << "Shader(s) failed to compile!" << std::endl;
-			return EXIT_FAILURE;
-		}
-
-		// Combine vertex and fragment shaders into single shader program
-		glAttachShader(shadowProgram, vertexShader);
-		glAttachShader(shadowProgram, fragmentShader);
-		glLinkProgram(shadowProgram);
-
-		if (!checkProgramErrors(shadowProgram)) {
-			std::cerr << "Shadow program failed to link!" << std::endl;
-			return EXIT_FAILURE;
-		}
+	////////////////// Load the main and shadow shader programs, from their cached binaries when possible
+	ProgramCache programs;
+	GLuint mainProgram = programs.load("shader", "shader.vert", "shader.frag");
+	if (!mainProgram) {
+		std::cerr << "Main program failed to link!" << std::endl;
+		std::cout << "Press enter to close."; getchar();
+		return EXIT_FAILURE;
 	}
-
-	////////////////// Load and compile terrain shader program
-	{
-		std::string vertexShaderCode = readFile("terrain.vert");
-		const char* vertexShaderCodePtr = vertexShaderCode.data();
-
-		GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertexShader, 1, &vertexShaderCodePtr, nullptr);
-		glCompileShader(vertexShader);
-
-		std::string fragmentShaderCode = readFile("terrain.frag");
-		const char* fragmentShaderCodePtr = fragmentShaderCode.data();
-
-		GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragmentShader, 1, &fragmentShaderCodePtr, nullptr);
-		glCompileShader(fragmentShader);
-
-		if (!checkShaderErrors(vertexShader) || !checkShaderErrors(fragmentShader)) {
-			std::cerr << "Shader(s) failed to compile!" << std::endl;
-			std::cout << "Press enter to close."; getchar();
-			return EXIT_FAILURE;
-		}
-
+	GLuint shadowProgram = programs.load("shadow", "shadow.vert", "shadow.frag");
+	if (!shadowProgram) {
+		std::cerr << "Shadow program failed to link!" << std::endl;
+		return EXIT_FAILURE;
 	}
+	programs.printTimings(std::cerr);
+	// uniform locations looked up once, the per draw parameters go through one ring shared by both programs,
+	// as the shader storage array the vertex shaders index by instance
+	std::unique_ptr<UniformRing> drawRing(new UniformRing(GL_SHADER_STORAGE_BUFFER, DrawParameters::BINDING, sizeof(DrawParameters)));
+	std::cerr << "Draw parameters: " << (drawRing->persistent() ? "persistently mapped ring" : "ring written with glBufferSubData") << std::endl;
+	const DrawUniforms mainUniforms(ProgramReflection(mainProgram), *drawRing);
+	const DrawUniforms shadowUniforms(ProgramReflection(shadowProgram), *drawRing);
+
 	////////////////////////// Load vertices of model
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -1303,28 +1483,13 @@ int main() {
 	//std::vector<EnemyVertex> enemyVertices;
 	std::vector<AniviaVertex> aniviaHeadVertices;
 	
-	loadAnivia(anivia);
-	//loadEnemy(enemy);
-	loadEnemies(enemies);
-	loadTerrain(terrain);
-	for (int i = 0; i < icicles.size(); i++)
-	{
-		loadIcicle(icicles[i]);
-	}
-
-	for (int i = 0; i < flames.size(); i++)
-	{
-		loadFlame(flames[i]);
-	}
-
-	for (int i = 0; i < lifeCrystals.size(); i++)
-	{
-		loadCrystal(lifeCrystals[i]);
+	// Upload the decoded assets as they become ready
+	if (!loader.finish()) {
+		std::cerr << "Failed to load assets!" << std::endl;
+		return EXIT_FAILURE;
 	}
-
-
-	loadBoss(boss);
-	loadIceBerg(iceBerg);
+	loader.printTimings(std::cerr);
+	std::cerr << Model::textures.size() << " textures and " << meshRegistry.size() << " meshes shared by all models" << std::endl;
 
 	//////////////////// Create Vertex Buffer Object
 	GLuint vbo;
@@ -1394,8 +1559,13 @@ int main() {
 	StateType lastState = IDLE;
 	double lastShot = glfwGetTime();
 
+	std::cerr << "Startup took " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count() << " ms" << std::endl;
+
 	// Main loop
 	while (!glfwWindowShouldClose(window)) {
+		// Upload background assets that finished since the last frame
+		loader.poll();
+
 		double timeInterval = glfwGetTime() - lastFrameTime;
 		
 		if (timeInterval < 1.0 / maxFrameRate)
@@ -1447,11 +1617,11 @@ int main() {
 			icicle.update(mainCamera, anivia.position, mouse.screenCoor, timeInterval);
 			if (icicle.state == SHOT)
 			{				
-				icicle.detectCollision(boss);
+				icicle.detectCollision(boss, mainCamera);
 				for (int j = 0; j < enemies.size(); j++)
 				{
 					Enemy &enemy = enemies[j];
-					icicle.detectCollision(enemy);
+					icicle.detectCollision(enemy, mainCamera);
 				}
 			}
 		}
@@ -1484,7 +1654,7 @@ int main() {
 			}
 			else if (flame.state == SHOT)
 			{
-				bool damaged = flame.detectCollision(anivia);
+				bool damaged = flame.detectCollision(anivia, mainCamera);
 				if (damaged)
 				{
 					if (lifeCrystals.size() == 0)
@@ -1498,6 +1668,22 @@ int main() {
 		}
 		glfwPollEvents();
 
+		// levels of detail from the size on screen under the main camera, the shadow pass uses the next coarser ones
+		anivia.selectLod(mainCamera, HEIGHT);
+		for (int i = 0; i < enemies.size(); i++)
+			enemies[i].selectLod(mainCamera, HEIGHT);
+		{
+			// placed like the textured boss draw below
+			float scaleFactor = boss.scaleFactor;
+			boss.scaleFactor = boss.texturedScale;
+			boss.position += boss.texturedOffset;
+			boss.texturedLevel = boss.texturedLods.select(boss.projectedSize(boss.texturedLods, mainCamera, HEIGHT), boss.texturedLevel);
+			boss.scaleFactor = scaleFactor;
+			boss.position -= boss.texturedOffset;
+		}
+
+		drawRing->beginFrame();
+
 		////////// Stub code for you to fill in order to render the shadow map
 		{
 			// Bind the off-screen framebuffer
@@ -1519,59 +1705,33 @@ int main() {
 
 
 			// .... HERE YOU MUST ADD THE CORRECT UNIFORMS FOR RENDERING THE SHADOW MAP
-			glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(lightSource.voMatrix()));
+			shadowUniforms.mvp.set(glm::value_ptr(lightSource.voMatrix()));
 			// Bind vertex data
 
 
 			glBindVertexArray(anivia.vao);
-			anivia.passUniform(shadowProgram);
-			glDrawArrays(GL_TRIANGLES, 0, anivia.vertices.size());
+			anivia.passUniform(shadowUniforms);
+			anivia.drawLod(anivia.lodLevel + 1);
 
 
-			for (int i = 0; i < enemies.size(); i++)
-			{
-				Enemy &enemy = enemies[i];
-				glBindVertexArray(enemy.vao);
-				enemy.passUniform(shadowProgram);
-				glDrawArrays(GL_TRIANGLES, 0, enemy.vertices.size());
-			}
+			drawEnemies(enemies, shadowUniforms, 1);
 
-			for (int j = 0; j < icicles.size(); j++)
-			{
-				Shape & icicle = icicles[j];
-				glBindVertexArray(icicle.vao);
-				icicle.passUniform(shadowProgram);
-				glDrawArrays(GL_TRIANGLES, 0, icicle.vertices.size());
-			}
+			drawShapes(icicles, shadowUniforms);
 
 
 			float scaleFactor = boss.scaleFactor;
-			boss.scaleFactor = 0.22;
+			boss.scaleFactor = boss.texturedScale;
 
-			boss.position.z -= 0.1;
-			boss.position.y -= 0.5;
+			boss.position += boss.texturedOffset;
 			glBindVertexArray(boss.vao_tex);
-			boss.passUniform(shadowProgram, false, false, false, true);
-			glDrawArrays(GL_TRIANGLES, 0, boss.texturedVertices.size());
+			boss.passUniform(shadowUniforms, false, false, false, true);
+			boss.texturedLods.draw(boss.texturedLevel + 1);
 
-			boss.position.z += 0.1;
-			boss.position.y += 0.5;
+			boss.position -= boss.texturedOffset;
 			boss.scaleFactor = scaleFactor;
 
 
-			for (int j = 0; j < flames.size(); j++)
-			{
-				Shape & flame = flames[j];
-				{
-					glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-					glBufferSubData(GL_ARRAY_BUFFER, 0, flame.vertices.size() * sizeof(VertexBasic), flame.vertices.data());
-					//glBindVertexArray(terrain.vao);
-				}
-				glBindVertexArray(flame.vao);
-				flame.passUniform(shadowProgram);
-				glDrawArrays(GL_TRIANGLES, 0, flame.vertices.size());
-				//std::cerr << flame.state;
-			}
+			drawShapes(flames, shadowUniforms);
 
 
 			// Unbind the off-screen framebuffer
@@ -1597,11 +1757,11 @@ int main() {
 			mvp = lightSource.voMatrix();
 		}
 
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
-		glUniform3fv(glGetUniformLocation(mainProgram, "viewPos"), 1, glm::value_ptr(mainCamera.position));
-		glUniform1f(glGetUniformLocation(mainProgram, "time"), static_cast<float>(glfwGetTime()));
-		glUniformMatrix4fv(glGetUniformLocation(mainProgram, "lightMVP"), 1, GL_FALSE, glm::value_ptr(lightSource.voMatrix()));
-		glUniform3fv(glGetUniformLocation(mainProgram, "lightPos"), 1, glm::value_ptr(lightSource.position));
+		mainUniforms.mvp.set(glm::value_ptr(mvp));
+		mainUniforms.viewPos.set(glm::value_ptr(mainCamera.position));
+		mainUniforms.time.set(static_cast<float>(glfwGetTime()));
+		mainUniforms.lightMVP.set(glm::value_ptr(lightSource.voMatrix()));
+		mainUniforms.lightPos.set(glm::value_ptr(lightSource.position));
 		
 		
 
@@ -1611,7 +1771,7 @@ int main() {
 		GLint texture_unit = 0;
 		glActiveTexture(GL_TEXTURE0 + texture_unit);
 		glBindTexture(GL_TEXTURE_2D, texShadow);
-		glUniform1i(glGetUniformLocation(mainProgram, "texShadow"), texture_unit);
+		mainUniforms.texShadow.set(texture_unit);
 
 		// Set viewport size
 		glViewport(0, 0, WIDTH, HEIGHT);
@@ -1627,26 +1787,26 @@ int main() {
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		
 		glBindVertexArray(anivia.vao);
-		anivia.passUniform(mainProgram);
-		glDrawArrays(GL_TRIANGLES, 0, anivia.vertices.size());
+		anivia.passUniform(mainUniforms);
+		anivia.drawLod(anivia.lodLevel);
 
 
-		for (int i = 0; i < enemies.size(); i++)
-		{
-			Enemy &enemy = enemies[i];
-			glBindVertexArray(enemy.vao);
-			enemy.passUniform(mainProgram);
-			glDrawArrays(GL_TRIANGLES, 0, enemy.vertices.size());
-		}
+		drawEnemies(enemies, mainUniforms, 0);
 		
 
-		//// update boss vertices
+		//// update boss vertices when its level changed
+		if (boss.levelChanged)
 		{
+			boss.levelChanged = false;
 			glBindBuffer(GL_ARRAY_BUFFER, boss.vbo);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, boss.vertices.size() * sizeof(BossVertex), boss.vertices.data());
+			// the element binding belongs to the vertex array, so bind the boss one first
+			glBindVertexArray(boss.vao);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boss.ebo);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, boss.indices.size() * sizeof(unsigned int), boss.indices.data());
 		}
 		/*glBindVertexArray(boss.vao);
-		boss.passUniform(mainProgram, true, true, false);
+		boss.passUniform(mainUniforms, true, true, false);
 		glDrawArrays(GL_TRIANGLES, 0, boss.vertices.size());
 		
 		*/
@@ -1660,30 +1820,28 @@ int main() {
 
 		glBindVertexArray(boss.vao);
 		if (boss.state != IDLE) {
-			boss.passUniform(mainProgram, true, true, false);
+			boss.passUniform(mainUniforms, true, true, false);
 
-			glDrawArrays(GL_TRIANGLES, 0, boss.vertices.size());
+			glDrawElements(GL_TRIANGLES, boss.indices.size(), GL_UNSIGNED_INT, 0);
 		}
-		//boss.passUniform(mainProgram, true, true, false);
+		//boss.passUniform(mainUniforms, true, true, false);
 
 		float scaleFactor = boss.scaleFactor;
-		boss.scaleFactor = 0.22;
-		boss.position.z -= 0.1;
-		boss.position.y -= 0.5;
+		boss.scaleFactor = boss.texturedScale;
+		boss.position += boss.texturedOffset;
 
 		glBindVertexArray(boss.vao_tex);
-		boss.passUniform(mainProgram, false, false, bossHit, true);
-		glDrawArrays(GL_TRIANGLES, 0, boss.texturedVertices.size());
+		boss.passUniform(mainUniforms, false, false, bossHit, true);
+		boss.texturedLods.draw(boss.texturedLevel);
 
 		
 
 		/*glBindVertexArray(boss.vao_tex);
-		boss.passUniform(mainProgram, false, false, false);
+		boss.passUniform(mainUniforms, false, false, false);
 		glDrawArrays(GL_TRIANGLES, 0, boss.texturedVertices.size());*/
 		
 		boss.scaleFactor = scaleFactor;
-		boss.position.z += 0.1;
-		boss.position.y += 0.5;
+		boss.position -= boss.texturedOffset;
 		// update terrain vertices
 		{
 			glBindBuffer(GL_ARRAY_BUFFER, terrain.vbo);
@@ -1692,66 +1850,15 @@ int main() {
 		}
 
 		glBindVertexArray(terrain.vao);
-		terrain.passUniform(mainProgram);
+		terrain.passUniform(mainUniforms);
 		glDrawArrays(GL_TRIANGLES, 0, terrain.vertices.size());
 		
-		// update icicle vertices
-		for (int j = 0; j < icicles.size(); j++)
-		{
-			Shape & icicle = icicles[j];
-			for (int i = 0; i < icicle.vertices.size(); i++)
-			{
-				icicle.vertices[i].texCoor.x -= 0.01;
-				icicle.vertices[i].texCoor.y += 0.01;
-			}
-			{
-				glBindBuffer(GL_ARRAY_BUFFER, icicle.vbo);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, icicle.vertices.size() * sizeof(VertexBasic), icicle.vertices.data());
-				//glBindVertexArray(terrain.vao);
-			}
-			glBindVertexArray(icicle.vao);
-			icicle.passUniform(mainProgram);
-			glDrawArrays(GL_TRIANGLES, 0, icicle.vertices.size());
-		}
-		
-		// update flame vertices
-		for (int j = 0; j < flames.size(); j++)
-		{
-			Shape & flame = flames[j];
-			for (int i = 0; i < flame.vertices.size(); i++)
-			{
-				flame.vertices[i].texCoor.x += 0.01;
-				flame.vertices[i].texCoor.y -= 0.01;
-			}
-			{
-				glBindBuffer(GL_ARRAY_BUFFER, flame.vbo);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, flame.vertices.size() * sizeof(VertexBasic), flame.vertices.data());
-				//glBindVertexArray(terrain.vao);
-			}
-			glBindVertexArray(flame.vao);
-			flame.passUniform(mainProgram);
-			glDrawArrays(GL_TRIANGLES, 0, flame.vertices.size());
-			//std::cerr << flame.state;
-		}
-
-		for (int j = 0; j < lifeCrystals.size(); j++)
-		{
-			Shape & crystal = lifeCrystals[j];
-			//for (int i = 0; i < flame.vertices.size(); i++)
-			//{
-			//	flame.vertices[i].texCoor.x += 0.01;
-			//	flame.vertices[i].texCoor.y -= 0.01;
-			//}
-			{
-				glBindBuffer(GL_ARRAY_BUFFER, crystal.vbo);
-				glBufferSubData(GL_ARRAY_BUFFER, 0, crystal.vertices.size() * sizeof(VertexBasic), crystal.vertices.data());
-				//glBindVertexArray(terrain.vao);
-			}
-			glBindVertexArray(crystal.vao);
-			crystal.passUniform(mainProgram);
-			glDrawArrays(GL_TRIANGLES, 0, crystal.vertices.size());
-			//std::cerr << flame.state;
-		}
+		// scroll the icicle and flame textures, which repeat every unit
+		icicleScroll = glm::fract(icicleScroll + glm::vec2(-0.01f, 0.01f));
+		flameScroll = glm::fract(flameScroll + glm::vec2(0.01f, -0.01f));
+		drawShapes(icicles, mainUniforms, icicleScroll);
+		drawShapes(flames, mainUniforms, flameScroll);
+		drawShapes(lifeCrystals, mainUniforms);
 
 
 		glBindVertexArray(iceBerg.vao);
@@ -1776,8 +1883,10 @@ int main() {
 		default:
 			break;
 		}
-		iceBerg.passUniform(mainProgram, opacity);
-		glDrawArrays(GL_TRIANGLES, 0, iceBerg.vertices.size());
+		iceBerg.passUniform(mainUniforms, opacity);
+		glDrawElements(GL_TRIANGLES, iceBerg.indices.size(), GL_UNSIGNED_INT, 0);
+
+		drawRing->endFrame();
 
 		// Present result to the screen
 		glfwSwapBuffers(window);
@@ -1788,6 +1897,10 @@ int main() {
 
 	glDeleteTextures(1, &texShadow);
 
+	drawRing.reset();
+	meshRegistry.release();
+	Model::textures.release();
+
 	glfwDestroyWindow(window);
 	
 	glfwTerminate();
@@ -0,0 +1,127 @@
+#include "mappedFile.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : ptr(0), length(0)
+#ifdef WIN32
+    , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(0)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char * filename) {
+    close();
+#ifdef WIN32
+    fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mappingHandle) {
+        close();
+        return false;
+    }
+    ptr = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!ptr) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void * p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    //the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    ptr = static_cast<const char *>(p);
+    length = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef WIN32
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+    mappingHandle = 0;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (ptr)
+        munmap(const_cast<char *>(ptr), length);
+#endif
+    ptr = 0;
+    length = 0;
+}
+
+
+bool fileStat(const char * filename, uint64_t & mtime, uint64_t & size) {
+#ifdef WIN32
+    struct _stat64 st;
+    if (_stat64(filename, &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return false;
+#endif
+    mtime = static_cast<uint64_t>(st.st_mtime);
+    size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+uint64_t hashBytes(const void * data, size_t size, uint64_t seed) {
+    const unsigned char * p = static_cast<const unsigned char *>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool hashFile(const char * filename, uint64_t & hash) {
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    hash = hashBytes(file.data(), file.size());
+    return true;
+}
+
+bool fileUnchanged(const char * filename, uint64_t mtime, uint64_t size, uint64_t hash) {
+    uint64_t currentMtime, currentSize;
+    if (!fileStat(filename, currentMtime, currentSize))
+        return false;
+    if (currentSize != size)
+        return false;
+    if (currentMtime == mtime)
+        return true;
+    uint64_t currentHash;
+    return hashFile(filename, currentHash) && currentHash == hash;
+}
@@ -1,4 +1,7 @@
 #include "mesh.h"
+#include "meshKernels.h"
+#include "objParser.h"
+#include "threadPool.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -6,36 +9,58 @@
 #include <stdio.h>
 
 #include <algorithm>
-
-#ifdef WIN32
-#define sscanf sscanf_s
-#endif
+#include <functional>
 
 Mesh::Mesh(){}
 using namespace std;
 
+namespace {
+
+//fixed split of the arrays, so sums and normals do not depend on the number of threads
+const size_t CHUNK = 1 << 15;
+
+inline size_t chunkCount(size_t count) {
+    return (count + CHUNK - 1) / CHUNK;
+}
+
+//body(chunk, begin, end) for every chunk of [0, count), on the pool when one is given
+void forChunks(ThreadPool * pool, size_t count, const function<void(size_t, size_t, size_t)> & body) {
+    size_t chunks = chunkCount(count);
+    auto run = [&](size_t c) { body(c, c * CHUNK, min(count, (c + 1) * CHUNK)); };
+    if (pool)
+        pool->parallelFor(chunks, run);
+    else
+        for (size_t c = 0; c < chunks; c++)
+            run(c);
+}
+
+}
+
 /************************************************************
  * Compute Bounding box
  ************************************************************/
-void Mesh::computeBoundingCube () {
+void Mesh::computeBoundingCube (ThreadPool * pool) {
+    if (vertexCount () <= PARALLEL_VERTICES)
+        pool = 0;
+    vector<float> bounds (6 * chunkCount (vertexCount ()));
+    const float * p = positionData ();
+    forChunks (pool, vertexCount (), [&](size_t c, size_t begin, size_t end) {
+        positionBounds (p + 3 * begin, end - begin, &bounds[6 * c], &bounds[6 * c + 3]);
+    });
+
     Vec3Df minPoint, maxPoint;
-	minPoint=maxPoint=vertices[0].p;
-	
-    for  (unsigned int i = 1; i < vertices.size (); i++)
-    {
-		for (int j=0;j<3;++j)
-		{
-			minPoint[j] = minPoint[j]< (vertices[i].p)[j] ? minPoint[j]:(vertices[i].p)[j];
-			maxPoint[j] = maxPoint[j]> (vertices[i].p)[j] ? maxPoint[j]:(vertices[i].p)[j];
-		}
-	}
-	
-	//set boundind box origin to minimum corner
-	bbOrigin=minPoint;
-
-	//compute extent of the mesh
-	maxPoint-=minPoint;
-	bbEdgeSize=max(max(maxPoint[0],maxPoint[1]),maxPoint[2]);
+    for (size_t c = 0; c < bounds.size (); c += 6)
+        for (int j = 0; j < 3; ++j) {
+            minPoint[j] = c == 0 || bounds[c + j] < minPoint[j] ? bounds[c + j] : minPoint[j];
+            maxPoint[j] = c == 0 || bounds[c + 3 + j] > maxPoint[j] ? bounds[c + 3 + j] : maxPoint[j];
+        }
+
+    //set boundind box origin to minimum corner
+    bbOrigin=minPoint;
+
+    //compute extent of the mesh
+    maxPoint-=minPoint;
+    bbEdgeSize=max(max(maxPoint[0],maxPoint[1]),maxPoint[2]);
 }
 
 
@@ -44,175 +69,86 @@ void Mesh::computeBoundingCube () {
  * Normal calculations
  ************************************************************/
 void Mesh::computeVertexNormals () {
-    //initialisation des normales des vertex
-    for (unsigned int i = 0; i < vertices.size (); i++)
-        vertices[i].n = Vec3Df (0.0, 0.0, 0.0);
-
-    //Sum up neighboring normals
-    for (unsigned int i = 0; i < triangles.size (); i++) {
-        Vec3Df edge01 = vertices[triangles[i].v[1]].p -  vertices[triangles[i].v[0]].p;
-        Vec3Df edge02 = vertices[triangles[i].v[2]].p -  vertices[triangles[i].v[0]].p;
-        Vec3Df n = Vec3Df::crossProduct (edge01, edge02);
-        n.normalize ();
-        for (unsigned int j = 0; j < 3; j++)
-            vertices[triangles[i].v[j]].n += n;
+    //Sum up the unit normals of the neighboring faces (zero for the ones without area)
+    normals.assign (positions.size (), Vec3Df (0.0, 0.0, 0.0));
+    float * n = normals.empty () ? 0 : &normals[0][0];
+    const unsigned int * index = indexData ();
+    //a block of face normals at a time, added to their corners in triangle order
+    float faces[3 * 256];
+    for (size_t begin = 0; begin < triangles.size (); begin += 256) {
+        size_t count = min (triangles.size () - begin, size_t (256));
+        faceNormals (positionData (), index + 3 * begin, count, faces);
+        for (size_t i = 0; i < 3 * count; i++)
+            for (int k = 0; k < 3; k++)
+                n[3 * index[3 * begin + i] + k] += faces[3 * (i / 3) + k];
     }
 
     //Normalize
-    for (unsigned int i = 0; i < vertices.size (); i++)
-        vertices[i].n.normalize ();
+    normalizeVectors (n, positions.size ());
 }
 
 /************************************************************
  * Recenter and adjust the mesh - to ease computations
  ************************************************************/
-void Mesh::centerAndScaleToUnit () {
-    Vec3Df c;
-    for  (unsigned int i = 0; i < vertices.size (); i++)
-        c += vertices[i].p;
-    c /= vertices.size ();
-    float maxD = Vec3Df::distance (vertices[0].p, c);
-    for (unsigned int i = 0; i < vertices.size (); i++){
-        float m = Vec3Df::distance (vertices[i].p, c);
-        if (m > maxD)
-            maxD = m;
-    }
-    for  (unsigned int i = 0; i < vertices.size (); i++)
-        vertices[i].p = (vertices[i].p - c) / maxD;
+void Mesh::centerAndScaleToUnit (ThreadPool * pool) {
+    if (positions.empty ())
+        return;
+    if (vertexCount () <= PARALLEL_VERTICES)
+        pool = 0;
+    size_t chunks = chunkCount (vertexCount ());
+    float * p = &positions[0][0];
+
+    //center, the chunk sums added up in order
+    vector<double> sums (3 * chunks);
+    forChunks (pool, vertexCount (), [&](size_t c, size_t begin, size_t end) {
+        positionSum (p + 3 * begin, end - begin, &sums[3 * c]);
+    });
+    double total[3] = { 0.0, 0.0, 0.0 };
+    for (size_t c = 0; c < chunks; c++)
+        for (int k = 0; k < 3; k++)
+            total[k] += sums[3 * c + k];
+    float center[3];
+    for (int k = 0; k < 3; k++)
+        center[k] = float (total[k] / positions.size ());
+
+    //radius, a single square root
+    vector<float> radii (chunks);
+    forChunks (pool, vertexCount (), [&](size_t c, size_t begin, size_t end) {
+        radii[c] = maxSquaredDistance (p + 3 * begin, end - begin, center);
+    });
+    float maxD = sqrtf (*max_element (radii.begin (), radii.end ()));
+
+    forChunks (pool, vertexCount (), [&](size_t, size_t begin, size_t end) {
+        translateScale (p + 3 * begin, end - begin, center, 1.0f / maxD);
+    });
 }
 
 
 /************************************************************
  * Load
  ************************************************************/
-bool Mesh::loadMesh(const char * filename)
-{ //do NOT try to understand this function... it is dirty...
-
-    std::vector<int> vhandles;
-
-    const unsigned int LINE_LEN=256;
-    char s[LINE_LEN];
-    FILE * in;
-#ifdef WIN32
-    errno_t error=fopen_s(&in, filename,"r");
-    if (error!=0)
-#else
-        in = fopen(filename,"r");
-    if (!(in))
-#endif
+bool Mesh::loadMesh(const char * filename, ThreadPool * pool)
+{
+    ObjData obj;
+    std::string err;
+    if (!loadObj(filename, obj, err, pool)) {
+        printf("Mesh::loadMesh: %s\n", err.c_str());
         return false;
+    }
 
-    float x, y, z;
-
-    while(in && !feof(in) && fgets(s, LINE_LEN, in))
-    {
-        // material file
-        // vertex
-        if (strncmp(s, "v ", 2) == 0)
-        {
-            if (sscanf(s, "v %f %f %f", &x, &y, &z))
-                vertices.push_back(Vertex(Vec3Df(x,y,z)));
-        }
-        // face
-        else if (strncmp(s, "f ", 2) == 0)
-        {
-            int component(0), nV(0);
-            bool endOfVertex(false);
-            char *p0, *p1(s+2); //place behind the "f "
-
-            vhandles.clear();
-
-            while (*p1 == ' ') ++p1; // skip white-spaces
-
-            while (p1)
-            {
-                p0 = p1;
-
-                // overwrite next separator
-
-                // skip '/', '\n', ' ', '\0', '\r' <-- don't forget Windows
-                while (*p1 != '/' && *p1 != '\r' && *p1 != '\n' &&
-                       *p1 != ' ' && *p1 != '\0')
-                    ++p1;
-
-                // detect end of vertex
-                if (*p1 != '/') endOfVertex = true;
-
-                // replace separator by '\0'
-                if (*p1 != '\0')
-                {
-                    *p1 = '\0';
-                    p1++; // point to next token
-                }
-
-                // detect end of line and break
-                if (*p1 == '\0' || *p1 == '\n')
-                    p1 = 0;
-
-
-                // read next vertex component
-                if (*p0 != '\0')
-                {
-                    switch (component)
-                    {
-                    case 0: // vertex
-                        vhandles.push_back(atoi(p0)-1);
-                        break;
-
-                    case 1: // texture coord
-                        //assert(!vhandles.empty());
-                        //assert((unsigned int)(atoi(p0)-1) < texcoords.size());
-                        //_bi.set_texcoord(vhandles.back(), texcoords[atoi(p0)-1]);
-                        break;
-
-                    case 2: // normal
-                        //assert(!vhandles.empty());
-                        //assert((unsigned int)(atoi(p0)-1) < normals.size());
-                        //_bi.set_normal(vhandles.back(), normals[atoi(p0)-1]);
-                        break;
-                    }
-                }
-
-                ++component;
-
-                if (endOfVertex)
-                {
-                    component = 0;
-                    nV++;
-                    endOfVertex = false;
-                }
-            }
-
-
-            if (vhandles.size()>3)
-            {
-                //model is not triangulated, so let us do this on the fly...
-                //to have a more uniform mesh, we add randomization
-                unsigned int k=(false)?(rand()%vhandles.size()):0;
-                for (unsigned int i=0;i<vhandles.size()-2;++i)
-                {
-                    triangles.push_back(Triangle(vhandles[(k+0)%vhandles.size()],vhandles[(k+i+1)%vhandles.size()],vhandles[(k+i+2)%vhandles.size()]));
-                }
-            }
-            else if (vhandles.size()==3)
-            {
-                triangles.push_back(Triangle(vhandles[0],vhandles[1],vhandles[2]));
-            }
-            else
-            {
-                printf("TriMesh::LOAD: Unexpected number of face vertices (<3). Ignoring face");
-            }
-        }
-        memset(&s, 0, LINE_LEN);
+    //the parser's x y z triples are the position array already
+    positions.resize(obj.positions.size() / 3);
+    if (!positions.empty())
+        memcpy(&positions[0][0], obj.positions.data(), positions.size() * sizeof(Vec3Df));
+    normals.clear();
+    triangles.resize(obj.indices.size() / 3);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const ObjIndex * corner = &obj.indices[3 * i];
+        triangles[i] = Triangle(corner[0].vertex, corner[1].vertex, corner[2].vertex);
     }
-    fclose(in);
 
-    centerAndScaleToUnit ();
+    centerAndScaleToUnit (pool);
     computeVertexNormals();
-	computeBoundingCube();
+	computeBoundingCube(pool);
     return true;
 }
-
-#ifdef WIN32
-#undef sscanf 
-#endif
\ No newline at end of file
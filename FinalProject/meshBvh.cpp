@@ -0,0 +1,565 @@
+#include "meshBvh.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+const int BINS = 12;
+//deeper subtrees become one leaf, so a traversal never needs more than MAX_DEPTH + 1 stack entries
+const int MAX_DEPTH = 48;
+
+//a triangle's box over every pose
+struct Item {
+    float low[3];
+    float high[3];
+    unsigned int triangle;
+
+    inline float centroid(int axis) const { return 0.5f * (low[axis] + high[axis]); }
+};
+
+struct Box {
+    float low[3];
+    float high[3];
+
+    inline Box() {
+        for (int k = 0; k < 3; k++) {
+            low[k] = FLT_MAX;
+            high[k] = -FLT_MAX;
+        }
+    }
+    inline void grow(const float * l, const float * h) {
+        for (int k = 0; k < 3; k++) {
+            low[k] = std::min(low[k], l[k]);
+            high[k] = std::max(high[k], h[k]);
+        }
+    }
+    inline float area() const {
+        float d[3] = { high[0] - low[0], high[1] - low[1], high[2] - low[2] };
+        if (d[0] < 0.0f)
+            return 0.0f;
+        return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+};
+
+//nodes of items [begin, end) appended depth first, leaves reorder the items they own
+void buildNode(std::vector<Item> & items, size_t begin, size_t end, size_t leafSize, std::vector<BvhNode> & nodes, int depth)
+{
+    Box centroids;
+    for (size_t i = begin; i < end; i++) {
+        float c[3] = { items[i].centroid(0), items[i].centroid(1), items[i].centroid(2) };
+        centroids.grow(c, c);
+    }
+    size_t index = nodes.size();
+    nodes.push_back(BvhNode());
+
+    size_t count = end - begin;
+    int axis = 0;
+    for (int k = 1; k < 3; k++)
+        if (centroids.high[k] - centroids.low[k] > centroids.high[axis] - centroids.low[axis])
+            axis = k;
+    float extent = centroids.high[axis] - centroids.low[axis];
+    if (count <= leafSize || extent <= 0.0f || depth == MAX_DEPTH) {
+        nodes[index].offset = (unsigned int)begin;
+        nodes[index].count = (unsigned int)count;
+        return;
+    }
+
+    //surface area heuristic over BINS slabs of the centroid range along the longest axis
+    Box binBoxes[BINS];
+    size_t binCounts[BINS] = {};
+    float scale = BINS / extent;
+    for (size_t i = begin; i < end; i++) {
+        int bin = std::min(BINS - 1, int((items[i].centroid(axis) - centroids.low[axis]) * scale));
+        binBoxes[bin].grow(items[i].low, items[i].high);
+        binCounts[bin]++;
+    }
+    float rightCost[BINS];
+    Box right;
+    size_t rightCount = 0;
+    for (int b = BINS - 1; b > 0; b--) {
+        right.grow(binBoxes[b].low, binBoxes[b].high);
+        rightCount += binCounts[b];
+        rightCost[b] = right.area() * rightCount;
+    }
+    Box left;
+    size_t leftCount = 0;
+    int split = 1;
+    float best = FLT_MAX;
+    for (int b = 1; b < BINS; b++) {
+        left.grow(binBoxes[b - 1].low, binBoxes[b - 1].high);
+        leftCount += binCounts[b - 1];
+        float cost = left.area() * leftCount + rightCost[b];
+        if (leftCount > 0 && leftCount < count && cost < best) {
+            best = cost;
+            split = b;
+        }
+    }
+
+    Item * middle = std::partition(&items[begin], &items[0] + end, [&](const Item & item) {
+        return std::min(BINS - 1, int((item.centroid(axis) - centroids.low[axis]) * scale)) < split;
+    });
+    size_t mid = middle - &items[0];
+    if (mid == begin || mid == end)
+        mid = begin + count / 2;
+
+    buildNode(items, begin, mid, leafSize, nodes, depth + 1);
+    nodes[index].offset = (unsigned int)nodes.size();
+    nodes[index].count = 0;
+    buildNode(items, mid, end, leafSize, nodes, depth + 1);
+}
+
+inline void subtract(const float * a, const float * b, float * out)
+{
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+inline void cross(const float * a, const float * b, float * out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline float dot(const float * a, const float * b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//entry distance of the ray into the box when it enters before maxDistance
+inline bool rayBox(const float * box, const float * origin, const float * inverse, float maxDistance, float & entry)
+{
+    float near = 0.0f, far = maxDistance;
+    for (int k = 0; k < 3; k++) {
+        float a = (box[k] - origin[k]) * inverse[k];
+        float b = (box[3 + k] - origin[k]) * inverse[k];
+        if (a > b)
+            std::swap(a, b);
+        //written so a NaN (origin on the slab, direction parallel to it) leaves the range as it is
+        near = a > near ? a : near;
+        far = b < far ? b : far;
+    }
+    entry = near;
+    return near <= far;
+}
+
+inline float boxDistance2(const float * box, const float * p)
+{
+    float d2 = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        float d = std::max(std::max(box[k] - p[k], p[k] - box[3 + k]), 0.0f);
+        d2 += d * d;
+    }
+    return d2;
+}
+
+//Moller-Trumbore, distance in units of direction
+inline bool rayTriangle(const float * origin, const float * direction, const float * a, const float * b, const float * c,
+                        float & distance)
+{
+    float e1[3], e2[3], p[3], s[3], q[3];
+    subtract(b, a, e1);
+    subtract(c, a, e2);
+    cross(direction, e2, p);
+    float det = dot(e1, p);
+    if (det == 0.0f)
+        return false;
+    float inverse = 1.0f / det;
+    subtract(origin, a, s);
+    float u = dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    cross(s, e1, q);
+    float v = dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    distance = dot(e2, q) * inverse;
+    return distance >= 0.0f;
+}
+
+//squared distance from p to the closest point of the triangle (Ericson, Real-Time Collision Detection 5.1.5)
+float triangleDistance2(const float * p, const float * a, const float * b, const float * c)
+{
+    float ab[3], ac[3], ap[3], closest[3];
+    subtract(b, a, ab);
+    subtract(c, a, ac);
+    subtract(p, a, ap);
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        memcpy(closest, a, sizeof(closest));
+    } else {
+        float bp[3], cp[3];
+        subtract(p, b, bp);
+        subtract(p, c, cp);
+        float d3 = dot(ab, bp), d4 = dot(ac, bp);
+        float d5 = dot(ab, cp), d6 = dot(ac, cp);
+        float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if (d3 >= 0.0f && d4 <= d3) {
+            memcpy(closest, b, sizeof(closest));
+        } else if (d6 >= 0.0f && d5 <= d6) {
+            memcpy(closest, c, sizeof(closest));
+        } else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            float t = d1 / (d1 - d3);
+            for (int k = 0; k < 3; k++)
+                closest[k] = a[k] + t * ab[k];
+        } else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            float t = d2 / (d2 - d6);
+            for (int k = 0; k < 3; k++)
+                closest[k] = a[k] + t * ac[k];
+        } else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+            float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            for (int k = 0; k < 3; k++)
+                closest[k] = b[k] + t * (c[k] - b[k]);
+        } else {
+            float denominator = 1.0f / (va + vb + vc);
+            float v = vb * denominator, w = vc * denominator;
+            for (int k = 0; k < 3; k++)
+                closest[k] = a[k] + ab[k] * v + ac[k] * w;
+        }
+    }
+    float d[3];
+    subtract(p, closest, d);
+    return dot(d, d);
+}
+
+//the pyramid from an apex through the convex hull of up to MAX_CORNERS corners, endless past them
+const int MAX_CORNERS = 8;
+const int MAX_PLANES = MAX_CORNERS * (MAX_CORNERS - 1) / 2;
+
+struct Pyramid {
+    float apex[3];
+    //from the apex through each corner
+    float edges[MAX_CORNERS][3];
+    int edgeCount;
+    //normals of the planes through the apex and two corners the pyramid keeps to one side of,
+    //its faces among them, and its span along each
+    float planes[MAX_PLANES][3];
+    float planeLow[MAX_PLANES];
+    float planeHigh[MAX_PLANES];
+    int planeCount;
+    //span along x y z
+    float low[3];
+    float high[3];
+};
+
+//[low, high] of the pyramid along axis, endless towards every side an edge points to; the edges
+//skipped are the ones the axis is perpendicular to by construction, so rounding cannot open it up
+inline void pyramidSpan(const Pyramid & pyramid, const float * axis, int skipA, int skipB, float & low, float & high)
+{
+    low = high = dot(pyramid.apex, axis);
+    for (int i = 0; i < pyramid.edgeCount; i++) {
+        if (i == skipA || i == skipB)
+            continue;
+        float d = dot(pyramid.edges[i], axis);
+        if (d > 0.0f)
+            high = FLT_MAX;
+        else if (d < 0.0f)
+            low = -FLT_MAX;
+    }
+}
+
+void makePyramid(const float * apex, const float * corners, int cornerCount, Pyramid & pyramid)
+{
+    memcpy(pyramid.apex, apex, sizeof(pyramid.apex));
+    pyramid.edgeCount = cornerCount;
+    for (int i = 0; i < cornerCount; i++)
+        subtract(corners + 3 * i, apex, pyramid.edges[i]);
+    pyramid.planeCount = 0;
+    for (int i = 0; i < cornerCount; i++)
+        for (int j = i + 1; j < cornerCount; j++) {
+            float * normal = pyramid.planes[pyramid.planeCount];
+            cross(pyramid.edges[i], pyramid.edges[j], normal);
+            float & low = pyramid.planeLow[pyramid.planeCount];
+            float & high = pyramid.planeHigh[pyramid.planeCount];
+            pyramidSpan(pyramid, normal, i, j, low, high);
+            //a plane cutting through the pyramid separates nothing
+            if (low > -FLT_MAX || high < FLT_MAX)
+                pyramid.planeCount++;
+        }
+    for (int k = 0; k < 3; k++) {
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        axis[k] = 1.0f;
+        pyramidSpan(pyramid, axis, -1, -1, pyramid.low[k], pyramid.high[k]);
+    }
+}
+
+//the box is on the far side of one of the pyramid's planes or outside its span along an axis
+inline bool pyramidMisses(const Pyramid & pyramid, const float * box)
+{
+    for (int k = 0; k < 3; k++)
+        if (box[3 + k] < pyramid.low[k] || box[k] > pyramid.high[k])
+            return true;
+    float center[3], half[3];
+    for (int k = 0; k < 3; k++) {
+        center[k] = 0.5f * (box[k] + box[3 + k]);
+        half[k] = 0.5f * (box[3 + k] - box[k]);
+    }
+    for (int p = 0; p < pyramid.planeCount; p++) {
+        const float * normal = pyramid.planes[p];
+        float middle = dot(center, normal);
+        float extent = half[0] * fabsf(normal[0]) + half[1] * fabsf(normal[1]) + half[2] * fabsf(normal[2]);
+        if (middle + extent < pyramid.planeLow[p] || middle - extent > pyramid.planeHigh[p])
+            return true;
+    }
+    return false;
+}
+
+inline bool separates(const float * axis, const float * a, const float * b, const float * c, float low, float high)
+{
+    float da = dot(a, axis), db = dot(b, axis), dc = dot(c, axis);
+    return std::max(std::max(da, db), dc) < low || std::min(std::min(da, db), dc) > high;
+}
+
+//separating axes of two convex sets: the pyramid's planes, the triangle's normal and every
+//pair of an edge of each
+bool pyramidTriangle(const Pyramid & pyramid, const float * a, const float * b, const float * c)
+{
+    for (int p = 0; p < pyramid.planeCount; p++)
+        if (separates(pyramid.planes[p], a, b, c, pyramid.planeLow[p], pyramid.planeHigh[p]))
+            return false;
+    float sides[3][3], axis[3], low, high;
+    subtract(b, a, sides[0]);
+    subtract(c, b, sides[1]);
+    subtract(a, c, sides[2]);
+    cross(sides[0], sides[1], axis);
+    pyramidSpan(pyramid, axis, -1, -1, low, high);
+    if (separates(axis, a, b, c, low, high))
+        return false;
+    for (int i = 0; i < pyramid.edgeCount; i++)
+        for (int j = 0; j < 3; j++) {
+            cross(pyramid.edges[i], sides[j], axis);
+            pyramidSpan(pyramid, axis, i, -1, low, high);
+            if (separates(axis, a, b, c, low, high))
+                return false;
+        }
+    return true;
+}
+
+const int STACK = MAX_DEPTH + 2;
+
+}
+
+MeshBvh::MeshBvh() : vertices(0), poses(0) {}
+
+void MeshBvh::clear()
+{
+    nodes.clear();
+    poseBounds.clear();
+    triangles.clear();
+    positions.clear();
+    vertices = poses = 0;
+}
+
+void MeshBvh::build(const std::vector<const float *> & posePositions, size_t vertexCount, size_t stride,
+                    const unsigned int * indices, size_t indexCount, size_t leafSize)
+{
+    clear();
+    if (posePositions.empty() || indexCount < 3)
+        return;
+    vertices = vertexCount;
+    poses = posePositions.size();
+    positions.resize(3 * poses * vertices);
+    for (size_t p = 0; p < poses; p++)
+        for (size_t v = 0; v < vertices; v++)
+            memcpy(&positions[3 * (p * vertices + v)], reinterpret_cast<const char *>(posePositions[p]) + v * stride,
+                   3 * sizeof(float));
+
+    std::vector<Item> items(indexCount / 3);
+    for (size_t t = 0; t < items.size(); t++) {
+        Box box;
+        for (size_t p = 0; p < poses; p++)
+            for (int j = 0; j < 3; j++) {
+                const float * corner = &positions[3 * (p * vertices + indices[3 * t + j])];
+                box.grow(corner, corner);
+            }
+        memcpy(items[t].low, box.low, sizeof(box.low));
+        memcpy(items[t].high, box.high, sizeof(box.high));
+        items[t].triangle = (unsigned int)t;
+    }
+
+    nodes.reserve(2 * items.size() / std::max(leafSize, size_t(1)) + 1);
+    buildNode(items, 0, items.size(), std::max(leafSize, size_t(1)), nodes, 0);
+
+    triangles.resize(3 * items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        memcpy(&triangles[3 * i], indices + 3 * items[i].triangle, 3 * sizeof(unsigned int));
+
+    //the box of every node in every pose, children come after their parent
+    poseBounds.resize(6 * poses * nodes.size());
+    for (size_t n = nodes.size(); n-- > 0;) {
+        for (size_t p = 0; p < poses; p++) {
+            Box box;
+            const BvhNode & node = nodes[n];
+            if (node.count) {
+                for (size_t c = 3 * node.offset; c < 3 * (node.offset + node.count); c++) {
+                    const float * corner = &positions[3 * (p * vertices + triangles[c])];
+                    box.grow(corner, corner);
+                }
+            } else {
+                const float * first = &poseBounds[6 * ((n + 1) * poses + p)];
+                const float * second = &poseBounds[6 * (node.offset * poses + p)];
+                box.grow(first, first + 3);
+                box.grow(second, second + 3);
+            }
+            memcpy(&poseBounds[6 * (n * poses + p)], box.low, sizeof(box.low));
+            memcpy(&poseBounds[6 * (n * poses + p) + 3], box.high, sizeof(box.high));
+        }
+    }
+}
+
+const float * MeshBvh::bounds(unsigned int node, const float * weights, float * box) const
+{
+    const float * pose = &poseBounds[6 * node * poses];
+    if (poses == 1)
+        return pose;
+    for (int k = 0; k < 6; k++)
+        box[k] = weights[0] * pose[k];
+    for (size_t p = 1; p < poses; p++) {
+        pose += 6;
+        for (int k = 0; k < 6; k++)
+            box[k] += weights[p] * pose[k];
+    }
+    return box;
+}
+
+void MeshBvh::corners(unsigned int triangle, const float * weights, float * a, float * b, float * c) const
+{
+    float * out[3] = { a, b, c };
+    for (int j = 0; j < 3; j++) {
+        const float * p = &positions[3 * triangles[3 * triangle + j]];
+        for (int k = 0; k < 3; k++)
+            out[j][k] = weights[0] * p[k];
+        for (size_t pose = 1; pose < poses; pose++) {
+            p += 3 * vertices;
+            for (int k = 0; k < 3; k++)
+                out[j][k] += weights[pose] * p[k];
+        }
+    }
+}
+
+bool MeshBvh::raycast(const float * origin, const float * direction, float maxDistance, const float * weights,
+                      float * distance) const
+{
+    if (nodes.empty())
+        return false;
+    float inverse[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    float best = maxDistance;
+    bool hit = false;
+
+    unsigned int stack[STACK];
+    int top = 0;
+    stack[top++] = 0;
+    float box[6], entry;
+    while (top > 0) {
+        unsigned int index = stack[--top];
+        const BvhNode & node = nodes[index];
+        if (!rayBox(bounds(index, weights, box), origin, inverse, best, entry))
+            continue;
+        if (node.count) {
+            for (unsigned int t = node.offset; t < node.offset + node.count; t++) {
+                float a[3], b[3], c[3], d;
+                corners(t, weights, a, b, c);
+                if (rayTriangle(origin, direction, a, b, c, d) && d < best) {
+                    best = d;
+                    hit = true;
+                }
+            }
+            continue;
+        }
+        //nearer child on top, so it tightens best before the other one is tested
+        unsigned int children[2] = { index + 1, node.offset };
+        float entries[2];
+        bool hits[2] = { rayBox(bounds(children[0], weights, box), origin, inverse, best, entries[0]),
+                         rayBox(bounds(children[1], weights, box), origin, inverse, best, entries[1]) };
+        if (hits[0] && hits[1] && entries[1] < entries[0])
+            std::swap(children[0], children[1]);
+        if (hits[1])
+            stack[top++] = children[1];
+        if (hits[0])
+            stack[top++] = children[0];
+    }
+    if (hit && distance)
+        *distance = best;
+    return hit;
+}
+
+bool MeshBvh::segmentHits(const float * from, const float * to, const float * weights) const
+{
+    float direction[3];
+    subtract(to, from, direction);
+    return raycast(from, direction, 1.0f, weights);
+}
+
+bool MeshBvh::sphereHits(const float * center, float radius, const float * weights) const
+{
+    if (nodes.empty())
+        return false;
+    float radius2 = radius * radius;
+    unsigned int stack[STACK];
+    int top = 0;
+    stack[top++] = 0;
+    float box[6];
+    while (top > 0) {
+        unsigned int index = stack[--top];
+        const BvhNode & node = nodes[index];
+        if (boxDistance2(bounds(index, weights, box), center) > radius2)
+            continue;
+        if (node.count) {
+            for (unsigned int t = node.offset; t < node.offset + node.count; t++) {
+                float a[3], b[3], c[3];
+                corners(t, weights, a, b, c);
+                if (triangleDistance2(center, a, b, c) <= radius2)
+                    return true;
+            }
+        } else {
+            stack[top++] = node.offset;
+            stack[top++] = index + 1;
+        }
+    }
+    return false;
+}
+
+bool MeshBvh::pyramidHits(const float * apex, const float * polygon, size_t cornerCount, const float * weights) const
+{
+    if (nodes.empty() || cornerCount == 0)
+        return false;
+    Pyramid pyramid;
+    makePyramid(apex, polygon, cornerCount < MAX_CORNERS ? int(cornerCount) : MAX_CORNERS, pyramid);
+    unsigned int stack[STACK];
+    int top = 0;
+    stack[top++] = 0;
+    float box[6];
+    while (top > 0) {
+        unsigned int index = stack[--top];
+        const BvhNode & node = nodes[index];
+        if (pyramidMisses(pyramid, bounds(index, weights, box)))
+            continue;
+        if (node.count) {
+            for (unsigned int t = node.offset; t < node.offset + node.count; t++) {
+                float a[3], b[3], c[3];
+                corners(t, weights, a, b, c);
+                if (pyramidTriangle(pyramid, a, b, c))
+                    return true;
+            }
+        } else {
+            stack[top++] = node.offset;
+            stack[top++] = index + 1;
+        }
+    }
+    return false;
+}
+
+void MeshBvh::mixWeights(const float * factors, size_t factorCount, float * weights)
+{
+    weights[0] = 1.0f;
+    for (size_t i = 0; i < factorCount; i++) {
+        float f = std::min(std::max(factors[i], 0.0f), 1.0f);
+        for (size_t j = 0; j <= i; j++)
+            weights[j] *= 1.0f - f;
+        weights[i + 1] = f;
+    }
+}
@@ -0,0 +1,190 @@
+#include "meshCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+namespace {
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t sourceCount;
+    uint64_t vertexCount;
+    uint64_t dataOffset;
+    uint64_t indexCount;
+    uint64_t indexOffset;
+    uint64_t buildKey;
+    uint32_t levelCount;
+    uint32_t reserved;
+};
+
+//followed by pathLength characters of the source path
+struct MeshCacheSource {
+    uint64_t mtime;
+    uint64_t size;
+    uint64_t hash;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+//one per level, after the sources
+struct MeshCacheLevelRecord {
+    uint64_t firstVertex;
+    uint64_t vertexCount;
+    uint64_t firstIndex;
+    uint64_t indexCount;
+};
+
+const char MAGIC[4] = { 'F', 'F', 'M', 'C' };
+const size_t DATA_ALIGNMENT = 16;
+
+}
+
+MeshCache::MeshCache() : vertices(0), count(0), indices(0), indexTotal(0) {}
+
+bool MeshCache::open(const char * cacheFile, const std::vector<std::string> & sources, unsigned int vertexStride, uint64_t buildKey)
+{
+    close();
+    if (!file.open(cacheFile))
+        return false;
+
+    const char * p = file.data();
+    const char * end = p + file.size();
+    MeshCacheHeader header;
+    if (file.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    if (memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION ||
+        header.vertexStride != vertexStride || header.sourceCount != sources.size() ||
+        header.buildKey != buildKey || header.levelCount == 0) {
+        close();
+        return false;
+    }
+
+    for (unsigned int i = 0; i < header.sourceCount; i++) {
+        MeshCacheSource source;
+        if (end - p < (ptrdiff_t)sizeof(source)) {
+            close();
+            return false;
+        }
+        memcpy(&source, p, sizeof(source));
+        p += sizeof(source);
+        if (end - p < (ptrdiff_t)source.pathLength ||
+            sources[i].compare(0, std::string::npos, p, source.pathLength) != 0 ||
+            !fileUnchanged(sources[i].c_str(), source.mtime, source.size, source.hash)) {
+            close();
+            return false;
+        }
+        p += source.pathLength;
+    }
+
+    for (unsigned int i = 0; i < header.levelCount; i++) {
+        MeshCacheLevelRecord record;
+        if (end - p < (ptrdiff_t)sizeof(record)) {
+            close();
+            return false;
+        }
+        memcpy(&record, p, sizeof(record));
+        p += sizeof(record);
+        if (record.firstVertex + record.vertexCount > header.vertexCount ||
+            record.firstIndex + record.indexCount > header.indexCount) {
+            close();
+            return false;
+        }
+        MeshCacheLevel level = { static_cast<size_t>(record.firstVertex), static_cast<size_t>(record.vertexCount),
+                                 static_cast<size_t>(record.firstIndex), static_cast<size_t>(record.indexCount) };
+        levels.push_back(level);
+    }
+
+    if (header.dataOffset + header.vertexCount * vertexStride > file.size() ||
+        header.indexOffset % sizeof(unsigned int) != 0 ||
+        header.indexOffset + header.indexCount * sizeof(unsigned int) > file.size()) {
+        close();
+        return false;
+    }
+    vertices = file.data() + header.dataOffset;
+    count = static_cast<size_t>(header.vertexCount);
+    indices = reinterpret_cast<const unsigned int *>(file.data() + header.indexOffset);
+    indexTotal = static_cast<size_t>(header.indexCount);
+    return true;
+}
+
+void MeshCache::close()
+{
+    file.close();
+    vertices = 0;
+    count = 0;
+    indices = 0;
+    indexTotal = 0;
+    levels.clear();
+}
+
+bool MeshCache::write(const char * cacheFile, const std::vector<std::string> & sources,
+                      unsigned int vertexStride, const void * vertexData, size_t vertexCount,
+                      const unsigned int * indexData, size_t indexCount,
+                      const std::vector<MeshCacheLevel> & levels, uint64_t buildKey)
+{
+    std::string blob;
+    MeshCacheHeader header;
+    memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.vertexStride = vertexStride;
+    header.sourceCount = static_cast<uint32_t>(sources.size());
+    header.vertexCount = vertexCount;
+    header.dataOffset = 0;
+    header.indexCount = indexCount;
+    header.indexOffset = 0;
+    header.buildKey = buildKey;
+    header.levelCount = static_cast<uint32_t>(levels.empty() ? 1 : levels.size());
+    header.reserved = 0;
+    blob.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (size_t i = 0; i < sources.size(); i++) {
+        MeshCacheSource source;
+        memset(&source, 0, sizeof(source));
+        if (!fileStat(sources[i].c_str(), source.mtime, source.size) || !hashFile(sources[i].c_str(), source.hash))
+            return false;
+        source.pathLength = static_cast<uint32_t>(sources[i].size());
+        blob.append(reinterpret_cast<const char *>(&source), sizeof(source));
+        blob.append(sources[i]);
+    }
+
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        MeshCacheLevelRecord record = { 0, vertexCount, 0, indexCount };
+        if (!levels.empty()) {
+            record.firstVertex = levels[i].firstVertex;
+            record.vertexCount = levels[i].vertexCount;
+            record.firstIndex = levels[i].firstIndex;
+            record.indexCount = levels[i].indexCount;
+        }
+        blob.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+
+    //the vertex stream starts aligned so the mapping can be handed straight to the driver
+    blob.resize((blob.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT, '\0');
+    header.dataOffset = blob.size();
+    size_t vertexBytes = vertexCount * vertexStride;
+    size_t indexPadding = (DATA_ALIGNMENT - vertexBytes % DATA_ALIGNMENT) % DATA_ALIGNMENT;
+    header.indexOffset = header.dataOffset + vertexBytes + indexPadding;
+    memcpy(&blob[0], &header, sizeof(header));
+
+    //write next to the target and swap, so an interrupted bake never leaves a truncated cache
+    std::string tmpFile = std::string(cacheFile) + ".tmp";
+    {
+        std::ofstream out(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(blob.data(), blob.size());
+        out.write(static_cast<const char *>(vertexData), vertexBytes);
+        out.write(std::string(indexPadding, '\0').data(), indexPadding);
+        out.write(reinterpret_cast<const char *>(indexData), indexCount * sizeof(unsigned int));
+        if (!out)
+            return false;
+    }
+    remove(cacheFile);
+    return rename(tmpFile.c_str(), cacheFile) == 0;
+}
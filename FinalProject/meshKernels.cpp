@@ -0,0 +1,338 @@
+#include "meshKernels.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_KERNELS_SSE 1
+#include <emmintrin.h>
+#endif
+
+/************************************************************
+ * Scalar versions
+ ************************************************************/
+void positionBoundsScalar(const float * xyz, size_t count, float * low, float * high)
+{
+    for (int k = 0; k < 3; k++) {
+        low[k] = count ? xyz[k] : 0.0f;
+        high[k] = low[k];
+    }
+    for (size_t i = 0; i < count; i++, xyz += 3) {
+        for (int k = 0; k < 3; k++) {
+            low[k] = xyz[k] < low[k] ? xyz[k] : low[k];
+            high[k] = xyz[k] > high[k] ? xyz[k] : high[k];
+        }
+    }
+}
+
+void positionSumScalar(const float * xyz, size_t count, double * sum)
+{
+    sum[0] = sum[1] = sum[2] = 0.0;
+    for (size_t i = 0; i < count; i++, xyz += 3) {
+        for (int k = 0; k < 3; k++)
+            sum[k] += xyz[k];
+    }
+}
+
+float maxSquaredDistanceScalar(const float * xyz, size_t count, const float * center)
+{
+    float largest = 0.0f;
+    for (size_t i = 0; i < count; i++, xyz += 3) {
+        float dx = xyz[0] - center[0], dy = xyz[1] - center[1], dz = xyz[2] - center[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        largest = d > largest ? d : largest;
+    }
+    return largest;
+}
+
+void translateScaleScalar(float * xyz, size_t count, const float * center, float scale)
+{
+    for (size_t i = 0; i < count; i++, xyz += 3) {
+        for (int k = 0; k < 3; k++)
+            xyz[k] = (xyz[k] - center[k]) * scale;
+    }
+}
+
+namespace {
+
+inline void faceNormal(const float * xyz, const unsigned int * triangle, float * normal)
+{
+    const float * a = xyz + 3 * triangle[0];
+    const float * b = xyz + 3 * triangle[1];
+    const float * c = xyz + 3 * triangle[2];
+    float e1x = b[0] - a[0], e1y = b[1] - a[1], e1z = b[2] - a[2];
+    float e2x = c[0] - a[0], e2y = c[1] - a[1], e2z = c[2] - a[2];
+    float nx = e1y * e2z - e1z * e2y;
+    float ny = e1z * e2x - e1x * e2z;
+    float nz = e1x * e2y - e1y * e2x;
+    float length = sqrtf(nx * nx + ny * ny + nz * nz);
+    float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    normal[0] = nx * inverse;
+    normal[1] = ny * inverse;
+    normal[2] = nz * inverse;
+}
+
+inline void normalize(float * v)
+{
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    v[0] *= inverse;
+    v[1] *= inverse;
+    v[2] *= inverse;
+}
+
+}
+
+void faceNormalsScalar(const float * xyz, const unsigned int * indices, size_t triangleCount, float * normals)
+{
+    for (size_t t = 0; t < triangleCount; t++)
+        faceNormal(xyz, indices + 3 * t, normals + 3 * t);
+}
+
+void normalizeVectorsScalar(float * xyz, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        normalize(xyz + 3 * i);
+}
+
+/************************************************************
+ * SSE versions, four vertices per step and the scalar code for
+ * the remaining zero to three
+ ************************************************************/
+#ifdef MESH_KERNELS_SSE
+
+namespace {
+
+//x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3  ->  x0 x1 x2 x3 | y0 y1 y2 y3 | z0 z1 z2 z3
+inline void transpose(__m128 a, __m128 b, __m128 c, __m128 & x, __m128 & y, __m128 & z)
+{
+    __m128 xy23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    __m128 yz01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm_shuffle_ps(a, xy23, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(yz01, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+//the inverse lengths of four vectors, 0 for zero vectors, like the scalar code
+inline __m128 inverseLength(__m128 x, __m128 y, __m128 z)
+{
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), length);
+    return _mm_and_ps(inverse, _mm_cmpgt_ps(length, _mm_setzero_ps()));
+}
+
+//one factor per vector -> the x y z x / y z x y / z x y z pattern of the registers
+inline void multiplyInterleaved(float * xyz, __m128 factor)
+{
+    __m128 a = _mm_loadu_ps(xyz), b = _mm_loadu_ps(xyz + 4), c = _mm_loadu_ps(xyz + 8);
+    _mm_storeu_ps(xyz, _mm_mul_ps(a, _mm_shuffle_ps(factor, factor, _MM_SHUFFLE(1, 0, 0, 0))));
+    _mm_storeu_ps(xyz + 4, _mm_mul_ps(b, _mm_shuffle_ps(factor, factor, _MM_SHUFFLE(2, 2, 1, 1))));
+    _mm_storeu_ps(xyz + 8, _mm_mul_ps(c, _mm_shuffle_ps(factor, factor, _MM_SHUFFLE(3, 3, 3, 2))));
+}
+
+//minimum (or maximum) of the x, y and z lanes of three registers in the x y z x pattern
+inline void reduce(const __m128 * r, bool largest, float * out)
+{
+    float lanes[12];
+    for (int i = 0; i < 3; i++)
+        _mm_storeu_ps(lanes + 4 * i, r[i]);
+    //lane i holds coordinate i % 3
+    for (int k = 0; k < 3; k++)
+        out[k] = lanes[k];
+    for (int i = 3; i < 12; i++) {
+        float v = lanes[i];
+        float & o = out[i % 3];
+        o = largest ? (v > o ? v : o) : (v < o ? v : o);
+    }
+}
+
+}
+
+bool meshKernelsUseSimd()
+{
+    return true;
+}
+
+void positionBounds(const float * xyz, size_t count, float * low, float * high)
+{
+    if (count < 4) {
+        positionBoundsScalar(xyz, count, low, high);
+        return;
+    }
+    __m128 lowest[3], highest[3];
+    for (int i = 0; i < 3; i++)
+        lowest[i] = highest[i] = _mm_loadu_ps(xyz + 4 * i);
+    size_t blocks = count / 4;
+    for (size_t i = 1; i < blocks; i++) {
+        const float * p = xyz + 12 * i;
+        for (int j = 0; j < 3; j++) {
+            __m128 v = _mm_loadu_ps(p + 4 * j);
+            lowest[j] = _mm_min_ps(lowest[j], v);
+            highest[j] = _mm_max_ps(highest[j], v);
+        }
+    }
+    reduce(lowest, false, low);
+    reduce(highest, true, high);
+    float restLow[3], restHigh[3];
+    size_t rest = count - 4 * blocks;
+    if (rest) {
+        positionBoundsScalar(xyz + 12 * blocks, rest, restLow, restHigh);
+        for (int k = 0; k < 3; k++) {
+            low[k] = restLow[k] < low[k] ? restLow[k] : low[k];
+            high[k] = restHigh[k] > high[k] ? restHigh[k] : high[k];
+        }
+    }
+}
+
+void positionSum(const float * xyz, size_t count, double * sum)
+{
+    //two doubles per register: six accumulators for the twelve lanes of a step
+    __m128d acc[6];
+    for (int i = 0; i < 6; i++)
+        acc[i] = _mm_setzero_pd();
+    size_t blocks = count / 4;
+    for (size_t i = 0; i < blocks; i++) {
+        const float * p = xyz + 12 * i;
+        for (int j = 0; j < 3; j++) {
+            __m128 v = _mm_loadu_ps(p + 4 * j);
+            acc[2 * j] = _mm_add_pd(acc[2 * j], _mm_cvtps_pd(v));
+            acc[2 * j + 1] = _mm_add_pd(acc[2 * j + 1], _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+        }
+    }
+    double lanes[12];
+    for (int i = 0; i < 6; i++)
+        _mm_storeu_pd(lanes + 2 * i, acc[i]);
+    sum[0] = sum[1] = sum[2] = 0.0;
+    for (int i = 0; i < 12; i++)
+        sum[i % 3] += lanes[i];
+    double rest[3];
+    positionSumScalar(xyz + 12 * blocks, count - 4 * blocks, rest);
+    for (int k = 0; k < 3; k++)
+        sum[k] += rest[k];
+}
+
+float maxSquaredDistance(const float * xyz, size_t count, const float * center)
+{
+    __m128 cx = _mm_set1_ps(center[0]), cy = _mm_set1_ps(center[1]), cz = _mm_set1_ps(center[2]);
+    __m128 largest = _mm_setzero_ps();
+    size_t blocks = count / 4;
+    for (size_t i = 0; i < blocks; i++) {
+        const float * p = xyz + 12 * i;
+        __m128 x, y, z;
+        transpose(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), x, y, z);
+        x = _mm_sub_ps(x, cx);
+        y = _mm_sub_ps(y, cy);
+        z = _mm_sub_ps(z, cz);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        largest = _mm_max_ps(largest, d);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, largest);
+    float result = maxSquaredDistanceScalar(xyz + 12 * blocks, count - 4 * blocks, center);
+    for (int i = 0; i < 4; i++)
+        result = lanes[i] > result ? lanes[i] : result;
+    return result;
+}
+
+void translateScale(float * xyz, size_t count, const float * center, float scale)
+{
+    __m128 c[3] = { _mm_setr_ps(center[0], center[1], center[2], center[0]),
+                    _mm_setr_ps(center[1], center[2], center[0], center[1]),
+                    _mm_setr_ps(center[2], center[0], center[1], center[2]) };
+    __m128 s = _mm_set1_ps(scale);
+    size_t blocks = count / 4;
+    for (size_t i = 0; i < blocks; i++) {
+        float * p = xyz + 12 * i;
+        for (int j = 0; j < 3; j++)
+            _mm_storeu_ps(p + 4 * j, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p + 4 * j), c[j]), s));
+    }
+    translateScaleScalar(xyz + 12 * blocks, count - 4 * blocks, center, scale);
+}
+
+void faceNormals(const float * xyz, const unsigned int * indices, size_t triangleCount, float * normals)
+{
+    //the corners are scattered, so they are gathered into x y z registers of four triangles
+    size_t blocks = triangleCount / 4;
+    for (size_t i = 0; i < blocks; i++) {
+        const unsigned int * t = indices + 12 * i;
+        const float * a0 = xyz + 3 * t[0], * b0 = xyz + 3 * t[1], * c0 = xyz + 3 * t[2];
+        const float * a1 = xyz + 3 * t[3], * b1 = xyz + 3 * t[4], * c1 = xyz + 3 * t[5];
+        const float * a2 = xyz + 3 * t[6], * b2 = xyz + 3 * t[7], * c2 = xyz + 3 * t[8];
+        const float * a3 = xyz + 3 * t[9], * b3 = xyz + 3 * t[10], * c3 = xyz + 3 * t[11];
+        __m128 e1[3], e2[3];
+        for (int k = 0; k < 3; k++) {
+            __m128 a = _mm_setr_ps(a0[k], a1[k], a2[k], a3[k]);
+            e1[k] = _mm_sub_ps(_mm_setr_ps(b0[k], b1[k], b2[k], b3[k]), a);
+            e2[k] = _mm_sub_ps(_mm_setr_ps(c0[k], c1[k], c2[k], c3[k]), a);
+        }
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+        __m128 ny = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+        __m128 nz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+        __m128 inverse = inverseLength(nx, ny, nz);
+        nx = _mm_mul_ps(nx, inverse);
+        ny = _mm_mul_ps(ny, inverse);
+        nz = _mm_mul_ps(nz, inverse);
+
+        //back to x y z triples
+        __m128 xy01 = _mm_unpacklo_ps(nx, ny);
+        __m128 xy23 = _mm_unpackhi_ps(nx, ny);
+        __m128 zx = _mm_shuffle_ps(nz, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 yz = _mm_shuffle_ps(xy01, nz, _MM_SHUFFLE(1, 1, 3, 3));
+        __m128 zzxx = _mm_shuffle_ps(nz, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 yyzz = _mm_shuffle_ps(xy23, nz, _MM_SHUFFLE(3, 3, 3, 3));
+        float * out = normals + 12 * i;
+        _mm_storeu_ps(out, _mm_shuffle_ps(xy01, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out + 4, _mm_shuffle_ps(yz, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(out + 8, _mm_shuffle_ps(zzxx, yyzz, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+    faceNormalsScalar(xyz, indices + 12 * blocks, triangleCount - 4 * blocks, normals + 12 * blocks);
+}
+
+void normalizeVectors(float * xyz, size_t count)
+{
+    size_t blocks = count / 4;
+    for (size_t i = 0; i < blocks; i++) {
+        float * p = xyz + 12 * i;
+        __m128 x, y, z;
+        transpose(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), x, y, z);
+        multiplyInterleaved(p, inverseLength(x, y, z));
+    }
+    normalizeVectorsScalar(xyz + 12 * blocks, count - 4 * blocks);
+}
+
+#else
+
+bool meshKernelsUseSimd()
+{
+    return false;
+}
+
+void positionBounds(const float * xyz, size_t count, float * low, float * high)
+{
+    positionBoundsScalar(xyz, count, low, high);
+}
+
+void positionSum(const float * xyz, size_t count, double * sum)
+{
+    positionSumScalar(xyz, count, sum);
+}
+
+float maxSquaredDistance(const float * xyz, size_t count, const float * center)
+{
+    return maxSquaredDistanceScalar(xyz, count, center);
+}
+
+void translateScale(float * xyz, size_t count, const float * center, float scale)
+{
+    translateScaleScalar(xyz, count, center, scale);
+}
+
+void faceNormals(const float * xyz, const unsigned int * indices, size_t triangleCount, float * normals)
+{
+    faceNormalsScalar(xyz, indices, triangleCount, normals);
+}
+
+void normalizeVectors(float * xyz, size_t count)
+{
+    normalizeVectorsScalar(xyz, count);
+}
+
+#endif
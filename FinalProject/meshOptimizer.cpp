@@ -0,0 +1,286 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+//Forsyth's scoring: a vertex scores higher the more recently it entered the cache and the
+//fewer triangles it still has to be drawn with, so triangles finishing a fan come first
+const int SCORE_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, unsigned int remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+            score = std::pow(1.0f - (cachePosition - 3) * (1.0f / (SCORE_CACHE_SIZE - 3)), CACHE_DECAY_POWER);
+    }
+    return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+}
+
+//stamps[v] is the time v entered the FIFO cache, returns how many of a b c missed
+unsigned int touchCache(unsigned int a, unsigned int b, unsigned int c, unsigned int cacheSize,
+                        std::vector<unsigned int> & stamps, unsigned int & time)
+{
+    unsigned int corners[3] = { a, b, c };
+    unsigned int misses = 0;
+    for (int k = 0; k < 3; k++) {
+        if (time - stamps[corners[k]] > cacheSize) {
+            stamps[corners[k]] = ++time;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+}
+
+float averageCacheMissRatio(const unsigned int * indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+    if (indexCount < 3)
+        return 0.0f;
+    //stamps start far enough in the past to miss
+    unsigned int time = cacheSize + 1;
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+        misses += touchCache(indices[i], indices[i + 1], indices[i + 2], cacheSize, stamps, time);
+    return static_cast<float>(misses / double(indexCount / 3));
+}
+
+void optimizeVertexCache(unsigned int * indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    //triangles of every vertex, CSR: vertexTriangles[firstTriangle[v] .. + remaining[v]) are
+    //the ones not drawn yet
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        vertexTriangles[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+    std::vector<char> drawn(triangleCount, 0);
+
+    std::vector<unsigned int> output(triangleCount * 3);
+    //three slots past the cache size for the vertices the new triangle pushes out
+    std::vector<unsigned int> cache, next;
+    cache.reserve(SCORE_CACHE_SIZE + 3);
+    next.reserve(SCORE_CACHE_SIZE + 3);
+
+    long long best = -1;
+    //triangles before the cursor are all drawn, the fallback search starts there
+    size_t cursor = 0;
+    for (size_t out = 0; out < triangleCount; out++) {
+        if (best < 0) {
+            //dead end, nothing in the cache has triangles left: go on with the next one in input
+            //order, searching the whole mesh for the best score would make this quadratic
+            while (drawn[cursor])
+                cursor++;
+            best = static_cast<long long>(cursor);
+        }
+
+        const unsigned int * triangle = indices + 3 * best;
+        drawn[best] = 1;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            output[3 * out + k] = v;
+            //drop the triangle from the list of v
+            unsigned int * list = vertexTriangles.data() + firstTriangle[v];
+            unsigned int * end = list + remaining[v];
+            *std::find(list, end, static_cast<unsigned int>(best)) = *(end - 1);
+            remaining[v]--;
+        }
+
+        //the triangle's vertices go to the front, the rest shift back
+        next.assign(triangle, triangle + 3);
+        for (unsigned int v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                next.push_back(v);
+        }
+        cache.swap(next);
+
+        //rescore the cache, then look for the best triangle among the ones touching it
+        for (size_t i = 0; i < cache.size(); i++) {
+            unsigned int v = cache[i];
+            int position = i < SCORE_CACHE_SIZE ? static_cast<int>(i) : -1;
+            float change = vertexScore(position, remaining[v]) - score[v];
+            score[v] += change;
+            for (unsigned int j = firstTriangle[v]; j < firstTriangle[v] + remaining[v]; j++)
+                triangleScore[vertexTriangles[j]] += change;
+        }
+        if (cache.size() > SCORE_CACHE_SIZE)
+            cache.resize(SCORE_CACHE_SIZE);
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            for (unsigned int j = firstTriangle[v]; j < firstTriangle[v] + remaining[v]; j++) {
+                unsigned int t = vertexTriangles[j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int * indices, size_t indexCount, const float * positions, size_t vertexCount,
+                      size_t stride, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+    const unsigned int cacheSize = 16;
+
+    //hard patches start where a triangle misses on all three vertices: the cache order
+    //jumped to a new part of the mesh there
+    std::vector<size_t> hard;
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned int misses = touchCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheSize, stamps, time);
+        if (t == 0 || misses == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    //soft patches: cut a hard patch again wherever the triangles since the last cut, drawn
+    //with a cold cache, already miss about as rarely as the whole patch does
+    std::vector<size_t> patches;
+    for (size_t h = 0; h + 1 < hard.size(); h++) {
+        size_t begin = hard[h], end = hard[h + 1];
+        time += cacheSize + 1;
+        size_t patchMisses = 0;
+        for (size_t t = begin; t < end; t++)
+            patchMisses += touchCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheSize, stamps, time);
+        float patchRatio = patchMisses / float(end - begin);
+
+        time += cacheSize + 1;
+        size_t start = begin, misses = 0;
+        patches.push_back(begin);
+        for (size_t t = begin; t < end; t++) {
+            misses += touchCache(indices[3 * t], indices[3 * t + 1], indices[3 * t + 2], cacheSize, stamps, time);
+            if (t + 1 < end && misses <= patchRatio * threshold * (t + 1 - start)) {
+                patches.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+    patches.push_back(triangleCount);
+
+    //area weighted centroid and normal of every patch and of the whole mesh
+    const char * base = reinterpret_cast<const char *>(positions);
+    size_t patchCount = patches.size() - 1;
+    std::vector<float> patchData(patchCount * 6, 0.0f);
+    double meshCenter[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (size_t p = 0; p < patchCount; p++) {
+        float * center = &patchData[6 * p];
+        float * normal = center + 3;
+        float area = 0.0f;
+        for (size_t t = patches[p]; t < patches[p + 1]; t++) {
+            const float * a = reinterpret_cast<const float *>(base + indices[3 * t] * stride);
+            const float * b = reinterpret_cast<const float *>(base + indices[3 * t + 1] * stride);
+            const float * c = reinterpret_cast<const float *>(base + indices[3 * t + 2] * stride);
+            float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+            float twiceArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++) {
+                center[k] += (a[k] + b[k] + c[k]) / 3.0f * twiceArea;
+                normal[k] += n[k];
+            }
+            area += twiceArea;
+        }
+        for (int k = 0; k < 3; k++)
+            meshCenter[k] += center[k];
+        meshArea += area;
+        if (area > 0.0f) {
+            for (int k = 0; k < 3; k++)
+                center[k] /= area;
+        }
+    }
+    if (meshArea > 0.0) {
+        for (int k = 0; k < 3; k++)
+            meshCenter[k] /= meshArea;
+    }
+
+    //how far a patch faces out from the middle of the mesh, from any direction it is seen
+    //the outward ones are the likelier to be in front
+    std::vector<float> facing(patchCount);
+    std::vector<unsigned int> order(patchCount);
+    for (size_t p = 0; p < patchCount; p++) {
+        const float * center = &patchData[6 * p];
+        const float * normal = center + 3;
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float dot = 0.0f;
+        for (int k = 0; k < 3; k++)
+            dot += (center[k] - static_cast<float>(meshCenter[k])) * normal[k];
+        facing[p] = length > 0.0f ? dot / length : 0.0f;
+        order[p] = static_cast<unsigned int>(p);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&facing](unsigned int a, unsigned int b) { return facing[a] > facing[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (unsigned int p : order)
+        output.insert(output.end(), indices + 3 * patches[p], indices + 3 * patches[p + 1]);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t optimizeVertexFetchRemap(unsigned int * indices, size_t indexCount, size_t vertexCount,
+                                std::vector<unsigned int> & remap)
+{
+    const unsigned int unused = ~0u;
+    remap.assign(vertexCount, unused);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        unsigned int & target = remap[indices[i]];
+        if (target == unused)
+            target = next++;
+        indices[i] = target;
+    }
+    size_t used = next;
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == unused)
+            remap[v] = next++;
+    }
+    return used;
+}
+
+std::string cacheReport(const std::string & name, float before, float cached, float after)
+{
+    std::ostringstream out;
+    out << name << ": ACMR " << std::fixed << std::setprecision(3) << before << " -> " << cached
+        << " in cache order, " << after << " in overdraw order" << std::endl;
+    return out.str();
+}
@@ -0,0 +1,328 @@
+#include "meshlets.h"
+#include "mesh.h"
+#include <math.h>
+
+namespace {
+
+const unsigned char NOT_LOCAL = 0xff;
+
+inline const float * positionOf(const char * base, size_t stride, unsigned int v)
+{
+    return reinterpret_cast<const float *>(base + v * stride);
+}
+
+//unit normal of a triangle, false when it has no area
+bool faceNormal(const float * a, const float * b, const float * c, float * n)
+{
+    float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = u[1] * w[2] - u[2] * w[1];
+    n[1] = u[2] * w[0] - u[0] * w[2];
+    n[2] = u[0] * w[1] - u[1] * w[0];
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f)
+        return false;
+    for (int k = 0; k < 3; k++)
+        n[k] /= length;
+    return true;
+}
+
+float distance(const float * a, const float * b)
+{
+    float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+    return sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+//grow the sphere to take in p, the step of Ritter's second pass
+void growSphere(float * center, float & radius, const float * p)
+{
+    float d = distance(p, center);
+    if (d <= radius)
+        return;
+    float grown = (radius + d) * 0.5f;
+    float shift = (grown - radius) / d;
+    for (int k = 0; k < 3; k++)
+        center[k] += (p[k] - center[k]) * shift;
+    radius = grown;
+}
+
+//Ritter's sphere: start from the farthest pair among the axis extremes, then grow to
+//take in every point that is still outside
+void boundingSphere(const char * base, size_t stride, const unsigned int * vertices, size_t count, MeshletBounds & bounds)
+{
+    unsigned int lowest[3], highest[3];
+    for (int k = 0; k < 3; k++)
+        lowest[k] = highest[k] = vertices[0];
+    for (size_t i = 1; i < count; i++) {
+        const float * p = positionOf(base, stride, vertices[i]);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < positionOf(base, stride, lowest[k])[k])
+                lowest[k] = vertices[i];
+            if (p[k] > positionOf(base, stride, highest[k])[k])
+                highest[k] = vertices[i];
+        }
+    }
+    int axis = 0;
+    float widest = -1.0f;
+    for (int k = 0; k < 3; k++) {
+        float d = distance(positionOf(base, stride, lowest[k]), positionOf(base, stride, highest[k]));
+        if (d > widest) {
+            widest = d;
+            axis = k;
+        }
+    }
+    const float * a = positionOf(base, stride, lowest[axis]);
+    const float * b = positionOf(base, stride, highest[axis]);
+    for (int k = 0; k < 3; k++)
+        bounds.center[k] = (a[k] + b[k]) * 0.5f;
+    bounds.radius = widest * 0.5f;
+
+    for (size_t i = 0; i < count; i++)
+        growSphere(bounds.center, bounds.radius, positionOf(base, stride, vertices[i]));
+}
+
+//when no neighbour of a cluster is left that fits, the unused triangle from first on that
+//grows the cluster's sphere least, the growth weighted from 0.5 for triangles facing along the
+//cluster's axis to 2.5 for ones facing against it so its cone stays narrow; ties (most often triangles
+//already inside the sphere) go to the one sharing the most vertices, then the best aligned.
+//Every unused triangle is a candidate, so clusters fill up instead of ending at the first gap
+long long closestTriangle(const char * base, size_t stride, const unsigned int * indices, const std::vector<char> & used,
+                          const std::vector<unsigned char> & local, size_t first, size_t triangleCount, size_t freeVertices,
+                          const float * center, float radius, const float * normals, const float * axis)
+{
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    long long closest = -1;
+    float leastGrowth = 0.0f;
+    int mostShared = -1;
+    float bestDot = -2.0f;
+    for (size_t t = first; t < triangleCount; t++) {
+        if (used[t])
+            continue;
+        size_t added = 0;
+        float growth = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[3 * t + k];
+            added += local[v] == NOT_LOCAL;
+            float outside = distance(positionOf(base, stride, v), center) - radius;
+            if (outside > growth)
+                growth = outside;
+        }
+        if (added > freeVertices)
+            continue;
+        int shared = 3 - static_cast<int>(added);
+        const float * n = normals + 3 * t;
+        float dot = length > 0.0f ? (axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2]) / length : 1.0f;
+        growth *= 1.5f - dot;
+        if (closest < 0 || growth < leastGrowth ||
+            (growth == leastGrowth && (shared > mostShared || (shared == mostShared && dot > bestDot)))) {
+            closest = static_cast<long long>(t);
+            leastGrowth = growth;
+            mostShared = shared;
+            bestDot = dot;
+        }
+    }
+    return closest;
+}
+
+void normalCone(const float * normals, size_t count, MeshletBounds & bounds)
+{
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++)
+            axis[k] += normals[3 * i + k];
+    }
+    float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (length > 0.0f) {
+        for (int k = 0; k < 3; k++)
+            axis[k] /= length;
+    }
+    float smallest = 1.0f;
+    for (size_t i = 0; i < count; i++) {
+        float dot = axis[0] * normals[3 * i] + axis[1] * normals[3 * i + 1] + axis[2] * normals[3 * i + 2];
+        if (dot < smallest)
+            smallest = dot;
+    }
+    for (int k = 0; k < 3; k++)
+        bounds.coneAxis[k] = axis[k];
+    //past about 84 degrees the cone culls next to nothing, 1 turns the test off
+    bounds.coneCutoff = (count == 0 || length == 0.0f || smallest <= 0.1f) ? 1.0f : sqrtf(1.0f - smallest * smallest);
+}
+
+}
+
+void MeshletData::clear()
+{
+    meshlets.clear();
+    bounds.clear();
+    vertices.clear();
+    triangles.clear();
+}
+
+void MeshletData::indexBuffer(std::vector<unsigned int> & indices) const
+{
+    indices.resize(triangles.size());
+    for (size_t m = 0; m < meshlets.size(); m++) {
+        const Meshlet & meshlet = meshlets[m];
+        for (size_t i = 3 * meshlet.triangleOffset; i < 3 * (meshlet.triangleOffset + meshlet.triangleCount); i++)
+            indices[i] = vertices[meshlet.vertexOffset + triangles[i]];
+    }
+}
+
+void buildMeshlets(const float * positions, size_t vertexCount, size_t stride, const unsigned int * indices,
+                   size_t indexCount, MeshletData & out, size_t maxVertices, size_t maxTriangles)
+{
+    out.clear();
+    if (maxVertices > NOT_LOCAL)
+        maxVertices = NOT_LOCAL;
+    if (maxVertices < 3 || maxTriangles == 0)
+        return;
+    const char * base = reinterpret_cast<const char *>(positions);
+    size_t triangleCount = indexCount / 3;
+
+    //triangles of every vertex
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        firstTriangle[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] += firstTriangle[v];
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    std::vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        vertexTriangles[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    std::vector<float> normals(triangleCount * 3);
+    std::vector<char> hasArea(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        hasArea[t] = faceNormal(positionOf(base, stride, indices[3 * t]), positionOf(base, stride, indices[3 * t + 1]),
+                                positionOf(base, stride, indices[3 * t + 2]), &normals[3 * t]);
+    }
+
+    std::vector<char> used(triangleCount, 0);
+    std::vector<unsigned char> local(vertexCount, NOT_LOCAL);
+    //unit normals of the current cluster's triangles with area, for its cone
+    std::vector<float> clusterNormals;
+    size_t seed = 0;
+    for (;;) {
+        while (seed < triangleCount && used[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        Meshlet meshlet;
+        meshlet.vertexOffset = static_cast<unsigned int>(out.vertices.size());
+        meshlet.triangleOffset = static_cast<unsigned int>(out.triangles.size() / 3);
+        meshlet.vertexCount = 0;
+        meshlet.triangleCount = 0;
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float radius = -1.0f;
+        clusterNormals.clear();
+
+        long long next = static_cast<long long>(seed);
+        while (next >= 0) {
+            size_t t = static_cast<size_t>(next);
+            used[t] = 1;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[3 * t + k];
+                if (local[v] == NOT_LOCAL) {
+                    local[v] = static_cast<unsigned char>(meshlet.vertexCount++);
+                    out.vertices.push_back(v);
+                    const float * p = positionOf(base, stride, v);
+                    if (radius < 0.0f) {
+                        for (int j = 0; j < 3; j++)
+                            center[j] = p[j];
+                        radius = 0.0f;
+                    } else {
+                        growSphere(center, radius, p);
+                    }
+                }
+                out.triangles.push_back(local[v]);
+            }
+            meshlet.triangleCount++;
+            if (hasArea[t]) {
+                clusterNormals.insert(clusterNormals.end(), &normals[3 * t], &normals[3 * t] + 3);
+                for (int k = 0; k < 3; k++)
+                    axis[k] += normals[3 * t + k];
+            }
+            if (meshlet.triangleCount == maxTriangles)
+                break;
+
+            //the unused neighbour adding the fewest vertices, then the best aligned one
+            next = -1;
+            int fewest = 4;
+            float bestDot = -2.0f;
+            float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            for (size_t i = meshlet.vertexOffset; i < out.vertices.size(); i++) {
+                unsigned int v = out.vertices[i];
+                for (unsigned int j = firstTriangle[v]; j < firstTriangle[v + 1]; j++) {
+                    unsigned int candidate = vertexTriangles[j];
+                    if (used[candidate])
+                        continue;
+                    int added = 0;
+                    for (int k = 0; k < 3; k++)
+                        added += local[indices[3 * candidate + k]] == NOT_LOCAL;
+                    if (meshlet.vertexCount + added > maxVertices || added > fewest)
+                        continue;
+                    const float * n = &normals[3 * candidate];
+                    float dot = length > 0.0f ? (axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2]) / length : 0.0f;
+                    if (added < fewest || dot > bestDot) {
+                        fewest = added;
+                        bestDot = dot;
+                        next = candidate;
+                    }
+                }
+            }
+            if (next < 0)
+                next = closestTriangle(base, stride, indices, used, local, seed, triangleCount, maxVertices - meshlet.vertexCount,
+                                       center, radius, normals.data(), axis);
+        }
+
+        MeshletBounds bounds;
+        boundingSphere(base, stride, &out.vertices[meshlet.vertexOffset], meshlet.vertexCount, bounds);
+        normalCone(clusterNormals.data(), clusterNormals.size() / 3, bounds);
+        for (size_t i = meshlet.vertexOffset; i < out.vertices.size(); i++)
+            local[out.vertices[i]] = NOT_LOCAL;
+        out.meshlets.push_back(meshlet);
+        out.bounds.push_back(bounds);
+    }
+}
+
+void buildMeshlets(const Mesh & mesh, MeshletData & out, size_t maxVertices, size_t maxTriangles)
+{
+    buildMeshlets(mesh.positionData(), mesh.vertexCount(), sizeof(Vec3Df), mesh.indexData(), 3 * mesh.triangles.size(),
+                  out, maxVertices, maxTriangles);
+}
+
+void frustumPlanes(const float * mvp, float planes[6][4])
+{
+    //row i of the column-major matrix is mvp[i], mvp[4 + i], mvp[8 + i], mvp[12 + i]
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int k = 0; k < 4; k++)
+            planes[p][k] = mvp[4 * k + 3] + sign * mvp[4 * k + row];
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f) {
+            for (int k = 0; k < 4; k++)
+                planes[p][k] /= length;
+        }
+    }
+}
+
+bool frustumCulled(const MeshletBounds & bounds, const float planes[6][4])
+{
+    for (int p = 0; p < 6; p++) {
+        const float * plane = planes[p];
+        if (plane[0] * bounds.center[0] + plane[1] * bounds.center[1] + plane[2] * bounds.center[2] + plane[3] < -bounds.radius)
+            return true;
+    }
+    return false;
+}
+
+bool backfaceCulled(const MeshletBounds & bounds, const float * eye)
+{
+    float view[3] = { bounds.center[0] - eye[0], bounds.center[1] - eye[1], bounds.center[2] - eye[2] };
+    float length = sqrtf(view[0] * view[0] + view[1] * view[1] + view[2] * view[2]);
+    float along = view[0] * bounds.coneAxis[0] + view[1] * bounds.coneAxis[1] + view[2] * bounds.coneAxis[2];
+    return along >= bounds.coneCutoff * length + bounds.radius;
+}
@@ -0,0 +1,396 @@
+#include "objParser.h"
+#include "mappedFile.h"
+#include "threadPool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+//integers up to 2^53 and powers of ten up to 1e22 are exact doubles,
+//so one multiplication or division gives a correctly rounded result
+const uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+const int MAX_EXACT_EXPONENT = 22;
+const int MAX_MANTISSA_DIGITS = 19;
+//smaller files are not worth the hand-off to other threads
+const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+inline const char * skipBlanks(const char * p, const char * end)
+{
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+inline const char * findLineEnd(const char * p, const char * end)
+{
+    const char * eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+//record keyword at the start of a line: "v ", "vt ", "vn " or "f "
+enum Record { OTHER, POSITION, TEXCOORD, NORMAL, FACE };
+
+inline Record recordType(const char * p, const char * eol, const char ** body)
+{
+    if (eol - p >= 2 && p[0] == 'v') {
+        if (isBlank(p[1])) {
+            *body = p + 2;
+            return POSITION;
+        }
+        if (eol - p >= 3 && isBlank(p[2])) {
+            *body = p + 3;
+            if (p[1] == 't')
+                return TEXCOORD;
+            if (p[1] == 'n')
+                return NORMAL;
+        }
+    }
+    else if (eol - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+        *body = p + 2;
+        return FACE;
+    }
+    return OTHER;
+}
+
+//number of each record, only used to reserve the output arrays
+void countRecords(const char * p, const char * end, size_t counts[5])
+{
+    memset(counts, 0, 5 * sizeof(size_t));
+    while (p < end) {
+        const char * eol = findLineEnd(p, end);
+        const char * body;
+        counts[recordType(skipBlanks(p, eol), eol, &body)]++;
+        p = eol + 1;
+    }
+}
+
+//1 based or negative (relative to the records read so far) index into a zero based one
+const char * parseIndex(const char * p, const char * end, size_t count, int & index, bool & relative)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || !isDigit(*p))
+        return 0;
+    long value = 0;
+    while (p < end && isDigit(*p)) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    index = static_cast<int>(negative ? static_cast<long>(count) - value : value - 1);
+    relative = negative;
+    return p;
+}
+
+const char * parseFloats(const char * p, const char * end, int required, int count, std::vector<float> & out)
+{
+    for (int i = 0; i < count; i++) {
+        float value = 0.0f;
+        p = skipBlanks(p, end);
+        const char * next = parseFloat(p, end, value);
+        if (next == p && i < required)
+            return 0;
+        out.push_back(value);
+        p = next;
+    }
+    return p;
+}
+
+//part of the file between two line starts, parsed on its own
+struct Chunk {
+    ObjData obj;
+    //3 * corner + component of every negative index, resolved against the records of this chunk only
+    std::vector<size_t> relativeIndices;
+    size_t lines;
+    size_t errorLine;
+    const char * error;
+};
+
+void parseChunk(const char * data, const char * end, Chunk & chunk)
+{
+    ObjData & obj = chunk.obj;
+    obj.clear();
+    chunk.relativeIndices.clear();
+    chunk.lines = 0;
+    chunk.error = 0;
+
+    size_t counts[5];
+    countRecords(data, end, counts);
+    obj.positions.reserve(3 * counts[POSITION]);
+    obj.texcoords.reserve(2 * counts[TEXCOORD]);
+    obj.normals.reserve(3 * counts[NORMAL]);
+    //exact for triangulated files, polygons grow the array once
+    obj.indices.reserve(3 * counts[FACE]);
+
+    std::vector<ObjIndex> corners;
+    std::vector<unsigned char> cornerRelative;
+    for (const char * line = data; line < end; ) {
+        const char * eol = findLineEnd(line, end);
+        chunk.lines++;
+        const char * p;
+        const char * error = 0;
+
+        switch (recordType(skipBlanks(line, eol), eol, &p)) {
+        case POSITION:
+            if (!parseFloats(p, eol, 3, 3, obj.positions))
+                error = "expected three coordinates";
+            break;
+        case TEXCOORD:
+            if (!parseFloats(p, eol, 1, 2, obj.texcoords))
+                error = "expected texture coordinates";
+            break;
+        case NORMAL:
+            if (!parseFloats(p, eol, 3, 3, obj.normals))
+                error = "expected three normal components";
+            break;
+        case FACE:
+            corners.clear();
+            cornerRelative.clear();
+            for (p = skipBlanks(p, eol); p < eol && *p != '\r' && *p != '#'; p = skipBlanks(p, eol)) {
+                ObjIndex corner = { -1, -1, -1 };
+                bool relative[3] = { false, false, false };
+                p = parseIndex(p, eol, obj.positions.size() / 3, corner.vertex, relative[0]);
+                if (p && p < eol && *p == '/') {
+                    p++;
+                    if (p < eol && *p != '/')
+                        p = parseIndex(p, eol, obj.texcoords.size() / 2, corner.texcoord, relative[1]);
+                    if (p && p < eol && *p == '/')
+                        p = parseIndex(p + 1, eol, obj.normals.size() / 3, corner.normal, relative[2]);
+                }
+                if (!p) {
+                    error = "malformed face index";
+                    break;
+                }
+                corners.push_back(corner);
+                cornerRelative.push_back(relative[0] | relative[1] << 1 | relative[2] << 2);
+            }
+            //fan triangulation, faces with less than three corners are dropped
+            for (size_t i = 2; !error && i < corners.size(); i++) {
+                size_t fan[3] = { 0, i - 1, i };
+                for (int k = 0; k < 3; k++) {
+                    for (int component = 0; component < 3; component++) {
+                        if (cornerRelative[fan[k]] & (1 << component))
+                            chunk.relativeIndices.push_back(3 * obj.indices.size() + component);
+                    }
+                    obj.indices.push_back(corners[fan[k]]);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (error) {
+            chunk.error = error;
+            chunk.errorLine = chunk.lines;
+            return;
+        }
+        line = eol + 1;
+    }
+}
+
+template <class T>
+void copyAt(const std::vector<T> & from, std::vector<T> & to, size_t offset)
+{
+    if (!from.empty())
+        memcpy(&to[offset], from.data(), from.size() * sizeof(T));
+}
+
+bool checkRange(int index, size_t count, bool optional)
+{
+    if (index == -1 && optional)
+        return true;
+    return index >= 0 && static_cast<size_t>(index) < count;
+}
+
+}
+
+void ObjData::clear()
+{
+    positions.clear();
+    texcoords.clear();
+    normals.clear();
+    indices.clear();
+}
+
+const char * parseFloat(const char * p, const char * end, float & value)
+{
+    const char * begin = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    for (; p < end && isDigit(*p); p++) {
+        anyDigit = true;
+        if (digits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa)
+                digits++;
+        }
+        else
+            exponent++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            anyDigit = true;
+            if (digits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa)
+                    digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!anyDigit)
+        return begin;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char * q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++) {
+                if (e < 100000)
+                    e = e * 10 + (*q - '0');
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    if (mantissa == 0)
+        value = negative ? -0.0f : 0.0f;
+    else if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_EXPONENT && exponent <= MAX_EXACT_EXPONENT) {
+        double result = exponent < 0 ? mantissa / POW10[-exponent] : mantissa * POW10[exponent];
+        value = static_cast<float>(negative ? -result : result);
+    }
+    else
+        //too many digits or a huge exponent, rare enough for the library routine
+        value = strtof(std::string(begin, p).c_str(), 0);
+    return p;
+}
+
+bool parseObj(const char * data, size_t size, ObjData & obj, std::string & err, ThreadPool * pool)
+{
+    obj.clear();
+    const char * end = data + size;
+
+    //split at line starts, the calling thread parses a chunk as well
+    size_t chunkCount = 1;
+    if (pool)
+        chunkCount = std::max<size_t>(1, std::min<size_t>(pool->size() + 1, size / MIN_CHUNK_BYTES));
+    std::vector<const char *> bounds(chunkCount + 1, end);
+    bounds[0] = data;
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char * split = std::max(bounds[i - 1], data + size / chunkCount * i);
+        bounds[i] = split < end ? std::min(findLineEnd(split, end) + 1, end) : end;
+    }
+
+    std::vector<Chunk> chunks(chunkCount);
+    if (chunkCount == 1)
+        parseChunk(data, end, chunks[0]);
+    else
+        pool->parallelFor(chunkCount, [&chunks, &bounds](size_t i) { parseChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+    //prefix sums of the record counts give each chunk its place in the merged arrays
+    std::vector<size_t> positionBase(chunkCount + 1, 0), texcoordBase(chunkCount + 1, 0);
+    std::vector<size_t> normalBase(chunkCount + 1, 0), indexBase(chunkCount + 1, 0);
+    size_t lineBase = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const Chunk & chunk = chunks[i];
+        if (chunk.error) {
+            std::ostringstream message;
+            message << "line " << lineBase + chunk.errorLine << ": " << chunk.error;
+            err = message.str();
+            return false;
+        }
+        lineBase += chunk.lines;
+        positionBase[i + 1] = positionBase[i] + chunk.obj.positions.size();
+        texcoordBase[i + 1] = texcoordBase[i] + chunk.obj.texcoords.size();
+        normalBase[i + 1] = normalBase[i] + chunk.obj.normals.size();
+        indexBase[i + 1] = indexBase[i] + chunk.obj.indices.size();
+    }
+
+    if (chunkCount == 1)
+        std::swap(obj, chunks[0].obj);
+    else {
+        obj.positions.resize(positionBase[chunkCount]);
+        obj.texcoords.resize(texcoordBase[chunkCount]);
+        obj.normals.resize(normalBase[chunkCount]);
+        obj.indices.resize(indexBase[chunkCount]);
+        pool->parallelFor(chunkCount, [&](size_t i) {
+            const Chunk & chunk = chunks[i];
+            copyAt(chunk.obj.positions, obj.positions, positionBase[i]);
+            copyAt(chunk.obj.texcoords, obj.texcoords, texcoordBase[i]);
+            copyAt(chunk.obj.normals, obj.normals, normalBase[i]);
+            copyAt(chunk.obj.indices, obj.indices, indexBase[i]);
+            //negative indices counted back from the start of the chunk, shift them past the chunks before it
+            for (size_t k = 0; k < chunk.relativeIndices.size(); k++) {
+                ObjIndex & index = obj.indices[indexBase[i] + chunk.relativeIndices[k] / 3];
+                switch (chunk.relativeIndices[k] % 3) {
+                case 0:
+                    index.vertex += static_cast<int>(positionBase[i] / 3);
+                    break;
+                case 1:
+                    index.texcoord += static_cast<int>(texcoordBase[i] / 2);
+                    break;
+                default:
+                    index.normal += static_cast<int>(normalBase[i] / 3);
+                    break;
+                }
+            }
+        });
+    }
+
+    //forward references are legal, so indices are only checked once everything is read
+    size_t positionCount = obj.positions.size() / 3;
+    size_t texcoordCount = obj.texcoords.size() / 2;
+    size_t normalCount = obj.normals.size() / 3;
+    for (size_t i = 0; i < obj.indices.size(); i++) {
+        const ObjIndex & index = obj.indices[i];
+        if (!checkRange(index.vertex, positionCount, false) || !checkRange(index.texcoord, texcoordCount, true) ||
+            !checkRange(index.normal, normalCount, true)) {
+            std::ostringstream message;
+            message << "face index out of range in triangle " << i / 3;
+            err = message.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadObj(const char * fileName, ObjData & obj, std::string & err, ThreadPool * pool)
+{
+    MappedFile file;
+    if (!file.open(fileName)) {
+        err = std::string("cannot open ") + fileName;
+        return false;
+    }
+    if (!parseObj(file.data(), file.size(), obj, err, pool)) {
+        err = std::string(fileName) + ": " + err;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,238 @@
+#include "programCache.h"
+#include "mappedFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+//followed by binaryLength bytes of glGetProgramBinary output
+struct ProgramCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+};
+
+const char MAGIC[4] = { 'F', 'F', 'P', 'B' };
+
+std::string readSource(const char * path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+
+	return buffer.str();
+}
+
+GLuint compileShader(GLenum type, const std::string & code)
+{
+	const char* codePtr = code.data();
+	GLint length = (GLint)code.size();
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &codePtr, &length);
+	glCompileShader(shader);
+	return shader;
+}
+
+}
+
+bool checkShaderErrors(GLuint shader) {
+	// Check if the shader compiled successfully
+	GLint compileSuccessful;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileSuccessful);
+
+	// If it didn't, then read and print the compile log
+	if (!compileSuccessful) {
+		GLint logLength;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+
+		std::vector<GLchar> logBuffer(logLength);
+		glGetShaderInfoLog(shader, logLength, nullptr, logBuffer.data());
+
+		std::cerr << logBuffer.data() << std::endl;
+
+		return false;
+	} else {
+		return true;
+	}
+}
+
+bool checkProgramErrors(GLuint program) {
+	// Check if the program linked successfully
+	GLint linkSuccessful;
+	glGetProgramiv(program, GL_LINK_STATUS, &linkSuccessful);
+
+	// If it didn't, then read and print the link log
+	if (!linkSuccessful) {
+		GLint logLength;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+
+		std::vector<GLchar> logBuffer(logLength);
+		glGetProgramInfoLog(program, logLength, nullptr, logBuffer.data());
+
+		std::cerr << logBuffer.data() << std::endl;
+
+		return false;
+	} else {
+		return true;
+	}
+}
+
+GLuint ProgramCache::load(const std::string & name, const char * vertexFile, const char * fragmentFile)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::string vertexCode = readSource(vertexFile);
+	std::string fragmentCode = readSource(fragmentFile);
+	std::string driver = driverString();
+	uint64_t key = hashBytes(vertexCode.data(), vertexCode.size());
+	key = hashBytes(fragmentCode.data(), fragmentCode.size(), key);
+	key = hashBytes(driver.data(), driver.size(), key);
+
+	// Drivers without a binary format cannot store programs, they always compile
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	bool binaries = formatCount > 0;
+	std::string cacheFile = name + ".ffprog";
+
+	if (binaries)
+	{
+		std::string blob = readSource(cacheFile.c_str());
+		ProgramCacheHeader header;
+		if (blob.size() >= sizeof(header))
+		{
+			memcpy(&header, blob.data(), sizeof(header));
+			if (memcmp(header.magic, MAGIC, 4) == 0 && header.version == VERSION && header.key == key &&
+				blob.size() == sizeof(header) + header.binaryLength)
+			{
+				GLuint program = glCreateProgram();
+				glProgramBinary(program, header.binaryFormat, blob.data() + sizeof(header), header.binaryLength);
+				GLint linked;
+				glGetProgramiv(program, GL_LINK_STATUS, &linked);
+				if (linked)
+				{
+					Timing timing = { name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), true };
+					timings.push_back(timing);
+					return program;
+				}
+				// e.g. a driver update that kept its version string, rebuild below
+				std::cerr << cacheFile << " was rejected by the driver, compiling " << name << " from source" << std::endl;
+				glDeleteProgram(program);
+			}
+		}
+	}
+
+	GLuint program = compile(vertexCode, fragmentCode, binaries);
+	if (!program)
+		return 0;
+
+	if (binaries)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		std::vector<char> binary(length);
+		GLenum binaryFormat = 0;
+		if (length > 0)
+			glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+		ProgramCacheHeader header;
+		memcpy(header.magic, MAGIC, 4);
+		header.version = VERSION;
+		header.key = key;
+		header.binaryFormat = binaryFormat;
+		header.binaryLength = (uint32_t)length;
+
+		// write next to the target and swap, so an interrupted write never leaves a truncated binary
+		std::string tmpFile = cacheFile + ".tmp";
+		bool written = false;
+		if (length > 0)
+		{
+			std::ofstream out(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			out.write(binary.data(), length);
+			written = out.good();
+		}
+		if (written)
+		{
+			remove(cacheFile.c_str());
+			written = rename(tmpFile.c_str(), cacheFile.c_str()) == 0;
+		}
+		if (!written)
+			std::cerr << "Could not cache the " << name << " program binary" << std::endl;
+	}
+
+	Timing timing = { name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), false };
+	timings.push_back(timing);
+	return program;
+}
+
+GLuint ProgramCache::compile(const std::string & vertexCode, const std::string & fragmentCode, bool retrievable)
+{
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexCode);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
+
+	if (!checkShaderErrors(vertexShader) || !checkShaderErrors(fragmentShader)) {
+		std::cerr << "Shader(s) failed to compile!" << std::endl;
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	// Combine vertex and fragment shaders into single shader program
+	GLuint program = glCreateProgram();
+	if (retrievable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+
+	// The linked program keeps everything it needs
+	glDetachShader(program, vertexShader);
+	glDetachShader(program, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	if (!checkProgramErrors(program)) {
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+std::string ProgramCache::driverString() const
+{
+	// a binary is only valid for the driver build that produced it
+	std::string driver;
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+	for (GLenum name : names)
+	{
+		const GLubyte *value = glGetString(name);
+		if (value)
+			driver += reinterpret_cast<const char *>(value);
+		driver += '\n';
+	}
+	return driver;
+}
+
+void ProgramCache::printTimings(std::ostream & out) const
+{
+	double total = 0.0;
+	out << "Shader programs (ms)" << std::endl << std::fixed << std::setprecision(1);
+	for (size_t i = 0; i < timings.size(); i++)
+	{
+		total += timings[i].milliseconds;
+		out << std::left << std::setw(12) << timings[i].name << std::right << std::setw(8) << timings[i].milliseconds
+			<< (timings[i].restored ? "  program binary (warm)" : "  compiled from source (cold)") << std::endl;
+	}
+	out << std::left << std::setw(12) << "total" << std::right << std::setw(8) << total << std::endl;
+	out.unsetf(std::ios::floatfield);
+}
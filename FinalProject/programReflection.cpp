@@ -0,0 +1,74 @@
+#include "programReflection.h"
+#include <iostream>
+
+ProgramReflection::ProgramReflection(GLuint program) : handle(program)
+{
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<GLchar> name(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+		// uniforms in blocks have no location of their own
+		GLint location = glGetUniformLocation(program, name.data());
+		if (location < 0)
+			continue;
+		// arrays are listed as name[0]
+		std::string key(name.data(), length);
+		if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+			key.resize(key.size() - 3);
+		ActiveUniform uniform = { key, type, location };
+		uniforms.push_back(uniform);
+	}
+}
+
+GLint ProgramReflection::location(const char * name, const GLenum * types, size_t typeCount) const
+{
+	for (const ActiveUniform & uniform : uniforms)
+	{
+		if (uniform.name != name)
+			continue;
+		for (size_t i = 0; i < typeCount; i++)
+			if (uniform.type == types[i])
+				return uniform.location;
+		std::cerr << "Uniform " << name << " of program " << handle << " has another type than its handle" << std::endl;
+		return -1;
+	}
+	return -1;
+}
+
+void FloatUniform::resolve(const ProgramReflection & program, const char * name)
+{
+	const GLenum types[] = { GL_FLOAT };
+	location = program.location(name, types, 1);
+}
+
+void BoolUniform::resolve(const ProgramReflection & program, const char * name)
+{
+	// glUniform1i sets bool and int uniforms alike
+	const GLenum types[] = { GL_BOOL, GL_INT };
+	location = program.location(name, types, 2);
+}
+
+void SamplerUniform::resolve(const ProgramReflection & program, const char * name)
+{
+	const GLenum types[] = { GL_SAMPLER_2D };
+	location = program.location(name, types, 1);
+}
+
+void Vec3Uniform::resolve(const ProgramReflection & program, const char * name)
+{
+	const GLenum types[] = { GL_FLOAT_VEC3 };
+	location = program.location(name, types, 1);
+}
+
+void Mat4Uniform::resolve(const ProgramReflection & program, const char * name)
+{
+	const GLenum types[] = { GL_FLOAT_MAT4 };
+	location = program.location(name, types, 1);
+}
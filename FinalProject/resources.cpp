@@ -0,0 +1,227 @@
+#include "resources.h"
+#include <stb_image.h>
+#include <algorithm>
+#include <iostream>
+
+constexpr float LodChain::PIXEL_ERROR;
+constexpr float LodChain::HYSTERESIS;
+
+int LodChain::select(float pixels, int current) const
+{
+	int last = (int)levels.size() - 1;
+	if (last <= 0)
+		return 0;
+	int level = std::min(std::max(current, 0), last);
+	// finer as soon as the cells of this level would show
+	while (level > 0 && pixels > resolutions[level] * PIXEL_ERROR)
+		level--;
+	// coarser only once clearly small enough for the next level
+	while (level < last && pixels < resolutions[level + 1] * PIXEL_ERROR * (1.0f - HYSTERESIS))
+		level++;
+	return level;
+}
+
+void LodChain::draw(int level, GLsizei instances) const
+{
+	if (levels.empty())
+		return;
+	const LodRange &range = levels[std::min(std::max(level, 0), (int)levels.size() - 1)];
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+		reinterpret_cast<void*>(range.firstIndex * sizeof(unsigned int)), instances, range.baseVertex);
+}
+
+std::shared_ptr<const MeshResource> MeshRegistry::find(const std::string & path) const
+{
+	std::map<std::string, std::shared_ptr<MeshResource> >::const_iterator it = meshes.find(path);
+	if (it == meshes.end())
+		return std::shared_ptr<const MeshResource>();
+	return it->second;
+}
+
+std::shared_ptr<const MeshResource> MeshRegistry::add(const std::string & path, const MeshResource & mesh)
+{
+	std::shared_ptr<MeshResource> & entry = meshes[path];
+	if (!entry)
+		entry = std::make_shared<MeshResource>(mesh);
+	return entry;
+}
+
+void MeshRegistry::release()
+{
+	for (auto it = meshes.begin(); it != meshes.end(); ++it)
+	{
+		glDeleteVertexArrays(1, &it->second->vao);
+		glDeleteBuffers(1, &it->second->vbo);
+		glDeleteBuffers(1, &it->second->ebo);
+	}
+	meshes.clear();
+}
+
+bool decodeTexture(const char * fileName, TextureImage & image)
+{
+	BakedTexture baked;
+	if (loadBakedTexture(bakedTexturePath(fileName).c_str(), fileName, baked))
+	{
+		image.width = baked.levels[0].width;
+		image.height = baked.levels[0].height;
+		image.format = baked.format;
+		image.levels = baked.levels;
+		image.pixels = baked.data;
+		return true;
+	}
+	return decodeImage(fileName, image);
+}
+
+bool decodeImage(const char * fileName, TextureImage & image, int channels)
+{
+	int fileChannels;
+	stbi_uc* pixels = stbi_load(fileName, &image.width, &image.height, &fileChannels, channels);
+	if (!pixels)
+	{
+		std::cerr << "Failed to load texture " << fileName << std::endl;
+		return false;
+	}
+	image.format = TEXTURE_RGB8;
+	image.levels.clear();
+	image.pixels = std::shared_ptr<unsigned char>(pixels, stbi_image_free);
+	return true;
+}
+
+bool uploadTexture(const TextureImage & image, GLuint & texture)
+{
+	if (!image.pixels)
+		return false;
+	bool compressed = image.format != TEXTURE_RGB8;
+	if (compressed && !GLEW_EXT_texture_compression_s3tc)
+		return false;
+
+	// Create Texture
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// Rows of RGB8 levels are tightly packed
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (image.levels.empty())
+	{
+		// Upload pixels into texture and let the driver build the mip chain
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.get());
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else
+	{
+		// Baked mip chain, every level is uploaded as stored
+		GLenum internalFormat = image.format == TEXTURE_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+			image.format == TEXTURE_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_RGB8;
+		glTexStorage2D(GL_TEXTURE_2D, (GLsizei)image.levels.size(), internalFormat, image.width, image.height);
+		for (size_t i = 0; i < image.levels.size(); i++)
+		{
+			const TextureLevel & level = image.levels[i];
+			if (compressed)
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, internalFormat, (GLsizei)level.size, level.data);
+			else
+				glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, GL_RGB, GL_UNSIGNED_BYTE, level.data);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+	// Set behaviour for when texture coordinates are outside the [0, 1] range
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Set interpolation for texture sampling: filtered across mip levels when minified, texels kept sharp when magnified
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	return true;
+}
+
+TextureRegistry::TextureRegistry(int firstTextureNumber) : nextTextureNumber(firstTextureNumber) {}
+
+bool TextureRegistry::decode(const std::string & path, TextureImage & image)
+{
+	std::promise<TextureImage> promise;
+	std::shared_future<TextureImage> pending;
+	bool owner = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (textures.count(path))
+			return true;
+		std::map<std::string, std::shared_future<TextureImage> >::iterator it = decoded.find(path);
+		if (it == decoded.end())
+		{
+			pending = promise.get_future().share();
+			decoded[path] = pending;
+			owner = true;
+		}
+		else
+			pending = it->second;
+	}
+
+	// decode outside the lock so different files decode in parallel
+	if (owner)
+	{
+		TextureImage result;
+		decodeTexture(path.c_str(), result);
+		promise.set_value(result);
+	}
+	image = pending.get();
+	return image.pixels != nullptr;
+}
+
+std::shared_ptr<const TextureResource> TextureRegistry::add(const std::string & path, const TextureImage & image)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<TextureResource> & entry = textures[path];
+	if (!entry)
+	{
+		// a missing image still gets an entry (texture 0) so it is not decoded again
+		entry = std::make_shared<TextureResource>();
+		if (!uploadTexture(image, entry->texture) && image.pixels)
+		{
+			// baked blocks the driver cannot take, decode the source instead
+			TextureImage fallback;
+			if (decodeImage(path.c_str(), fallback))
+				uploadTexture(fallback, entry->texture);
+		}
+		entry->textureNumber = nextTextureNumber++;
+		// the pixels are on the GPU now
+		decoded.erase(path);
+	}
+	return entry;
+}
+
+std::shared_ptr<const TextureResource> TextureRegistry::load(const std::string & path)
+{
+	std::shared_ptr<const TextureResource> texture = find(path);
+	if (texture)
+		return texture;
+	TextureImage image;
+	decode(path, image);
+	return add(path, image);
+}
+
+std::shared_ptr<const TextureResource> TextureRegistry::find(const std::string & path) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<std::string, std::shared_ptr<TextureResource> >::const_iterator it = textures.find(path);
+	if (it == textures.end())
+		return std::shared_ptr<const TextureResource>();
+	return it->second;
+}
+
+void TextureRegistry::release()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = textures.begin(); it != textures.end(); ++it)
+		glDeleteTextures(1, &it->second->texture);
+	textures.clear();
+	decoded.clear();
+}
+
+size_t TextureRegistry::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return textures.size();
+}
@@ -7,11 +7,6 @@ layout(location = 3) uniform float time;
 layout(location = 4) uniform mat4 lightMVP;
 layout(location = 5) uniform vec3 lightPos = vec3(3,3,3);
 layout(location = 9) uniform sampler2D tex;
-layout(location = 14) uniform bool useShadow = false; // use precomputed shadow
-layout(location = 15) uniform bool uniColor = false;
-layout(location = 16) uniform bool onlyWings = false;
-layout(location = 17) uniform bool onlyBody = false;
-layout(location = 18) uniform float opacity = 1.0;
 
 // Output for on-screen color
 layout(location = 0) out vec4 outColor;
@@ -21,8 +16,16 @@ in vec3 fragPos;    // World-space position
 in vec3 fragNormal; // World-space normal
 in vec2 fragTexCoor;
 in vec3 fragShadow;
+// per draw parameters passed on by the vertex shader (DrawParameters in Model.h)
+flat in ivec4 fragFlags;
+flat in float fragOpacity;
 
 void main() {
+	bool useShadow = fragFlags.x != 0; // use precomputed shadow
+	bool uniColor = fragFlags.y != 0;
+	bool onlyWings = fragFlags.z != 0;
+	bool onlyBody = fragFlags.w != 0;
+	float opacity = fragOpacity;
 
 	if(onlyWings == true)
 	{
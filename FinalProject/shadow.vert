@@ -2,15 +2,28 @@
 
 // Model/view/projection matrix
 layout(location = 0) uniform mat4 mvp;
-layout(location = 6) uniform float mixFactor_idle = 0.0;
-layout(location = 7) uniform float mixFactor_attack = 0.0;
-layout(location = 8) uniform float mixFactor_dead = 0.0;
-layout(location = 10) uniform vec3 pos_offset = vec3(0, 0, 0);
-layout(location = 11) uniform vec3 rotateAxis = vec3(0, 1, 0);
-layout(location = 12) uniform float rotateAngle = 0.0;
-layout(location = 13) uniform float scaleFactor = 1.0;
-layout(location = 14) uniform bool useShadow = false;
-layout(location = 15) uniform bool uniColor = false;
+
+// Per draw parameters, one entry per instance in a range of a ring buffer (DrawParameters in Model.h)
+struct DrawParameter
+{
+	vec3 pos_offset;
+	float rotateAngle;
+	vec3 rotateAxis;
+	float scaleFactor;
+	float mixFactor_idle;
+	float mixFactor_attack;
+	float mixFactor_dead;
+	float opacity;
+	vec2 texOffset;
+	int useShadow;
+	int uniColor;
+	int onlyWings;
+	int onlyBody;
+};
+layout(std430, binding = 0) readonly buffer DrawParameters
+{
+	DrawParameter draws[];
+};
 
 // Per-vertex attributes
 layout(location = 0) in vec3 pos; // World-space position
@@ -40,8 +53,16 @@ mat4 rotationMatrix(vec3 axis, float angle)
 }
 
 void main() {
+	DrawParameter draw = draws[gl_InstanceID];
+	vec3 pos_offset = draw.pos_offset;
+	float rotateAngle = draw.rotateAngle;
+	vec3 rotateAxis = draw.rotateAxis;
+	float scaleFactor = draw.scaleFactor;
+	float mixFactor_idle = draw.mixFactor_idle;
+	float mixFactor_attack = draw.mixFactor_attack;
+	float mixFactor_dead = draw.mixFactor_dead;
 
-vec3 pos_current = pos;
+	vec3 pos_current = pos;
 	vec3 normal_current = normal;
 
 	mat4 rMatrix = rotationMatrix(rotateAxis, rotateAngle);
@@ -0,0 +1,398 @@
+#include "textureCache.h"
+#include "mappedFile.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t levelCount;
+    uint64_t sourceMtime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+//followed by the source path, then one record per level
+struct TextureCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+const char MAGIC[4] = { 'F', 'F', 'T', 'X' };
+const size_t DATA_ALIGNMENT = 16;
+
+inline size_t align(size_t offset)
+{
+    return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+}
+
+inline int clampByte(float value)
+{
+    return value <= 0.0f ? 0 : value >= 255.0f ? 255 : static_cast<int>(value + 0.5f);
+}
+
+inline uint16_t packColor(const float * rgb)
+{
+    return static_cast<uint16_t>(((clampByte(rgb[0]) * 31 + 127) / 255) << 11 |
+                                 ((clampByte(rgb[1]) * 63 + 127) / 255) << 5 |
+                                 ((clampByte(rgb[2]) * 31 + 127) / 255));
+}
+
+inline void unpackColor(uint16_t color, int * rgb)
+{
+    int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+//pick the nearest of the four palette colours for each texel, returns the squared error
+int fitColorIndices(const unsigned char * block, uint16_t c0, uint16_t c1, unsigned char * indices)
+{
+    int palette[4][3];
+    unpackColor(c0, palette[0]);
+    unpackColor(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    //equal endpoints select the three colour mode, where index 3 is transparent
+    int choices = c0 == c1 ? 1 : 4;
+
+    int error = 0;
+    for (int i = 0; i < 16; i++) {
+        const unsigned char * texel = block + 4 * i;
+        int best = 0, bestError = 1 << 30;
+        for (int j = 0; j < choices; j++) {
+            int dr = texel[0] - palette[j][0], dg = texel[1] - palette[j][1], db = texel[2] - palette[j][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < bestError) {
+                best = j;
+                bestError = e;
+            }
+        }
+        indices[i] = static_cast<unsigned char>(best);
+        error += bestError;
+    }
+    return error;
+}
+
+//least squares endpoints for a fixed index assignment, false when the indices do not span a line
+bool refineEndpoints(const unsigned char * block, const unsigned char * indices, float * e0, float * e1)
+{
+    static const float WEIGHT[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float a = WEIGHT[indices[i]], b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * block[4 * i + c];
+            bx[c] += b * block[4 * i + c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (det < 1e-6f)
+        return false;
+    for (int c = 0; c < 3; c++) {
+        e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+        e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+void writeColorBlock(uint16_t c0, uint16_t c1, const unsigned char * indices, unsigned char * out)
+{
+    //c0 > c1 selects the four colour mode
+    bool swap = c0 < c1;
+    if (swap)
+        std::swap(c0, c1);
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        //swapped endpoints mirror the palette: 0 <-> 1 and 2 <-> 3
+        uint32_t index = swap ? indices[i] ^ 1u : indices[i];
+        bits |= index << (2 * i);
+    }
+    out[0] = static_cast<unsigned char>(c0);
+    out[1] = static_cast<unsigned char>(c0 >> 8);
+    out[2] = static_cast<unsigned char>(c1);
+    out[3] = static_cast<unsigned char>(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = static_cast<unsigned char>(bits >> (8 * i));
+}
+
+}
+
+std::string bakedTexturePath(const std::string & source)
+{
+    size_t dot = source.find_last_of('.');
+    size_t slash = source.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return source + ".fftex";
+    return source.substr(0, dot) + ".fftex";
+}
+
+int mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        levels++;
+    return levels;
+}
+
+void downsample(const unsigned char * rgba, int width, int height, std::vector<unsigned char> & half)
+{
+    int halfWidth = std::max(1, width / 2), halfHeight = std::max(1, height / 2);
+    half.resize(static_cast<size_t>(halfWidth) * halfHeight * 4);
+    for (int y = 0; y < halfHeight; y++) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < halfWidth; x++) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const unsigned char * t00 = rgba + (static_cast<size_t>(y0) * width + x0) * 4;
+            const unsigned char * t01 = rgba + (static_cast<size_t>(y0) * width + x1) * 4;
+            const unsigned char * t10 = rgba + (static_cast<size_t>(y1) * width + x0) * 4;
+            const unsigned char * t11 = rgba + (static_cast<size_t>(y1) * width + x1) * 4;
+            unsigned char * out = &half[(static_cast<size_t>(y) * halfWidth + x) * 4];
+            for (int c = 0; c < 4; c++)
+                out[c] = static_cast<unsigned char>((t00[c] + t01[c] + t10[c] + t11[c] + 2) / 4);
+        }
+    }
+}
+
+size_t levelSize(TextureFormat format, int width, int height)
+{
+    if (format == TEXTURE_RGB8)
+        return static_cast<size_t>(width) * height * 3;
+    size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == TEXTURE_BC1 ? 8 : 16);
+}
+
+void encodeBC1Block(const unsigned char * block, unsigned char * out)
+{
+    //principal axis of the texel colours by power iteration on their covariance
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[4 * i + c] / 16.0f;
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++) {
+        float r = block[4 * i] - mean[0], g = block[4 * i + 1] - mean[1], b = block[4 * i + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+        };
+        float length = std::max(std::max(fabsf(next[0]), fabsf(next[1])), fabsf(next[2]));
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    //the extreme projections give the endpoints
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (block[4 * i] - mean[0]) * axis[0] + (block[4 * i + 1] - mean[1]) * axis[1] + (block[4 * i + 2] - mean[2]) * axis[2];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float norm = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * maxT / norm;
+        e1[c] = mean[c] + axis[c] * minT / norm;
+    }
+
+    uint16_t c0 = packColor(e0), c1 = packColor(e1);
+    unsigned char indices[16];
+    int error = fitColorIndices(block, c0, c1, indices);
+
+    //one least squares pass over the chosen indices, kept when it lowers the error
+    float r0[3], r1[3];
+    if (error > 0 && refineEndpoints(block, indices, r0, r1)) {
+        uint16_t d0 = packColor(r0), d1 = packColor(r1);
+        unsigned char refined[16];
+        if (fitColorIndices(block, d0, d1, refined) < error) {
+            c0 = d0;
+            c1 = d1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+    writeColorBlock(c0, c1, indices, out);
+}
+
+void encodeBC3Block(const unsigned char * block, unsigned char * out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, static_cast<int>(block[4 * i + 3]));
+        a1 = std::min(a1, static_cast<int>(block[4 * i + 3]));
+    }
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+
+    //a0 > a1 selects the eight level mode: a0, a1 and six steps between them
+    uint64_t bits = 0;
+    if (a0 > a1) {
+        int palette[8] = { a0, a1 };
+        for (int j = 2; j < 8; j++)
+            palette[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int alpha = block[4 * i + 3], best = 0;
+            for (int j = 1; j < 8; j++)
+                if (abs(palette[j] - alpha) < abs(palette[best] - alpha))
+                    best = j;
+            bits |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = static_cast<unsigned char>(bits >> (8 * i));
+    encodeBC1Block(block, out + 8);
+}
+
+void encodeLevel(TextureFormat format, const unsigned char * rgba, int width, int height, unsigned char * out)
+{
+    if (format == TEXTURE_RGB8) {
+        for (size_t i = 0, n = static_cast<size_t>(width) * height; i < n; i++)
+            memcpy(out + 3 * i, rgba + 4 * i, 3);
+        return;
+    }
+
+    size_t blockSize = format == TEXTURE_BC1 ? 8 : 16;
+    unsigned char block[64];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by + y, height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx + x, width - 1);
+                    memcpy(block + 16 * y + 4 * x, rgba + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+                }
+            }
+            if (format == TEXTURE_BC1)
+                encodeBC1Block(block, out);
+            else
+                encodeBC3Block(block, out);
+            out += blockSize;
+        }
+    }
+}
+
+bool loadBakedTexture(const char * bakedFile, const char * source, BakedTexture & texture)
+{
+    std::ifstream in(bakedFile, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    size_t fileSize = static_cast<size_t>(in.tellg());
+    TextureCacheHeader header;
+    if (fileSize < sizeof(header))
+        return false;
+
+    //the whole file in one read, the levels are used in place
+    std::shared_ptr<unsigned char> data(new unsigned char[fileSize], std::default_delete<unsigned char[]>());
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(data.get()), fileSize))
+        return false;
+
+    const unsigned char * p = data.get();
+    const unsigned char * end = p + fileSize;
+    memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    if (memcmp(header.magic, MAGIC, 4) != 0 || header.version != TEXTURE_CACHE_VERSION ||
+        header.format > TEXTURE_BC3 || header.levelCount == 0 ||
+        end - p < (ptrdiff_t)header.pathLength ||
+        strlen(source) != header.pathLength || memcmp(p, source, header.pathLength) != 0 ||
+        !fileUnchanged(source, header.sourceMtime, header.sourceSize, header.sourceHash))
+        return false;
+    p += header.pathLength;
+
+    texture.format = static_cast<TextureFormat>(header.format);
+    texture.levels.clear();
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        TextureCacheLevel record;
+        if (end - p < (ptrdiff_t)sizeof(record))
+            return false;
+        memcpy(&record, p, sizeof(record));
+        p += sizeof(record);
+        if (record.offset + record.size > fileSize ||
+            record.size != levelSize(texture.format, record.width, record.height))
+            return false;
+        TextureLevel level = { static_cast<int>(record.width), static_cast<int>(record.height),
+                               data.get() + record.offset, static_cast<size_t>(record.size) };
+        texture.levels.push_back(level);
+    }
+    texture.data = data;
+    return true;
+}
+
+bool bakeTexture(const char * bakedFile, const char * source, const unsigned char * rgba,
+                 int width, int height, TextureFormat format)
+{
+    TextureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = format;
+    header.levelCount = mipLevelCount(width, height);
+    header.pathLength = static_cast<uint32_t>(strlen(source));
+    if (!fileStat(source, header.sourceMtime, header.sourceSize) || !hashFile(source, header.sourceHash))
+        return false;
+
+    //level table first, then every level at an aligned offset
+    std::vector<TextureCacheLevel> records(header.levelCount);
+    size_t offset = align(sizeof(header) + header.pathLength + records.size() * sizeof(TextureCacheLevel));
+    for (uint32_t i = 0, w = width, h = height; i < header.levelCount; i++) {
+        records[i].width = w;
+        records[i].height = h;
+        records[i].offset = offset;
+        records[i].size = levelSize(format, w, h);
+        offset = align(offset + records[i].size);
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+    }
+
+    std::string blob(offset, '\0');
+    memcpy(&blob[0], &header, sizeof(header));
+    memcpy(&blob[sizeof(header)], source, header.pathLength);
+    memcpy(&blob[sizeof(header) + header.pathLength], records.data(), records.size() * sizeof(TextureCacheLevel));
+
+    std::vector<unsigned char> level(rgba, rgba + static_cast<size_t>(width) * height * 4), half;
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        encodeLevel(format, level.data(), records[i].width, records[i].height,
+                    reinterpret_cast<unsigned char *>(&blob[records[i].offset]));
+        if (i + 1 < header.levelCount) {
+            downsample(level.data(), records[i].width, records[i].height, half);
+            level.swap(half);
+        }
+    }
+
+    //write next to the target and swap, so an interrupted bake never leaves a truncated file
+    std::string tmpFile = std::string(bakedFile) + ".tmp";
+    {
+        std::ofstream out(tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(blob.data(), blob.size());
+        if (!out)
+            return false;
+    }
+    remove(bakedFile);
+    return rename(tmpFile.c_str(), bakedFile) == 0;
+}
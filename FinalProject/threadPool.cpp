@@ -0,0 +1,109 @@
+#include "threadPool.h"
+#include <algorithm>
+#include <memory>
+
+namespace {
+thread_local int currentWorker = -1;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) : busy(0), stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 2;
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.push_back(std::thread(&ThreadPool::work, this, static_cast<int>(i)));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::submit(const std::function<void()> & task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this]() { return tasks.empty() && busy == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> & body)
+{
+    if (count == 0)
+        return;
+
+    struct Progress {
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    progress->next = 0;
+    progress->done = 0;
+
+    //helpers that start after every item was claimed return without touching body
+    const std::function<void(size_t)> * items = &body;
+    std::function<void()> claim = [progress, count, items]() {
+        for (size_t i = progress->next++; i < count; i = progress->next++) {
+            (*items)(i);
+            if (++progress->done == count) {
+                std::lock_guard<std::mutex> lock(progress->mutex);
+                progress->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++)
+        submit(claim);
+    claim();
+
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&progress, count]() { return progress->done == count; });
+}
+
+int ThreadPool::workerIndex()
+{
+    return currentWorker;
+}
+
+void ThreadPool::work(int index)
+{
+    currentWorker = index;
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskReady.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop_front();
+            busy++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+            if (tasks.empty() && busy == 0)
+                allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#include "uniformRing.h"
+#include <algorithm>
+#include <string.h>
+
+UniformRing::UniformRing(GLenum target, GLuint binding, size_t blockSize, size_t blocksPerFrame, bool allowPersistent)
+	: target(target), binding(binding), allowPersistent(allowPersistent), blockSize(blockSize), alignment(1), capacity(0), buffer(0), mapped(0), frame(0), used(0)
+{
+	GLint offsetAlignment = 0;
+	glGetIntegerv(target == GL_SHADER_STORAGE_BUFFER ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	if (offsetAlignment > 1)
+		alignment = size_t(offsetAlignment);
+	for (int i = 0; i < FRAMES; i++)
+		fences[i] = 0;
+	allocate(blockSize * std::max(blocksPerFrame, size_t(1)));
+}
+
+UniformRing::~UniformRing()
+{
+	release();
+}
+
+void UniformRing::allocate(size_t bytesPerFrame)
+{
+	// every part starts aligned, like the ranges in it
+	capacity = (bytesPerFrame + alignment - 1) / alignment * alignment;
+	GLsizeiptr size = GLsizeiptr(capacity * FRAMES);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+	if (allowPersistent && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage))
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, size, 0, flags);
+		mapped = static_cast<char *>(glMapBufferRange(target, 0, size, flags));
+	}
+	if (!mapped)
+		glBufferData(target, size, 0, GL_STREAM_DRAW);
+}
+
+void UniformRing::release()
+{
+	for (int i = 0; i < FRAMES; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (mapped)
+	{
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		mapped = 0;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void UniformRing::beginFrame()
+{
+	frame = (frame + 1) % FRAMES;
+	used = 0;
+	if (!fences[frame])
+		return;
+	// the part was last written FRAMES frames ago, the wait is usually already over
+	GLenum status = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (status == GL_TIMEOUT_EXPIRED)
+		status = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	glDeleteSync(fences[frame]);
+	fences[frame] = 0;
+}
+
+void UniformRing::push(const void * blocks, size_t count)
+{
+	if (count == 0)
+		return;
+	size_t bytes = blockSize * count;
+	size_t offset = (used + alignment - 1) / alignment * alignment;
+	if (offset + bytes > capacity)
+	{
+		// out of room: once the GPU is idle no part is in use, so start over in a bigger buffer
+		glFinish();
+		release();
+		allocate(std::max(2 * capacity, bytes));
+		offset = 0;
+	}
+	used = offset + bytes;
+	offset += size_t(frame) * capacity;
+	if (mapped)
+		memcpy(mapped + offset, blocks, bytes);
+	else
+	{
+		glBindBuffer(target, buffer);
+		glBufferSubData(target, GLintptr(offset), GLsizeiptr(bytes), blocks);
+	}
+	glBindBufferRange(target, binding, buffer, GLintptr(offset), GLsizeiptr(bytes));
+}
+
+void UniformRing::endFrame()
+{
+	if (mapped)
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
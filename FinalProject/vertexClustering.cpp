@@ -0,0 +1,515 @@
+#include "vertexClustering.h"
+#include <math.h>
+#include <algorithm>
+
+namespace {
+
+const int DIGIT_BITS = 11;
+const uint64_t DIGIT_MASK = (1u << DIGIT_BITS) - 1;
+
+inline const float * positionAt(const float * positions, size_t stride, size_t i)
+{
+    return reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + i * stride);
+}
+
+//per cluster a00 a01 a02 a11 a12 a22, b0 b1 b2 of sum(area * (n.x + d)^2) = x'Ax + 2b'x + c
+void accumulateQuadrics(const float * positions, size_t stride, const unsigned int * indices, size_t indexCount,
+                        const unsigned int * clusterOf, size_t clusterCount, std::vector<double> & quadrics)
+{
+    quadrics.assign(clusterCount * 9, 0.0);
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const float * p0 = positionAt(positions, stride, indices[t]);
+        const float * p1 = positionAt(positions, stride, indices[t + 1]);
+        const float * p2 = positionAt(positions, stride, indices[t + 2]);
+        double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+            continue;
+        //unit normal weighted by the triangle area (length / 2)
+        double area = 0.5 * length;
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+        double q[9] = { n[0] * n[0], n[0] * n[1], n[0] * n[2], n[1] * n[1], n[1] * n[2], n[2] * n[2], d * n[0], d * n[1], d * n[2] };
+
+        unsigned int c[3] = { clusterOf[indices[t]], clusterOf[indices[t + 1]], clusterOf[indices[t + 2]] };
+        for (int k = 0; k < 3; k++) {
+            //a triangle adds its plane once to every distinct cluster it touches
+            if ((k > 0 && c[k] == c[0]) || (k > 1 && c[k] == c[1]))
+                continue;
+            double * target = &quadrics[9 * c[k]];
+            for (int j = 0; j < 9; j++)
+                target[j] += area * q[j];
+        }
+    }
+}
+
+//minimizer of a cluster quadric inside the cell [low, low + cellSize]; position holds the
+//mean on entry and is left there when the cluster has no triangle area
+void solveQuadric(const double * q, const double * low, double cellSize, float * position)
+{
+    double trace = q[0] + q[3] + q[5];
+    if (trace <= 0.0)
+        return;
+    //solve (A + lambda I) x = -b + lambda m, a small pull towards the mean m keeps the
+    //system regular and decides the directions no plane constrains
+    double lambda = 1e-3 * trace;
+    double m[3] = { position[0], position[1], position[2] };
+    double a00 = q[0] + lambda, a01 = q[1], a02 = q[2], a11 = q[3] + lambda, a12 = q[4], a22 = q[5] + lambda;
+    double rhs[3] = { -q[6] + lambda * m[0], -q[7] + lambda * m[1], -q[8] + lambda * m[2] };
+    double c00 = a11 * a22 - a12 * a12, c01 = a02 * a12 - a01 * a22, c02 = a01 * a12 - a02 * a11;
+    double c11 = a00 * a22 - a02 * a02, c12 = a01 * a02 - a00 * a12, c22 = a00 * a11 - a01 * a01;
+    double det = a00 * c00 + a01 * c01 + a02 * c02;
+    if (fabs(det) < 1e-300)
+        return;
+    double x[3] = {
+        (c00 * rhs[0] + c01 * rhs[1] + c02 * rhs[2]) / det,
+        (c01 * rhs[0] + c11 * rhs[1] + c12 * rhs[2]) / det,
+        (c02 * rhs[0] + c12 * rhs[1] + c22 * rhs[2]) / det
+    };
+
+    //stay inside the cell, or neighbouring clusters could fold over each other
+    for (int k = 0; k < 3; k++)
+        position[k] = static_cast<float>(std::min(std::max(x[k], low[k]), low[k] + cellSize));
+}
+
+//numbers the distinct keys in ascending order: ids[i] is the rank of keys[i] among cells;
+//an open addressing table sized to the distinct keys finds them, so only those are sorted
+void numberCells(const std::vector<uint64_t> & keys, std::vector<unsigned int> & ids, std::vector<uint64_t> & cells)
+{
+    const unsigned int EMPTY = ~0u;
+    int bits = 10;
+    std::vector<unsigned int> slots(size_t(1) << bits, EMPTY);
+    cells.clear();
+    ids.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint64_t key = keys[i];
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+        while (slots[slot] != EMPTY && cells[slots[slot]] != key)
+            slot = (slot + 1) & mask;
+        if (slots[slot] == EMPTY) {
+            //keep the table at most half full
+            if (2 * (cells.size() + 1) > slots.size()) {
+                bits++;
+                slots.assign(size_t(1) << bits, EMPTY);
+                mask = slots.size() - 1;
+                for (size_t c = 0; c < cells.size(); c++) {
+                    size_t s = static_cast<size_t>((cells[c] * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+                    while (slots[s] != EMPTY)
+                        s = (s + 1) & mask;
+                    slots[s] = static_cast<unsigned int>(c);
+                }
+                slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+                while (slots[slot] != EMPTY)
+                    slot = (slot + 1) & mask;
+            }
+            slots[slot] = static_cast<unsigned int>(cells.size());
+            cells.push_back(key);
+        }
+        ids[i] = slots[slot];
+    }
+
+    //first-appearance ids to ascending cell order
+    std::vector<unsigned int> order(cells.size());
+    for (size_t c = 0; c < order.size(); c++)
+        order[c] = static_cast<unsigned int>(c);
+    radixSortPairs(cells, order);
+    std::vector<unsigned int> rank(cells.size());
+    for (size_t c = 0; c < order.size(); c++)
+        rank[order[c]] = static_cast<unsigned int>(c);
+    for (size_t i = 0; i < ids.size(); i++)
+        ids[i] = rank[ids[i]];
+}
+
+unsigned long long greatestCommonDivisor(unsigned long long a, unsigned long long b)
+{
+    while (b != 0) {
+        unsigned long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+}
+
+void radixSortPairs(std::vector<uint64_t> & keys, std::vector<unsigned int> & values)
+{
+    size_t count = keys.size();
+    uint64_t maxKey = 0;
+    for (size_t i = 0; i < count; i++)
+        maxKey = std::max(maxKey, keys[i]);
+    std::vector<uint64_t> keyScratch(count);
+    std::vector<unsigned int> valueScratch(count);
+    std::vector<size_t> histogram(DIGIT_MASK + 1);
+
+    for (int shift = 0; shift < 64 && (maxKey >> shift) != 0; shift += DIGIT_BITS) {
+        std::fill(histogram.begin(), histogram.end(), 0);
+        for (size_t i = 0; i < count; i++)
+            histogram[(keys[i] >> shift) & DIGIT_MASK]++;
+        //every key has this digit, the order would not change
+        if (count == 0 || histogram[(keys[0] >> shift) & DIGIT_MASK] == count)
+            continue;
+
+        size_t offset = 0;
+        for (size_t d = 0; d <= DIGIT_MASK; d++) {
+            size_t n = histogram[d];
+            histogram[d] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t slot = histogram[(keys[i] >> shift) & DIGIT_MASK]++;
+            keyScratch[slot] = keys[i];
+            valueScratch[slot] = values[i];
+        }
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+VertexClustering::VertexClustering() : cellSize(0.0f), resolution(0)
+{
+    gridOrigin[0] = gridOrigin[1] = gridOrigin[2] = 0.0f;
+}
+
+void VertexClustering::build(const float * positions, size_t count, size_t stride, const float * origin, float size, unsigned int r)
+{
+    //same arithmetic as Grid::isContainedAt, so both agree on every vertex
+    float cubeLength = size / r;
+    int last = static_cast<int>(r) - 1;
+    gridOrigin[0] = origin[0];
+    gridOrigin[1] = origin[1];
+    gridOrigin[2] = origin[2];
+    cellSize = cubeLength;
+    resolution = r;
+    std::vector<uint64_t> keys(count);
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const float * p = positionAt(positions, stride, i);
+        int c[3];
+        for (int k = 0; k < 3; k++)
+            c[k] = std::min(std::max(static_cast<int>((p[k] - origin[k]) / cubeLength), 0), last);
+        keys[i] = cellKey(c[0], c[1], c[2], r);
+        order[i] = static_cast<unsigned int>(i);
+    }
+
+    radixSortPairs(keys, order);
+
+    //one cluster per run of equal keys
+    cells.clear();
+    runStart.clear();
+    clusterOf.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || keys[i] != keys[i - 1]) {
+            cells.push_back(keys[i]);
+            runStart.push_back(static_cast<unsigned int>(i));
+        }
+        clusterOf[order[i]] = static_cast<unsigned int>(cells.size() - 1);
+    }
+    runStart.push_back(static_cast<unsigned int>(count));
+}
+
+long long VertexClustering::findCell(uint64_t cell) const
+{
+    std::vector<uint64_t>::const_iterator it = std::lower_bound(cells.begin(), cells.end(), cell);
+    if (it == cells.end() || *it != cell)
+        return -1;
+    return it - cells.begin();
+}
+
+void VertexClustering::averagePositions(const float * positions, size_t stride, std::vector<float> & out) const
+{
+    out.resize(cells.size() * 3);
+    for (size_t c = 0; c < cells.size(); c++) {
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        for (const unsigned int * v = begin(c); v != end(c); ++v) {
+            const float * p = positionAt(positions, stride, *v);
+            sum[0] += p[0];
+            sum[1] += p[1];
+            sum[2] += p[2];
+        }
+        float n = static_cast<float>(end(c) - begin(c));
+        out[3 * c + 0] = sum[0] / n;
+        out[3 * c + 1] = sum[1] / n;
+        out[3 * c + 2] = sum[2] / n;
+    }
+}
+
+void VertexClustering::quadricPositions(const float * positions, size_t stride, const unsigned int * indices, size_t indexCount,
+                                        std::vector<float> & out) const
+{
+    averagePositions(positions, stride, out);
+    std::vector<double> quadrics;
+    accumulateQuadrics(positions, stride, indices, indexCount, clusterOf.data(), cells.size(), quadrics);
+    for (size_t c = 0; c < cells.size(); c++) {
+        uint64_t key = cells[c];
+        uint64_t cell[3] = { key % resolution, (key / resolution) % resolution, key / resolution / resolution };
+        double low[3];
+        for (int k = 0; k < 3; k++)
+            low[k] = gridOrigin[k] + cell[k] * cellSize;
+        solveQuadric(&quadrics[9 * c], low, cellSize, &out[3 * c]);
+    }
+}
+
+ClusterLevels::ClusterLevels() : gridSize(0.0f), base(0)
+{
+    gridOrigin[0] = gridOrigin[1] = gridOrigin[2] = 0.0f;
+}
+
+void ClusterLevels::build(const float * positions, size_t count, size_t stride, const float * origin, float size,
+                          const std::vector<unsigned int> & resolutions)
+{
+    gridOrigin[0] = origin[0];
+    gridOrigin[1] = origin[1];
+    gridOrigin[2] = origin[2];
+    gridSize = size;
+    levels.assign(resolutions.size(), Level());
+    for (size_t i = 0; i < resolutions.size(); i++)
+        levels[i].r = resolutions[i];
+
+    //3 * 21 bits of cell coordinates still fit the 64-bit keys
+    const unsigned long long maxBase = 1ull << 21;
+    unsigned long long multiple = 1;
+    for (size_t i = 0; i < resolutions.size() && multiple <= maxBase; i++)
+        multiple = multiple / greatestCommonDivisor(multiple, resolutions[i]) * resolutions[i];
+    base = resolutions.empty() || multiple > maxBase ? 0 : static_cast<unsigned int>(multiple);
+
+    //the one traversal of the vertices: their cells on the base grid
+    std::vector<unsigned int> baseCoords;
+    if (base != 0)
+        cellCoordinates(positions, count, stride, base, baseCoords);
+
+    //finest first, each from the built level with the fewest clusters that nests in it
+    std::vector<size_t> byResolution(levels.size());
+    for (size_t i = 0; i < levels.size(); i++)
+        byResolution[i] = i;
+    std::stable_sort(byResolution.begin(), byResolution.end(),
+                     [&](size_t a, size_t b) { return levels[a].r > levels[b].r; });
+    for (size_t i = 0; i < byResolution.size(); i++) {
+        Level & level = levels[byResolution[i]];
+        const Level * finer = nullptr;
+        for (size_t b = 0; b < i; b++) {
+            const Level & built = levels[byResolution[b]];
+            if (built.r % level.r == 0 && (!finer || built.cells.size() < finer->cells.size()))
+                finer = &built;
+        }
+        if (finer) {
+            coarsen(*finer, level);
+        } else if (base != 0) {
+            fromVertices(level, positions, stride, baseCoords, base / level.r);
+        } else {
+            std::vector<unsigned int> coords;
+            cellCoordinates(positions, count, stride, level.r, coords);
+            fromVertices(level, positions, stride, coords, 1);
+        }
+    }
+}
+
+void ClusterLevels::cellCoordinates(const float * positions, size_t count, size_t stride, unsigned int r,
+                                    std::vector<unsigned int> & coords) const
+{
+    //in double, so the cells of a grid r / f are exactly these divided by f
+    double scale = static_cast<double>(r) / gridSize;
+    coords.resize(3 * count);
+    for (size_t i = 0; i < count; i++) {
+        const float * p = positionAt(positions, stride, i);
+        for (int k = 0; k < 3; k++) {
+            double c = floor((static_cast<double>(p[k]) - gridOrigin[k]) * scale);
+            coords[3 * i + k] = c <= 0.0 ? 0u : static_cast<unsigned int>(std::min(c, static_cast<double>(r - 1)));
+        }
+    }
+}
+
+void ClusterLevels::fromVertices(Level & level, const float * positions, size_t stride, const std::vector<unsigned int> & coords,
+                                 unsigned int factor) const
+{
+    size_t count = coords.size() / 3;
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++)
+        keys[i] = cellKey(coords[3 * i] / factor, coords[3 * i + 1] / factor, coords[3 * i + 2] / factor, level.r);
+    numberCells(keys, level.clusterOf, level.cells);
+
+    level.sums.assign(4 * level.cells.size(), 0.0);
+    for (size_t i = 0; i < count; i++) {
+        const float * p = positionAt(positions, stride, i);
+        double * sum = &level.sums[4 * level.clusterOf[i]];
+        sum[0] += p[0];
+        sum[1] += p[1];
+        sum[2] += p[2];
+        sum[3] += 1.0;
+    }
+}
+
+void ClusterLevels::coarsen(const Level & finer, Level & level) const
+{
+    unsigned int factor = finer.r / level.r;
+    size_t count = finer.cells.size();
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = finer.cells[i];
+        unsigned int x = static_cast<unsigned int>(key % finer.r);
+        unsigned int y = static_cast<unsigned int>((key / finer.r) % finer.r);
+        unsigned int z = static_cast<unsigned int>(key / finer.r / finer.r);
+        keys[i] = cellKey(x / factor, y / factor, z / factor, level.r);
+    }
+    std::vector<unsigned int> merged;
+    numberCells(keys, merged, level.cells);
+
+    //sums of the finer clusters, then every vertex through its finer cluster
+    level.sums.assign(4 * level.cells.size(), 0.0);
+    for (size_t i = 0; i < count; i++)
+        for (int k = 0; k < 4; k++)
+            level.sums[4 * merged[i] + k] += finer.sums[4 * i + k];
+    level.clusterOf.resize(finer.clusterOf.size());
+    for (size_t v = 0; v < finer.clusterOf.size(); v++)
+        level.clusterOf[v] = merged[finer.clusterOf[v]];
+}
+
+void ClusterLevels::averagePositions(size_t level, std::vector<float> & out) const
+{
+    const Level & l = levels[level];
+    out.resize(l.cells.size() * 3);
+    for (size_t c = 0; c < l.cells.size(); c++)
+        for (int k = 0; k < 3; k++)
+            out[3 * c + k] = static_cast<float>(l.sums[4 * c + k] / l.sums[4 * c + 3]);
+}
+
+void ClusterLevels::quadricPositions(size_t level, const float * positions, size_t stride, const unsigned int * indices,
+                                     size_t indexCount, std::vector<float> & out) const
+{
+    //a triangle adds its plane once per distinct cluster at every level, so quadrics are not
+    //merged from the finer level like the sums but gathered from the triangles again
+    const Level & l = levels[level];
+    averagePositions(level, out);
+    std::vector<double> quadrics;
+    accumulateQuadrics(positions, stride, indices, indexCount, l.clusterOf.data(), l.cells.size(), quadrics);
+    double cellSize = static_cast<double>(gridSize) / l.r;
+    for (size_t c = 0; c < l.cells.size(); c++) {
+        uint64_t key = l.cells[c];
+        double cell[3] = { double(key % l.r), double((key / l.r) % l.r), double(key / l.r / l.r) };
+        double low[3];
+        for (int k = 0; k < 3; k++)
+            low[k] = gridOrigin[k] + cell[k] * cellSize;
+        solveQuadric(&quadrics[9 * c], low, cellSize, &out[3 * c]);
+    }
+}
+
+void clusterAttributeLevels(const float * vertices, size_t count, size_t floatsPerVertex,
+                            const std::vector<size_t> & positionOffsets, const std::vector<size_t> & normalOffsets,
+                            const unsigned int * indices, size_t indexCount, const std::vector<unsigned int> & resolutions,
+                            std::vector<std::vector<float> > & levelVertices, std::vector<std::vector<unsigned int> > & levelIndices)
+{
+    levelVertices.assign(resolutions.size(), std::vector<float>());
+    levelIndices.assign(resolutions.size(), std::vector<unsigned int>());
+    if (count == 0 || positionOffsets.empty())
+        return;
+    size_t stride = floatsPerVertex * sizeof(float);
+    const float * positions = vertices + positionOffsets[0];
+
+    //the cube of Grid::clusterMesh around the positions
+    float low[3], high[3];
+    for (int k = 0; k < 3; k++)
+        low[k] = high[k] = positions[k];
+    for (size_t i = 1; i < count; i++) {
+        const float * p = positionAt(positions, stride, i);
+        for (int k = 0; k < 3; k++) {
+            low[k] = std::min(low[k], p[k]);
+            high[k] = std::max(high[k], p[k]);
+        }
+    }
+    const float offset = 0.01f;
+    float origin[3] = { low[0] - offset, low[1] - offset, low[2] - offset };
+    float size = std::max(std::max(high[0] - low[0], high[1] - low[1]), high[2] - low[2]) + 2 * offset;
+    ClusterLevels levels;
+    levels.build(positions, count, stride, origin, size, resolutions);
+
+    //charts: triangles joined through shared vertices; seams split the vertices, so they separate the charts
+    std::vector<unsigned int> chart(count);
+    for (size_t i = 0; i < count; i++)
+        chart[i] = static_cast<unsigned int>(i);
+    auto root = [&](unsigned int v) {
+        while (chart[v] != v) {
+            chart[v] = chart[chart[v]];
+            v = chart[v];
+        }
+        return v;
+    };
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        unsigned int a = root(indices[t]);
+        for (int k = 1; k < 3; k++) {
+            unsigned int b = root(indices[t + k]);
+            if (a != b)
+                chart[std::max(a, b)] = std::min(a, b);
+            a = std::min(a, b);
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+        chart[i] = root(static_cast<unsigned int>(i));
+
+    std::vector<uint64_t> keys(count);
+    std::vector<unsigned int> clusterOf;
+    std::vector<uint64_t> cells;
+    std::vector<double> sums, cellSums;
+    const size_t positionFloats = 3 * positionOffsets.size();
+    for (size_t l = 0; l < resolutions.size(); l++) {
+        //a cell holds one cluster per chart touching it, so no attribute blends across a seam
+        const std::vector<unsigned int> & cell = levels.vertexClusters(l);
+        for (size_t i = 0; i < count; i++)
+            keys[i] = (static_cast<uint64_t>(cell[i]) << 32) | chart[i];
+        numberCells(keys, clusterOf, cells);
+
+        //attributes averaged per cluster, positions over the whole cell: the charts of a cell
+        //share one position in every pose, so the two sides of a seam stay closed
+        sums.assign(cells.size() * floatsPerVertex, 0.0);
+        std::vector<unsigned int> members(cells.size(), 0);
+        std::vector<unsigned int> cellOfCluster(cells.size());
+        cellSums.assign(levels.clusterCount(l) * positionFloats, 0.0);
+        std::vector<unsigned int> cellMembers(levels.clusterCount(l), 0);
+        for (size_t i = 0; i < count; i++) {
+            const float * v = vertices + i * floatsPerVertex;
+            double * sum = &sums[clusterOf[i] * floatsPerVertex];
+            for (size_t f = 0; f < floatsPerVertex; f++)
+                sum[f] += v[f];
+            members[clusterOf[i]]++;
+            cellOfCluster[clusterOf[i]] = cell[i];
+            double * cellSum = &cellSums[cell[i] * positionFloats];
+            for (size_t p = 0; p < positionOffsets.size(); p++)
+                for (int k = 0; k < 3; k++)
+                    cellSum[3 * p + k] += v[positionOffsets[p] + k];
+            cellMembers[cell[i]]++;
+        }
+        std::vector<float> & out = levelVertices[l];
+        out.resize(sums.size());
+        for (size_t c = 0; c < cells.size(); c++) {
+            float * v = &out[c * floatsPerVertex];
+            for (size_t f = 0; f < floatsPerVertex; f++)
+                v[f] = static_cast<float>(sums[c * floatsPerVertex + f] / members[c]);
+            const double * cellSum = &cellSums[cellOfCluster[c] * positionFloats];
+            for (size_t p = 0; p < positionOffsets.size(); p++)
+                for (int k = 0; k < 3; k++)
+                    v[positionOffsets[p] + k] = static_cast<float>(cellSum[3 * p + k] / cellMembers[cellOfCluster[c]]);
+            for (size_t n = 0; n < normalOffsets.size(); n++) {
+                float * normal = v + normalOffsets[n];
+                float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (length > 0.0f)
+                    for (int k = 0; k < 3; k++)
+                        normal[k] /= length;
+            }
+        }
+
+        //triangles with two corners in one cell have no area left, whichever charts the corners belong to
+        std::vector<unsigned int> & triangles = levelIndices[l];
+        for (size_t t = 0; t + 2 < indexCount; t += 3) {
+            unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            if (cell[a] == cell[b] || cell[b] == cell[c] || cell[a] == cell[c])
+                continue;
+            triangles.push_back(clusterOf[a]);
+            triangles.push_back(clusterOf[b]);
+            triangles.push_back(clusterOf[c]);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include "weld.h"
+#include "mappedFile.h"
+#include <string.h>
+#include <iomanip>
+#include <sstream>
+
+size_t weldCorners(const void * corners, size_t count, size_t stride, std::vector<unsigned int> & remap)
+{
+    const char * data = static_cast<const char *>(corners);
+    remap.resize(count);
+
+    //open addressing, each slot holds 1 + the corner that introduced a unique vertex
+    size_t tableSize = 16;
+    while (tableSize < count * 2)
+        tableSize *= 2;
+    std::vector<unsigned int> table(tableSize, 0);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char * corner = data + i * stride;
+        size_t slot = static_cast<size_t>(hashBytes(corner, stride)) & (tableSize - 1);
+        for (;;) {
+            unsigned int owner = table[slot];
+            if (owner == 0) {
+                table[slot] = static_cast<unsigned int>(i + 1);
+                remap[i] = static_cast<unsigned int>(unique++);
+                break;
+            }
+            if (memcmp(data + (owner - 1) * stride, corner, stride) == 0) {
+                remap[i] = remap[owner - 1];
+                break;
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+    return unique;
+}
+
+std::string weldReport(const std::string & name, size_t corners, size_t vertices, size_t stride)
+{
+    std::ostringstream out;
+    out << name << ": " << corners << " corners -> " << vertices << " vertices";
+    if (vertices > 0)
+        out << " (" << std::fixed << std::setprecision(1) << corners / double(vertices) << "x)";
+    out << ", " << corners * stride / 1024 << " KB -> "
+        << vertices * stride / 1024 << " KB + " << corners * sizeof(unsigned int) / 1024 << " KB indices" << std::endl;
+    return out.str();
+}